@@ -0,0 +1,355 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_ALLOCATOR_HPP
+#define GIOPLER_ALLOCATOR_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "giopler/config.hpp"
+#include "giopler/control.hpp"
+#include "giopler/frame.hpp"
+#include "giopler/record.hpp"
+#include "giopler/sink.hpp"
+#include "giopler/profile.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+/// the allocations of all the containers with the same tag, see profiling_allocator
+// this is a private class for library internal use only
+// the allocation totals are relaxed atomics, so the containers of a tag can be used by any thread;
+// the reallocations are rare (containers grow geometrically), so they are kept under the mutex,
+// together with the functions that caused them
+class AllocationTag final
+{
+ public:
+  explicit AllocationTag(const std::string_view name, AllocationTag* const next)
+  : _name{name}, _next{next},
+    _alloc_id{get_counter_id("alloc")}, _alloc_bytes_id{get_counter_id("alloc_bytes")},
+    _realloc_id{get_counter_id("realloc")}, _copy_bytes_id{get_counter_id("copy_bytes")}
+  { }
+
+  void add_allocation(const std::size_t bytes) {
+    const auto size = static_cast<std::int64_t>(bytes);
+    _allocs.fetch_add(1, std::memory_order_relaxed);
+    _alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    const std::int64_t live_bytes = _live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    std::int64_t peak_bytes = _peak_bytes.load(std::memory_order_relaxed);
+    while (live_bytes > peak_bytes &&
+           !_peak_bytes.compare_exchange_weak(peak_bytes, live_bytes, std::memory_order_relaxed)) { }
+
+    count(_alloc_id);
+    count(_alloc_bytes_id, size);
+  }
+
+  void add_deallocation(const std::size_t bytes) {
+    _frees.fetch_add(1, std::memory_order_relaxed);
+    _live_bytes.fetch_sub(static_cast<std::int64_t>(bytes), std::memory_order_relaxed);
+  }
+
+  /// a block was replaced by a larger one, and its contents moved there
+  GIOPLER_OUTLINE void add_reallocation(std::size_t old_bytes, std::size_t new_bytes);
+
+ private:
+  friend class AllocationTags;
+  static constexpr std::size_t _size_buckets = 64;   // powers of two
+
+  struct Function {
+    const char* _function_name;   // nullptr=outside of any Function
+    std::int64_t _reallocs   = 0;
+    std::int64_t _copy_bytes = 0;
+  };
+
+  const std::string _name;
+  AllocationTag* const _next;   // list of all the tags, see AllocationTags
+  const CounterId _alloc_id, _alloc_bytes_id, _realloc_id, _copy_bytes_id;
+
+  std::atomic<std::int64_t> _allocs{0};
+  std::atomic<std::int64_t> _alloc_bytes{0};
+  std::atomic<std::int64_t> _frees{0};
+  std::atomic<std::int64_t> _live_bytes{0};
+  std::atomic<std::int64_t> _peak_bytes{0};
+
+  std::mutex _mutex;   // guards the reallocations
+  std::int64_t _reallocs   = 0;
+  std::int64_t _copy_bytes = 0;
+  std::array<std::int64_t, _size_buckets> _realloc_sizes{};   // new block sizes, rounded up to a power of two
+  std::vector<Function> _functions;   // few of them, so found by a linear search
+};
+
+// -----------------------------------------------------------------------------
+/// the tags used by profiling_allocator
+// this is a private class for library internal use only
+// the tags are interned and never destroyed, so containers that outlive this object can still use them
+// an AllocationSummary event is written for each tag at program end, before the ProgramEnd event
+class AllocationTags final
+{
+ public:
+  explicit AllocationTags([[maybe_unused]] const giopler::source_location& source_location = giopler::source_location::current())
+  : _source_location(source_location.file_name(), "<allocator>", source_location.line())
+  { }
+
+  ~AllocationTags() {
+    if constexpr (g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench) {
+      write_summaries();
+    }
+  }
+
+  /// the tag with this name, creating it the first time
+  GIOPLER_COLD static AllocationTag& intern(std::string_view name);
+
+ private:
+  static constexpr std::size_t _top_functions = 10;   // functions listed in each event
+  giopler::source_location _source_location;
+  constinit static inline std::atomic<AllocationTag*> _tags{nullptr};   // newest first
+  constinit static inline std::mutex _mutex;   // serializes the additions
+
+  /// write an AllocationSummary event for each tag that allocated
+  GIOPLER_COLD void write_summaries();
+
+  /// the AllocationSummary event of a tag
+  std::shared_ptr<Record> get_summary_record(AllocationTag& tag) const;
+};
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY the single instance is in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+GIOPLER_CORE_INLINE AllocationTags g_allocation_tags;
+#else
+extern AllocationTags g_allocation_tags;
+#endif
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+
+// -----------------------------------------------------------------------------
+namespace giopler {
+
+// -----------------------------------------------------------------------------
+/// allocator adapter that profiles the growth of the containers using it (Prof, Bench)
+// the allocations of all the containers with the same Tag are added together, and reported in an
+// AllocationSummary event at program end; the Tag is any type with a name
+// struct RowsTag { static constexpr std::string_view name = "rows"; };
+// std::vector<Row, giopler::profiling_allocator<Row, RowsTag>> rows;
+// the allocations are also counted into the innermost profiled function, as the user-defined counters
+// usr_alloc, usr_alloc_bytes, usr_realloc, and usr_copy_bytes
+// the allocator does not see the copies, so a reallocation is an allocation followed, on the same thread,
+// by the release of a smaller block of the same type; the copy volume is the size of that block
+// (the elements moved by a vector, or the bucket array replaced by a hash table rehash)
+// the memory comes from the Allocator being adapted; in the other build modes only that is used
+template<typename T, typename Tag, typename Allocator = std::allocator<T>>
+class profiling_allocator
+{
+  using Traits = std::allocator_traits<Allocator>;
+
+ public:
+  using value_type                             = T;
+  using upstream_allocator_type                = Allocator;
+  using propagate_on_container_copy_assignment = typename Traits::propagate_on_container_copy_assignment;
+  using propagate_on_container_move_assignment = typename Traits::propagate_on_container_move_assignment;
+  using propagate_on_container_swap            = typename Traits::propagate_on_container_swap;
+  using is_always_equal                        = typename Traits::is_always_equal;
+
+  template<typename U>
+  struct rebind {
+    using other = profiling_allocator<U, Tag, typename Traits::template rebind_alloc<U>>;
+  };
+
+  profiling_allocator() = default;
+
+  explicit profiling_allocator(const Allocator& upstream) noexcept
+  : _upstream{upstream}
+  { }
+
+  template<typename U, typename UpstreamU>
+  profiling_allocator(const profiling_allocator<U, Tag, UpstreamU>& other) noexcept   // NOLINT(google-explicit-constructor)
+  : _upstream{other.get_upstream()}
+  { }
+
+  [[nodiscard]] T* allocate(const std::size_t count) {
+    T* const pointer = Traits::allocate(_upstream, count);
+    if constexpr (_is_enabled) {
+      get_tag().add_allocation(count*sizeof(T));
+      _last_allocation = {pointer, count*sizeof(T)};
+    }
+    return pointer;
+  }
+
+  void deallocate(T* const pointer, const std::size_t count) noexcept {
+    if constexpr (_is_enabled) {
+      const std::size_t bytes = count*sizeof(T);
+      dev::AllocationTag& tag = get_tag();
+      tag.add_deallocation(bytes);
+      if (_last_allocation._pointer && _last_allocation._pointer != pointer && _last_allocation._bytes > bytes) {
+        tag.add_reallocation(bytes, _last_allocation._bytes);
+      }
+      _last_allocation = {};
+    }
+    Traits::deallocate(_upstream, pointer, count);
+  }
+
+  [[nodiscard]] const Allocator& get_upstream() const noexcept {
+    return _upstream;
+  }
+
+  template<typename U, typename UpstreamU>
+  bool operator==(const profiling_allocator<U, Tag, UpstreamU>& other) const noexcept {
+    return _upstream == other.get_upstream();
+  }
+
+ private:
+  static constexpr bool _is_enabled = (g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench);
+
+  struct LastAllocation {
+    const void* _pointer = nullptr;
+    std::size_t _bytes   = 0;
+  };
+
+  // the block allocated last by this thread for this type, until the next release
+  constinit static inline thread_local LastAllocation _last_allocation{};
+
+  [[no_unique_address]] Allocator _upstream;
+
+  static dev::AllocationTag& get_tag() {
+    static dev::AllocationTag& tag = dev::AllocationTags::intern(Tag::name);
+    return tag;
+  }
+};
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void AllocationTag::add_reallocation(const std::size_t old_bytes, const std::size_t new_bytes)
+{
+  const PublishedFrames* const frames = g_thread_control._published_frames;
+  const char* const function_name = frames ? frames->get_top() : nullptr;
+  {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    _reallocs++;
+    _copy_bytes += static_cast<std::int64_t>(old_bytes);
+    _realloc_sizes[std::min(_size_buckets-1, static_cast<std::size_t>(std::bit_width(new_bytes-1)))]++;
+
+    auto function = std::find_if(_functions.begin(), _functions.end(),
+                                 [function_name](const Function& other) { return other._function_name == function_name; });
+    if (function == _functions.end())   function = _functions.insert(_functions.end(), Function{function_name});
+    function->_reallocs++;
+    function->_copy_bytes += static_cast<std::int64_t>(old_bytes);
+  }
+
+  count(_realloc_id);
+  count(_copy_bytes_id, static_cast<std::int64_t>(old_bytes));
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+AllocationTag& AllocationTags::intern(const std::string_view name)
+{
+  const std::lock_guard<std::mutex> lock{_mutex};
+  AllocationTag* const tags = _tags.load(std::memory_order_relaxed);
+  for (AllocationTag* tag = tags; tag; tag = tag->_next) {
+    if (tag->_name == name)   return *tag;
+  }
+  AllocationTag* const tag = new AllocationTag{name, tags};   // never deleted
+  _tags.store(tag, std::memory_order_release);
+  return *tag;
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void AllocationTags::write_summaries()
+{
+  for (AllocationTag* tag = _tags.load(std::memory_order_acquire); tag; tag = tag->_next) {
+    if (tag->_allocs.load(std::memory_order_relaxed))   sink::g_sink_manager.write_record(get_summary_record(*tag));
+  }
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+std::shared_ptr<Record> AllocationTags::get_summary_record(AllocationTag& tag) const
+{
+  const std::int64_t allocs      = tag._allocs.load(std::memory_order_relaxed);
+  const std::int64_t alloc_bytes = tag._alloc_bytes.load(std::memory_order_relaxed);
+
+  std::shared_ptr<Record> record_summary =
+      get_event_record(_source_location, EventCategory::Profile, Event::AllocationSummary, UUID());
+  record_summary->insert_or_assign("msg"s, std::string_view{tag._name});
+  record_summary->insert({
+      {"allocs"s,       allocs},
+      {"alloc_bytes"s,  alloc_bytes},
+      {"alloc_avg"s,    static_cast<double>(alloc_bytes) / static_cast<double>(allocs)},
+      {"frees"s,        tag._frees.load(std::memory_order_relaxed)},
+      {"live_bytes"s,   tag._live_bytes.load(std::memory_order_relaxed)},
+      {"peak_bytes"s,   tag._peak_bytes.load(std::memory_order_relaxed)}
+  });
+
+  const std::lock_guard<std::mutex> lock{tag._mutex};
+  std::shared_ptr<giopler::Array> realloc_sizes = make_arena_shared<giopler::Array>();
+  for (std::size_t bucket = 0; bucket < AllocationTag::_size_buckets; ++bucket) {
+    if (!tag._realloc_sizes[bucket])   continue;
+    realloc_sizes->push_back(make_arena_shared<Record>(Record{
+        {"bytes"s,   static_cast<std::int64_t>(std::uint64_t{1} << bucket)},   // up to this many bytes
+        {"count"s,   tag._realloc_sizes[bucket]}
+    }));
+  }
+
+  std::vector<AllocationTag::Function> functions{tag._functions};
+  const std::size_t functions_count = std::min(functions.size(), _top_functions);
+  std::partial_sort(functions.begin(), functions.begin() + static_cast<std::ptrdiff_t>(functions_count), functions.end(),
+                    [](const auto& a, const auto& b) { return a._copy_bytes > b._copy_bytes; });
+  std::shared_ptr<giopler::Array> top_functions = make_arena_shared<giopler::Array>();
+  for (std::size_t index = 0; index < functions_count; ++index) {
+    const AllocationTag::Function& function = functions[index];
+    top_functions->push_back(make_arena_shared<Record>(Record{
+        {"func"s,        function._function_name ? function._function_name : "<none>"},
+        {"reallocs"s,    function._reallocs},
+        {"copy_bytes"s,  function._copy_bytes}
+    }));
+  }
+
+  record_summary->insert({
+      {"reallocs"s,       tag._reallocs},
+      {"copy_bytes"s,     tag._copy_bytes},
+      {"realloc_sizes"s,  realloc_sizes},
+      {"funcs"s,          top_functions}
+  });
+  return record_summary;
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+#endif // GIOPLER_CORE_DEFINITIONS
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_ALLOCATOR_HPP
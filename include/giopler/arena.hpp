@@ -0,0 +1,232 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_ARENA_HPP
+#define GIOPLER_ARENA_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "giopler/config.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler {
+
+// -----------------------------------------------------------------------------
+/// per-thread bump allocator for event records
+// this is a private class for library internal use only
+// Records are built by the application threads, but are serialized and freed by the sink threads.
+// Freeing memory in a different thread than the one that allocated it does not scale well
+// with most malloc implementations, and the records are made of many small allocations.
+// Each thread carves its allocations out of a chunk it owns. Freeing only decrements an
+// atomic counter in the chunk. Once the owning thread has moved on to a new chunk and every
+// allocation in the old one has been freed, the whole chunk is recycled at once.
+class RecordArena final
+{
+ public:
+  static void* allocate(const std::size_t bytes, const std::size_t alignment) {
+    assert(alignment <= _header_bytes);
+    if (bytes > _max_allocation) [[unlikely]] {
+      return ::operator new(bytes);
+    }
+
+    if (!_state._chunk || !fits(_state._chunk, bytes, alignment)) [[unlikely]] {
+      new_chunk();
+    }
+
+    Chunk* chunk   = _state._chunk;
+    chunk->_used   = align_up(chunk->_used, alignment);
+    void* pointer  = reinterpret_cast<std::byte*>(chunk) + chunk->_used;
+    chunk->_used  += bytes;
+    chunk->_allocated++;
+
+    if (_state._exited) [[unlikely]] {   // the thread is exiting; do not hold on to the chunk
+      retire_chunk();
+    }
+    return pointer;
+  }
+
+  static void deallocate(void* pointer, const std::size_t bytes) noexcept {
+    if (bytes > _max_allocation) [[unlikely]] {
+      ::operator delete(pointer);
+      return;
+    }
+
+    Chunk* chunk = get_chunk(pointer);
+    if (chunk->_balance.fetch_sub(1, std::memory_order_acq_rel) == 1) {   // last one out of a retired chunk
+      get_chunk_pool().put(chunk);
+    }
+  }
+
+ private:
+  static constexpr std::size_t _chunk_bytes    = 64*1024;     // must be a power of two
+  static constexpr std::size_t _header_bytes   = 128;         // keeps _balance on its own cache line
+  static constexpr std::size_t _max_allocation = 4*1024;      // larger requests go to the global heap
+  static constexpr std::size_t _max_pooled     = 256;         // chunks kept for reuse (16 MB)
+
+  // the header lives at the start of each chunk, which is aligned to _chunk_bytes
+  // _balance goes negative as allocations are freed, and the owner adds its
+  // allocation count when it retires the chunk, so it can only reach zero after that
+  struct Chunk {
+    std::size_t _used;                    // owner thread only
+    std::int64_t _allocated;              // owner thread only
+    alignas(64) std::atomic<std::int64_t> _balance;
+  };
+  static_assert(sizeof(Chunk) <= _header_bytes);
+
+  /// free chunks shared by all threads
+  class ChunkPool final {
+   public:
+    Chunk* get() {
+      Chunk* chunk = nullptr;
+      {
+        const std::lock_guard<std::mutex> lock{_mutex};
+        if (!_chunks.empty()) {
+          chunk = _chunks.back();
+          _chunks.pop_back();
+        }
+      }
+
+      if (!chunk) {
+        chunk = static_cast<Chunk*>(std::aligned_alloc(_chunk_bytes, _chunk_bytes));
+        if (!chunk)   throw std::bad_alloc{};
+        new (chunk) Chunk{};
+      }
+
+      chunk->_used      = _header_bytes;
+      chunk->_allocated = 0;
+      chunk->_balance.store(0, std::memory_order_relaxed);
+      return chunk;
+    }
+
+    void put(Chunk* chunk) {
+      {
+        const std::lock_guard<std::mutex> lock{_mutex};
+        if (_chunks.size() < _max_pooled) {
+          _chunks.push_back(chunk);
+          return;
+        }
+      }
+      std::free(chunk);
+    }
+
+   private:
+    std::mutex _mutex;
+    std::vector<Chunk*> _chunks;
+  };
+
+  struct ThreadState {
+    Chunk* _chunk;
+    bool _exited;
+  };
+
+  /// retires the current chunk when the thread exits
+  struct ThreadExit {
+    void touch() { }
+    ~ThreadExit() {
+      if (_state._chunk)   retire_chunk();
+      _state._exited = true;
+    }
+  };
+
+  static inline constinit thread_local ThreadState _state{};
+  static inline thread_local ThreadExit _thread_exit;
+
+  /// records can be freed during program shutdown, so the pool is never destroyed
+  static ChunkPool& get_chunk_pool() {
+    static ChunkPool* chunk_pool = new ChunkPool{};
+    return *chunk_pool;
+  }
+
+  static Chunk* get_chunk(void* pointer) {
+    return reinterpret_cast<Chunk*>(reinterpret_cast<std::uintptr_t>(pointer) & ~(_chunk_bytes-1));
+  }
+
+  static constexpr std::size_t align_up(const std::size_t offset, const std::size_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+  }
+
+  static bool fits(const Chunk* chunk, const std::size_t bytes, const std::size_t alignment) {
+    return align_up(chunk->_used, alignment) + bytes <= _chunk_bytes;
+  }
+
+  static void new_chunk() {
+    if (!_state._exited)   _thread_exit.touch();   // registers the thread exit clean-up
+    if (_state._chunk)   retire_chunk();
+    _state._chunk = get_chunk_pool().get();
+  }
+
+  static void retire_chunk() {
+    Chunk* chunk = _state._chunk;
+    _state._chunk = nullptr;
+    const std::int64_t allocated = chunk->_allocated;
+    if (chunk->_balance.fetch_add(allocated, std::memory_order_acq_rel) + allocated == 0) {
+      get_chunk_pool().put(chunk);   // everything was already freed
+    }
+  }
+};
+
+// -----------------------------------------------------------------------------
+/// standard allocator interface to RecordArena
+// stateless, so memory allocated through any instance can be freed through any other
+template<typename T>
+class ArenaAllocator
+{
+ public:
+  using value_type = T;
+
+  ArenaAllocator() noexcept = default;
+
+  template<typename U>
+  ArenaAllocator([[maybe_unused]] const ArenaAllocator<U>& other) noexcept { }   // NOLINT(google-explicit-constructor)
+
+  [[nodiscard]] T* allocate(const std::size_t count) {
+    return static_cast<T*>(RecordArena::allocate(count*sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* pointer, const std::size_t count) noexcept {
+    RecordArena::deallocate(pointer, count*sizeof(T));
+  }
+
+  template<typename U>
+  bool operator==([[maybe_unused]] const ArenaAllocator<U>& other) const noexcept {
+    return true;
+  }
+};
+
+// -----------------------------------------------------------------------------
+/// string whose contents are allocated in the record arena
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+// -----------------------------------------------------------------------------
+/// same as std::make_shared, but the object and its control block are allocated in the record arena
+template<typename T, typename... Args>
+std::shared_ptr<T> make_arena_shared(Args&&... args) {
+  return std::allocate_shared<T>(ArenaAllocator<T>{}, std::forward<Args>(args)...);
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_ARENA_HPP
@@ -0,0 +1,204 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_BATCH_HPP
+#define GIOPLER_BATCH_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+#include "giopler/config.hpp"
+#include "giopler/utility.hpp"
+#include "giopler/record.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler::sink {
+
+// -----------------------------------------------------------------------------
+/// distribution of the delivery latencies, with a fixed amount of memory
+// four buckets per doubling, starting at one microsecond
+// the percentiles are the upper bound of their bucket, so within 19% of the real values
+class LatencyBuckets final
+{
+ public:
+  void add(const double secs) {
+    const double micros = secs * 1e6;
+    const std::size_t bucket = (micros <= 1.0) ? 0 :
+        std::min(_bucket_count-1, static_cast<std::size_t>(4.0 * std::log2(micros)));
+    _buckets[bucket]++;
+    _count++;
+    _max_secs = std::max(_max_secs, secs);
+  }
+
+  void merge(const LatencyBuckets& other) {
+    for (std::size_t bucket = 0; bucket < _bucket_count; ++bucket)   _buckets[bucket] += other._buckets[bucket];
+    _count += other._count;
+    _max_secs = std::max(_max_secs, other._max_secs);
+  }
+
+  [[nodiscard]] std::uint64_t get_count() const { return _count; }
+  [[nodiscard]] double get_max() const          { return _max_secs; }
+
+  /// the latency in seconds below which the given fraction (0-1) of the events were delivered
+  [[nodiscard]] double get_percentile(const double fraction) const {
+    const auto rank = static_cast<std::uint64_t>(std::ceil(fraction * static_cast<double>(_count)));
+    std::uint64_t count = 0;
+    for (std::size_t bucket = 0; bucket < _bucket_count; ++bucket) {
+      count += _buckets[bucket];
+      if (count && count >= rank)   return std::min(_max_secs, std::exp2(static_cast<double>(bucket+1) / 4.0) / 1e6);
+    }
+    return _max_secs;
+  }
+
+ private:
+  static constexpr std::size_t _bucket_count = 128;   // up to 2^32 microseconds
+  std::array<std::uint64_t, _bucket_count> _buckets{};
+  std::uint64_t _count = 0;
+  double _max_secs = 0;
+};
+
+// -----------------------------------------------------------------------------
+/// sizes the batches of the sink, and how long to wait for more events, to meet a delivery latency target
+// this is a private class for library internal use only; it is guarded by the sink mutex
+// the delivery latency of an event is the time from write_record until its batch was sent
+// the batches are limited to what can be sent in half of the target, at the measured send speed
+// a process thread woken for the first event of a batch waits for more events (lingers) for up to
+// half of what is left of the target, unless at the measured arrival rate no more events would come,
+// and sends early when the batch is full
+// GIOPLER_LATENCY_TARGET sets the target in milliseconds (default 200); 0 sends every event as soon as possible
+class BatchController final
+{
+ public:
+  explicit BatchController(const std::size_t max_batch_bytes)
+  : _max_batch_bytes{max_batch_bytes}, _batch_bytes{max_batch_bytes}
+  {
+    const char* target = std::getenv("GIOPLER_LATENCY_TARGET");
+    if (target)   _latency_target = std::max(0.0, std::atof(target) / 1000.0);
+    update();
+  }
+
+  /// largest batch to build, in JSON bytes
+  [[nodiscard]] std::size_t get_batch_bytes() const { return _batch_bytes; }
+
+  /// seconds to wait for more events after the first one of a batch
+  [[nodiscard]] std::chrono::steady_clock::duration get_linger() const {
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(_linger_secs));
+  }
+
+  /// true if this many queued records are expected to fill a batch
+  [[nodiscard]] bool is_batch_full(const std::size_t records_count) const {
+    return static_cast<double>(records_count) * _record_bytes >= static_cast<double>(_batch_bytes);
+  }
+
+  /// a batch of records was taken from the queue
+  void add_batch(const std::size_t records_count, const TimestampSteady now) {
+    if (_last_batch_time != TimestampSteady{}) {
+      const double secs = std::max(1e-6, timestamp_diff(_last_batch_time, now));
+      average(_arrival_rate, static_cast<double>(records_count) / secs);
+    }
+    _last_batch_time = now;
+  }
+
+  /// a batch was sent
+  void add_send(const std::size_t records_count, const std::size_t bytes, const double secs) {
+    _batches++;
+    _bytes += bytes;
+    if (records_count)   average(_record_bytes, static_cast<double>(bytes) / static_cast<double>(records_count));
+    if (bytes >= _large_batch_bytes)   average(_send_secs_per_byte, secs / static_cast<double>(bytes));
+    else                               average(_send_fixed_secs, secs);
+    update();
+  }
+
+  /// the delivery latencies of the events of a batch
+  void add_latencies(const LatencyBuckets& latencies) {
+    _latencies.merge(latencies);
+  }
+
+  /// the achieved delivery latency and the current batching, for the ProgramEnd event
+  [[nodiscard]] std::shared_ptr<Record> get_metrics() const {
+    return make_arena_shared<Record>(Record{
+      {"lat_target"s,    _latency_target},
+      {"lat_p50"s,       _latencies.get_percentile(0.50)},
+      {"lat_p90"s,       _latencies.get_percentile(0.90)},
+      {"lat_p99"s,       _latencies.get_percentile(0.99)},
+      {"lat_max"s,       _latencies.get_max()},
+      {"events"s,        static_cast<std::int64_t>(_latencies.get_count())},
+      {"batches"s,       static_cast<std::int64_t>(_batches)},
+      {"batch_bytes"s,   _batches ? static_cast<double>(_bytes) / static_cast<double>(_batches) : 0.0},
+      {"batch_limit"s,   static_cast<std::int64_t>(_batch_bytes)},
+      {"linger"s,        _linger_secs},
+      {"arrival_rate"s,  _arrival_rate}
+    });
+  }
+
+  [[nodiscard]] double get_latency_target() const { return _latency_target; }
+  [[nodiscard]] const LatencyBuckets& get_latencies() const { return _latencies; }
+
+ private:
+  static constexpr std::size_t _large_batch_bytes = 64*1024;   // smaller batches measure the fixed cost of a send
+  static constexpr std::size_t _min_batch_bytes   = 64*1024;
+  const std::size_t _max_batch_bytes;
+  double _latency_target = 0.2;
+
+  // estimates, as exponential moving averages
+  double _arrival_rate       = 0;        // records per second
+  double _record_bytes       = 512;      // JSON bytes per record
+  double _send_fixed_secs    = 0.02;     // time to send a small batch
+  double _send_secs_per_byte = 2e-8;     // 50 MB/s
+  TimestampSteady _last_batch_time{};
+
+  // decisions
+  std::size_t _batch_bytes;
+  double _linger_secs = 0;
+
+  // self-metrics
+  LatencyBuckets _latencies;
+  std::uint64_t _batches = 0;
+  std::uint64_t _bytes = 0;
+
+  static void average(double& estimate, const double sample) {
+    constexpr double weight = 0.25;
+    estimate += weight * (sample - estimate);
+  }
+
+  [[nodiscard]] double get_send_secs(const std::size_t bytes) const {
+    return _send_fixed_secs + _send_secs_per_byte * static_cast<double>(bytes);
+  }
+
+  void update() {
+    if (_latency_target <= 0) {
+      _batch_bytes = _max_batch_bytes;
+      _linger_secs = 0;
+      return;
+    }
+
+    const double send_budget = _latency_target / 2 - _send_fixed_secs;
+    _batch_bytes = std::clamp(static_cast<std::size_t>(std::max(0.0, send_budget) / _send_secs_per_byte),
+                              std::min(_min_batch_bytes, _max_batch_bytes), _max_batch_bytes);
+
+    _linger_secs = std::max(0.0, (_latency_target - get_send_secs(_batch_bytes)) / 2);
+    if (_arrival_rate * _linger_secs < 1.0)   _linger_secs = 0;   // nothing more would arrive
+  }
+};
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::sink
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_BATCH_HPP
@@ -0,0 +1,379 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_CODEC_HPP
+#define GIOPLER_CODEC_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define ZLIB_CONST
+#include "zlib.h"
+
+// the giopler CMake target defines these when the libraries are found at configure time
+#if defined(GIOPLER_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(GIOPLER_HAVE_LZ4)
+#include <lz4frame.h>
+#endif
+
+#include "giopler/config.hpp"
+#include "giopler/utility.hpp"
+
+// -----------------------------------------------------------------------------
+// https://www.rfc-editor.org/rfc/rfc8878 (zstd)
+// https://github.com/lz4/lz4/blob/dev/doc/lz4_Frame_format.md
+// https://www.rfc-editor.org/rfc/rfc7694 (Accept-Encoding in a 415 response)
+namespace giopler::sink {
+
+// -----------------------------------------------------------------------------
+/// compression of the batches of events
+// gzip is always available; zstd and lz4 only when the library was found
+// the name of the codec is its Content-Encoding token
+enum class Codec {Gzip, Zstd, Lz4};
+
+constexpr std::string_view get_codec_name(const Codec codec) {
+  switch (codec) {
+    case Codec::Gzip:   return "gzip"sv;
+    case Codec::Zstd:   return "zstd"sv;
+    case Codec::Lz4:    return "lz4"sv;
+  }
+  return "gzip"sv;
+}
+
+// -----------------------------------------------------------------------------
+constexpr bool is_codec_available(const Codec codec) {
+  switch (codec) {
+    case Codec::Gzip:   return true;
+#if defined(GIOPLER_HAVE_ZSTD)
+    case Codec::Zstd:   return true;
+#endif
+#if defined(GIOPLER_HAVE_LZ4)
+    case Codec::Lz4:    return true;
+#endif
+    default:            return false;
+  }
+}
+
+// -----------------------------------------------------------------------------
+/// the codecs, in order of preference
+constexpr std::array<Codec, 3> g_codecs{Codec::Zstd, Codec::Lz4, Codec::Gzip};
+
+// -----------------------------------------------------------------------------
+/// the codec with this name, even if it is not available
+inline std::optional<Codec> find_codec(const std::string_view name) {
+  for (const Codec codec : g_codecs) {
+    if (name == get_codec_name(codec))   return codec;
+  }
+  return std::nullopt;
+}
+
+// -----------------------------------------------------------------------------
+/// the available codecs as an Accept-Encoding list, "zstd, lz4, gzip"
+inline std::string get_available_codecs() {
+  std::string codecs;
+  for (const Codec codec : g_codecs) {
+    if (!is_codec_available(codec))   continue;
+    if (!codecs.empty())   codecs.append(", ");
+    codecs.append(get_codec_name(codec));
+  }
+  return codecs;
+}
+
+// -----------------------------------------------------------------------------
+/// the codec to use after the server refused one
+// the first available codec of the Accept-Encoding list of the response, other than the refused one;
+// gzip if there is none, since every server accepts it
+inline Codec negotiate_codec(std::string_view accepted, const Codec refused) {
+  while (!accepted.empty()) {
+    const std::size_t end = std::min(accepted.find(','), accepted.size());
+    std::string_view token = accepted.substr(0, end);
+    token = token.substr(0, std::min(token.find(';'), token.size()));   // drop any weight
+    while (!token.empty() && token.front() == ' ')   token.remove_prefix(1);
+    while (!token.empty() && token.back() == ' ')    token.remove_suffix(1);
+    const std::optional<Codec> codec = find_codec(token);
+    if (codec && *codec != refused && is_codec_available(*codec))   return *codec;
+    accepted.remove_prefix(std::min(end+1, accepted.size()));
+  }
+  return Codec::Gzip;
+}
+
+// -----------------------------------------------------------------------------
+/// the codec settings
+// GIOPLER_CODEC is gzip (default), zstd, or lz4; an unavailable codec falls back to gzip
+// GIOPLER_CODEC_LEVEL is the compression level, 0 for the default of the codec
+// GIOPLER_CODEC_DICT is a zstd dictionary, trained on recorded batches with giopler_codec --train;
+// the server finds it by the dictionary id in the frame header, so it must have the same file
+struct CodecOptions {
+  Codec _codec = Codec::Gzip;
+  int _level = 0;
+  std::string _dictionary;   // file contents
+
+  static CodecOptions from_environment() {
+    CodecOptions options;
+    const char* codec_name = std::getenv("GIOPLER_CODEC");
+    if (codec_name) {
+      const std::optional<Codec> codec = find_codec(codec_name);
+      if (codec && is_codec_available(*codec)) {
+        options._codec = *codec;
+      } else {
+        std::cerr << gformat("Giopler: WARNING: codec '{}' is not available, using gzip\n", codec_name);
+      }
+    }
+
+    const char* level = std::getenv("GIOPLER_CODEC_LEVEL");
+    if (level)   options._level = std::atoi(level);
+
+    const char* dictionary_path = std::getenv("GIOPLER_CODEC_DICT");
+    if (dictionary_path)   options._dictionary = read_dictionary(dictionary_path);
+    return options;
+  }
+
+  static std::string read_dictionary(const char* path) {
+    std::ifstream file{path, std::ios::binary};
+    if (!file) {
+      std::cerr << gformat("Giopler: WARNING: could not read the codec dictionary '{}'\n", path);
+      return {};
+    }
+    return {std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+  }
+};
+
+// -----------------------------------------------------------------------------
+/// compresses the batches of events
+// this is a private class for library internal use only
+// one per sink process thread; the contexts and the dictionary are created on first use
+// and reused for every batch, and so is the output buffer of the caller
+// the dictionary is only used by zstd
+class Compressor final
+{
+ public:
+  explicit Compressor(CodecOptions options = CodecOptions::from_environment())
+  : _options{std::move(options)}
+  { }
+
+  ~Compressor() {
+#if defined(GIOPLER_HAVE_ZSTD)
+    ZSTD_freeCDict(_zstd_dictionary);
+    ZSTD_freeCCtx(_zstd_context);
+#endif
+  }
+
+  Compressor(const Compressor&) = delete;
+  Compressor& operator=(const Compressor&) = delete;
+
+  [[nodiscard]] Codec get_codec() const {
+    return _options._codec;
+  }
+
+  /// change the codec, for example after the server refused the current one
+  void set_codec(const Codec codec) {
+    _options._codec = codec;
+  }
+
+  void compress(const std::string_view input, std::vector<std::uint8_t>& output) {
+    switch (_options._codec) {
+#if defined(GIOPLER_HAVE_ZSTD)
+      case Codec::Zstd:   compress_zstd(input, output); break;
+#endif
+#if defined(GIOPLER_HAVE_LZ4)
+      case Codec::Lz4:    compress_lz4(input, output);  break;
+#endif
+      default:            compress_gzip(input, output, _options._level); break;
+    }
+  }
+
+  // -----------------------------------------------------------------------------
+  /// compress the input buffer using gzip data compression
+  // the output buffer is reused between calls, so it only grows to the largest batch size once
+  static void compress_gzip(const std::string_view input, std::vector<std::uint8_t>& output, const int level = 0)
+  {
+    z_stream zstream{};
+    zstream.avail_in   = static_cast<uint32_t>(input.size());
+    zstream.next_in    = reinterpret_cast<const uint8_t*>(input.data());
+
+    // Hard to believe they don't have a macro for gzip encoding. "Add 16" is the best thing zlib can do:
+    // "Add 16 to windowBits to write a simple gzip header and trailer around the compressed data instead of a zlib wrapper"
+    const int status = deflateInit2(&zstream, level ? level : Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 | 16, 9, Z_DEFAULT_STRATEGY);
+    assert(status == Z_OK);
+    output.resize(deflateBound(&zstream, input.size()));
+    zstream.avail_out = static_cast<uint32_t>(output.size());
+    zstream.next_out  = output.data();
+
+    const int deflate_status = deflate(&zstream, Z_FINISH);
+    assert(deflate_status == Z_STREAM_END);
+    output.resize(zstream.total_out);
+    const int deflate_end_status = deflateEnd(&zstream);
+    assert(deflate_end_status == Z_OK);
+  }
+
+ private:
+  CodecOptions _options;
+
+#if defined(GIOPLER_HAVE_ZSTD)
+  ZSTD_CCtx* _zstd_context     = nullptr;
+  ZSTD_CDict* _zstd_dictionary = nullptr;
+
+  // the fast levels compress JSON better than gzip, several times faster
+  void compress_zstd(const std::string_view input, std::vector<std::uint8_t>& output) {
+    const int level = _options._level ? _options._level : 1;
+    if (!_zstd_context) {
+      _zstd_context = ZSTD_createCCtx();
+      assert(_zstd_context);
+      if (!_options._dictionary.empty()) {
+        _zstd_dictionary = ZSTD_createCDict(_options._dictionary.data(), _options._dictionary.size(), level);
+      }
+    }
+
+    output.resize(ZSTD_compressBound(input.size()));
+    const std::size_t size = _zstd_dictionary ?
+        ZSTD_compress_usingCDict(_zstd_context, output.data(), output.size(), input.data(), input.size(), _zstd_dictionary) :
+        ZSTD_compressCCtx(_zstd_context, output.data(), output.size(), input.data(), input.size(), level);
+    assert(!ZSTD_isError(size));
+    output.resize(ZSTD_isError(size) ? 0 : size);
+  }
+#endif
+
+#if defined(GIOPLER_HAVE_LZ4)
+  // the frame format, with the content size in the header
+  void compress_lz4(const std::string_view input, std::vector<std::uint8_t>& output) {
+    LZ4F_preferences_t preferences{};
+    preferences.compressionLevel      = _options._level;
+    preferences.frameInfo.contentSize = input.size();
+    output.resize(LZ4F_compressFrameBound(input.size(), &preferences));
+    const std::size_t size = LZ4F_compressFrame(output.data(), output.size(), input.data(), input.size(), &preferences);
+    assert(!LZ4F_isError(size));
+    output.resize(LZ4F_isError(size) ? 0 : size);
+  }
+#endif
+};
+
+// -----------------------------------------------------------------------------
+/// decompresses the batches of events, for the tools that stand in for the server
+// the dictionary is only used by zstd
+class Decompressor final
+{
+ public:
+  explicit Decompressor(std::string dictionary = {})
+  : _dictionary{std::move(dictionary)}
+  { }
+
+  ~Decompressor() {
+#if defined(GIOPLER_HAVE_ZSTD)
+    ZSTD_freeDDict(_zstd_dictionary);
+    ZSTD_freeDCtx(_zstd_context);
+#endif
+  }
+
+  Decompressor(const Decompressor&) = delete;
+  Decompressor& operator=(const Decompressor&) = delete;
+
+  /// false if the input is not valid for the codec
+  bool decompress(const Codec codec, const std::string_view input, std::string& output) {
+    output.clear();
+    switch (codec) {
+#if defined(GIOPLER_HAVE_ZSTD)
+      case Codec::Zstd:   return decompress_zstd(input, output);
+#endif
+#if defined(GIOPLER_HAVE_LZ4)
+      case Codec::Lz4:    return decompress_lz4(input, output);
+#endif
+      case Codec::Gzip:   return decompress_gzip(input, output);
+      default:            return false;
+    }
+  }
+
+ private:
+  std::string _dictionary;
+  static constexpr std::size_t _chunk_size = 256*1024;
+
+  static bool decompress_gzip(const std::string_view input, std::string& output) {
+    z_stream zstream{};
+    zstream.next_in  = reinterpret_cast<const Bytef*>(input.data());
+    zstream.avail_in = static_cast<uInt>(input.size());
+    if (inflateInit2(&zstream, 15 | 16) != Z_OK)   return false;   // gzip wrapper only
+
+    int status = Z_OK;
+    char chunk[_chunk_size];
+    while (status == Z_OK) {
+      zstream.next_out  = reinterpret_cast<Bytef*>(chunk);
+      zstream.avail_out = sizeof(chunk);
+      status = inflate(&zstream, Z_NO_FLUSH);
+      output.append(chunk, sizeof(chunk) - zstream.avail_out);
+      if (status == Z_BUF_ERROR && zstream.avail_in == 0)   break;   // truncated input
+    }
+    inflateEnd(&zstream);
+    return status == Z_STREAM_END;
+  }
+
+#if defined(GIOPLER_HAVE_ZSTD)
+  ZSTD_DCtx* _zstd_context     = nullptr;
+  ZSTD_DDict* _zstd_dictionary = nullptr;
+
+  // the sink writes the content size in the frame header
+  bool decompress_zstd(const std::string_view input, std::string& output) {
+    static constexpr unsigned long long max_size = 1ULL << 30;   // refuse anything larger
+    const unsigned long long size = ZSTD_getFrameContentSize(input.data(), input.size());
+    if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR || size > max_size)   return false;
+    if (!_zstd_context) {
+      _zstd_context = ZSTD_createDCtx();
+      if (!_dictionary.empty())   _zstd_dictionary = ZSTD_createDDict(_dictionary.data(), _dictionary.size());
+    }
+
+    output.resize(static_cast<std::size_t>(size));
+    const std::size_t result = _zstd_dictionary ?
+        ZSTD_decompress_usingDDict(_zstd_context, output.data(), output.size(), input.data(), input.size(), _zstd_dictionary) :
+        ZSTD_decompress_usingDict(_zstd_context, output.data(), output.size(), input.data(), input.size(), nullptr, 0);
+    return !ZSTD_isError(result) && result == size;
+  }
+#endif
+
+#if defined(GIOPLER_HAVE_LZ4)
+  static bool decompress_lz4(std::string_view input, std::string& output) {
+    LZ4F_dctx* context = nullptr;
+    if (LZ4F_isError(LZ4F_createDecompressionContext(&context, LZ4F_VERSION)))   return false;
+
+    char chunk[_chunk_size];
+    std::size_t hint = 1;
+    while (!input.empty() && hint) {
+      std::size_t output_size = sizeof(chunk);
+      std::size_t input_size  = input.size();
+      hint = LZ4F_decompress(context, chunk, &output_size, input.data(), &input_size, nullptr);
+      if (LZ4F_isError(hint))   break;
+      output.append(chunk, output_size);
+      input.remove_prefix(input_size);
+    }
+    LZ4F_freeDecompressionContext(context);
+    return hint == 0;   // the end of the frame
+  }
+#endif
+};
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::sink
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_CODEC_HPP
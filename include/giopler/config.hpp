@@ -122,6 +122,38 @@ constexpr std::string_view get_platform_name() {
   return "Unknown"sv;
 }
 
+// -----------------------------------------------------------------------------
+/// Header-only or compiled core library.
+// By default the library is header-only, and the core functions are defined inline in every
+// translation unit that includes the headers.
+// Define GIOPLER_CORE_LIBRARY to link with the compiled giopler_core library instead;
+// the headers then only declare the core functions, so the record building, serialization,
+// and error handling code is compiled once (src/giopler_core.cpp defines GIOPLER_CORE_IMPLEMENTATION).
+#if defined(GIOPLER_CORE_IMPLEMENTATION)
+#define GIOPLER_CORE_DEFINITIONS 1
+#define GIOPLER_CORE_INLINE
+#elif defined(GIOPLER_CORE_LIBRARY)
+#define GIOPLER_CORE_DEFINITIONS 0
+#define GIOPLER_CORE_INLINE
+#else
+#define GIOPLER_CORE_DEFINITIONS 1
+#define GIOPLER_CORE_INLINE inline
+#endif
+
+// -----------------------------------------------------------------------------
+/// Keep the slow paths out of the instrumented functions.
+// GIOPLER_OUTLINE is for code that runs on every call, but is too large to inline (building records).
+// GIOPLER_COLD is for code that rarely runs (failed contracts, errors, thread start).
+// The compiler moves cold functions into .text.unlikely, and treats the paths calling them as unlikely,
+// so it must not be used on code every call goes through, or the caller is optimized for size.
+#define GIOPLER_OUTLINE [[gnu::noinline]]
+#define GIOPLER_COLD    [[gnu::cold, gnu::noinline]]
+
+// -----------------------------------------------------------------------------
+/// Functions called at the instrumentation sites.
+// They are always inlined, even without optimization, so each site has its own probe (see probe.hpp).
+#define GIOPLER_SITE_INLINE [[gnu::always_inline]] inline
+
 // -----------------------------------------------------------------------------
 /// CPU architecture.
 enum class Architecture {X86, Arm, Unknown};
@@ -25,6 +25,7 @@
 
 #include "giopler/utility.hpp"
 #include "giopler/sink.hpp"
+#include "giopler/probe.hpp"
 
 // -----------------------------------------------------------------------------
 /// Contracts to ensure correct program behavior.
@@ -52,6 +53,19 @@ public:
     contract_violation& operator=(contract_violation&&) = default;
 };
 
+// -----------------------------------------------------------------------------
+/// write the Failed event for a contract and throw contract_violation
+// this is a private function for library internal use only
+// the description completes the exception message, for example "invalid argument"
+[[noreturn]] GIOPLER_COLD
+void contract_failed(const source_location& source_location, Event event, std::string_view description);
+
+// -----------------------------------------------------------------------------
+/// write the Passed event for a contract, used for tracing in Dev mode
+// this is a private function for library internal use only
+GIOPLER_OUTLINE
+void contract_passed(const source_location& source_location, Event event);
+
 // -----------------------------------------------------------------------------
 }   // namespace giopler
 
@@ -65,26 +79,15 @@ namespace giopler::dev
 /// errors that arise because an argument value has not been accepted
 // the function's expectation of its arguments upon entry into the function
 // logs the error and throws exception
-void argument([[maybe_unused]] const bool condition,
-              [[maybe_unused]] const source_location& source_location = source_location::current())
+GIOPLER_SITE_INLINE void argument([[maybe_unused]] const bool condition,
+                     [[maybe_unused]] const source_location& source_location = source_location::current())
 {
   if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Test || g_build_mode == BuildMode::Qa) {
+    GIOPLER_PROBE_SITE(site, "argument", EventCategory::Contract, Event::Argument, source_location);
     if (!condition) [[unlikely]] {
-      std::shared_ptr<Record> record_failed =
-          get_event_record(source_location, EventCategory::Contract, Event::Argument, UUID());
-      record_failed->insert_or_assign("status"s, "Failed");
-      sink::g_sink_manager.write_record(record_failed);
-      sink::g_sink_manager.flush();   // throw could terminate program
-
-      const std::string message =
-          gformat("ERROR: {}: invalid argument",
-                  format_source_location(source_location));
-      throw contract_violation{message};
+      contract_failed(source_location, Event::Argument, "invalid argument"sv);
     } else if constexpr (g_build_mode == BuildMode::Dev) {   // condition was met, but in Dev mode - send tracing event
-      std::shared_ptr<Record> record_passed =
-          get_event_record(source_location, EventCategory::Contract, Event::Argument, UUID());
-      record_passed->insert_or_assign("status"s, "Passed");
-      sink::g_sink_manager.write_record(record_passed);
+      if (is_probe_enabled(site, source_location))   contract_passed(source_location, Event::Argument);
     }
   }
 }
@@ -93,26 +96,15 @@ void argument([[maybe_unused]] const bool condition,
 /// expect conditions are like preconditions
 // the function's expectation of the state of other objects upon entry into the function
 // logs the error and throws exception
-void expect([[maybe_unused]] const bool condition,
-            [[maybe_unused]] const source_location& source_location = source_location::current())
+GIOPLER_SITE_INLINE void expect([[maybe_unused]] const bool condition,
+                   [[maybe_unused]] const source_location& source_location = source_location::current())
 {
   if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Test || g_build_mode == BuildMode::Qa) {
+    GIOPLER_PROBE_SITE(site, "expect", EventCategory::Contract, Event::Expect, source_location);
     if (!condition) [[unlikely]] {
-      std::shared_ptr<Record> record_failed =
-          get_event_record(source_location, EventCategory::Contract, Event::Expect, UUID());
-      record_failed->insert_or_assign("status"s, "Failed");
-      sink::g_sink_manager.write_record(record_failed);
-      sink::g_sink_manager.flush();   // throw could terminate program
-
-      const std::string message =
-          gformat("ERROR: {}: expect condition failed",
-                  format_source_location(source_location));
-      throw contract_violation{message};
+      contract_failed(source_location, Event::Expect, "expect condition failed"sv);
     } else if constexpr (g_build_mode == BuildMode::Dev) {   // condition was met, but in Dev mode - send tracing event
-      std::shared_ptr<Record> record_passed =
-          get_event_record(source_location, EventCategory::Contract, Event::Expect, UUID());
-      record_passed->insert_or_assign("status"s, "Passed");
-      sink::g_sink_manager.write_record(record_passed);
+      if (is_probe_enabled(site, source_location))   contract_passed(source_location, Event::Expect);
     }
   }
 }
@@ -120,27 +112,15 @@ void expect([[maybe_unused]] const bool condition,
 // -----------------------------------------------------------------------------
 /// confirms a condition that should be satisfied where it appears in a function body
 // logs the error and throws exception
-void confirm([[maybe_unused]] const bool condition,
-             [[maybe_unused]] const source_location& source_location =
-               source_location::current())
+GIOPLER_SITE_INLINE void confirm([[maybe_unused]] const bool condition,
+                    [[maybe_unused]] const source_location& source_location = source_location::current())
 {
   if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Test || g_build_mode == BuildMode::Qa) {
+    GIOPLER_PROBE_SITE(site, "confirm", EventCategory::Contract, Event::Confirm, source_location);
     if (!condition) [[unlikely]] {
-      std::shared_ptr<Record> record_failed =
-          get_event_record(source_location, EventCategory::Contract, Event::Confirm, UUID());
-      record_failed->insert_or_assign("status"s, "Failed");
-      sink::g_sink_manager.write_record(record_failed);
-      sink::g_sink_manager.flush();   // throw could terminate program
-
-      const std::string message =
-        gformat("ERROR: {}: confirm failed",
-               format_source_location(source_location));
-      throw contract_violation{message};
+      contract_failed(source_location, Event::Confirm, "confirm failed"sv);
     } else if constexpr (g_build_mode == BuildMode::Dev) {   // condition was met, but in Dev mode - send tracing event
-      std::shared_ptr<Record> record_passed =
-          get_event_record(source_location, EventCategory::Contract, Event::Confirm, UUID());
-      record_passed->insert_or_assign("status"s, "Passed");
-      sink::g_sink_manager.write_record(record_passed);
+      if (is_probe_enabled(site, source_location))   contract_passed(source_location, Event::Confirm);
     }
   }
 }
@@ -171,21 +151,9 @@ class Invariant final {
   {
     if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Test || g_build_mode == BuildMode::Qa) {
       if (!_condition_function()) [[unlikely]] {
-        std::shared_ptr<Record> record_failed =
-            get_event_record(source_location, EventCategory::Contract, Event::InvariantBegin, UUID());
-        record_failed->insert_or_assign("status"s, "Failed");
-        sink::g_sink_manager.write_record(record_failed);
-        sink::g_sink_manager.flush();   // throw could terminate program
-
-        const std::string message =
-            gformat("ERROR: {}: invariant failed on entry",
-                    format_source_location(_source_location));
-        throw contract_violation{message};
+        contract_failed(_source_location, Event::InvariantBegin, "invariant failed on entry"sv);
       } else if constexpr (g_build_mode == BuildMode::Dev) {   // condition was met, but in Dev mode - send tracing event
-        std::shared_ptr<Record> record_passed =
-            get_event_record(source_location, EventCategory::Contract, Event::InvariantBegin, UUID());
-        record_passed->insert_or_assign("status"s, "Passed");
-        sink::g_sink_manager.write_record(record_passed);
+        contract_passed(_source_location, Event::InvariantBegin);
       }
     }
   }
@@ -197,16 +165,7 @@ class Invariant final {
     if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Test || g_build_mode == BuildMode::Qa) {
       if (!_condition_function()) [[unlikely]] {
         try {
-          std::shared_ptr<Record> record_failed =
-              get_event_record(_source_location, EventCategory::Contract, Event::InvariantEnd, UUID());
-          record_failed->insert_or_assign("status"s, "Failed");
-          sink::g_sink_manager.write_record(record_failed);
-          sink::g_sink_manager.flush();   // throw could terminate program
-
-          const std::string message =
-              gformat("ERROR: {}: invariant failed on exit",
-                      format_source_location(_source_location));
-          throw contract_violation{message};
+          contract_failed(_source_location, Event::InvariantEnd, "invariant failed on exit"sv);
         } catch (...) {
           if (std::uncaught_exceptions() == _uncaught_exceptions) {
             throw;   // safe to rethrow
@@ -215,10 +174,7 @@ class Invariant final {
           }
         }
       } else if constexpr (g_build_mode == BuildMode::Dev) {   // condition was met, but in Dev mode - send tracing event
-        std::shared_ptr<Record> record_passed =
-            get_event_record(_source_location, EventCategory::Contract, Event::InvariantEnd, UUID());
-        record_passed->insert_or_assign("status"s, "Passed");
-        sink::g_sink_manager.write_record(record_passed);
+        contract_passed(_source_location, Event::InvariantEnd);
       }
     }
   }
@@ -250,16 +206,7 @@ class Ensure final {
     if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Test || g_build_mode == BuildMode::Qa) {
       if (!_condition_function()) [[unlikely]] {
         try {
-          std::shared_ptr<Record> record_failed =
-              get_event_record(_source_location, EventCategory::Contract, Event::Ensure, UUID());
-          record_failed->insert_or_assign("status"s, "Failed");
-          sink::g_sink_manager.write_record(record_failed);
-          sink::g_sink_manager.flush();   // throw could terminate program
-
-          const std::string message =
-              gformat("ERROR: {}: ensure condition failed on exit",
-                      format_source_location(_source_location));
-          throw contract_violation{message};
+          contract_failed(_source_location, Event::Ensure, "ensure condition failed on exit"sv);
         } catch (...) {
           if (std::uncaught_exceptions() == _uncaught_exceptions) {
             throw;   // safe to rethrow
@@ -268,10 +215,7 @@ class Ensure final {
           }
         }
       } else if constexpr (g_build_mode == BuildMode::Dev) {   // condition was met, but in Dev mode - send tracing event
-        std::shared_ptr<Record> record_passed =
-            get_event_record(_source_location, EventCategory::Contract, Event::Ensure, UUID());
-        record_passed->insert_or_assign("status"s, "Passed");
-        sink::g_sink_manager.write_record(record_passed);
+        contract_passed(_source_location, Event::Ensure);
       }
     }
   }
@@ -301,26 +245,15 @@ namespace giopler::prod
 /// confirms a condition that should be satisfied where it appears in a function body
 // logs the error and throws exception
 // this contract check is always enabled when the library is enabled, even in production mode
-void certify([[maybe_unused]] const bool condition,
-             [[maybe_unused]] const source_location& source_location = source_location::current())
+GIOPLER_SITE_INLINE void certify([[maybe_unused]] const bool condition,
+                    [[maybe_unused]] const source_location& source_location = source_location::current())
 {
   if constexpr (g_build_mode != BuildMode::Off) {
+    GIOPLER_PROBE_SITE(site, "certify", EventCategory::Contract, Event::Certify, source_location);
     if (!condition) [[unlikely]] {
-      std::shared_ptr<Record> record_failed =
-          get_event_record(source_location, EventCategory::Contract, Event::Certify, UUID());
-          record_failed->insert_or_assign("status"s, "Failed");
-      sink::g_sink_manager.write_record(record_failed);
-      sink::g_sink_manager.flush();   // throw could terminate program
-
-      const std::string message =
-          gformat("ERROR: {}: certify failed",
-                  format_source_location(source_location));
-      throw contract_violation{message};
+      contract_failed(source_location, Event::Certify, "certify failed"sv);
     } else if constexpr (g_build_mode == BuildMode::Dev) {   // condition was met, but in Dev mode - send tracing event
-      std::shared_ptr<Record> record_passed =
-          get_event_record(source_location, EventCategory::Contract, Event::Certify, UUID());
-      record_passed->insert_or_assign("status"s, "Passed");
-      sink::g_sink_manager.write_record(record_passed);
+      if (dev::is_probe_enabled(site, source_location))   contract_passed(source_location, Event::Certify);
     }
   }
 }
@@ -328,5 +261,40 @@ void certify([[maybe_unused]] const bool condition,
 // -----------------------------------------------------------------------------
 }   // namespace giopler::prod
 
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+namespace giopler {
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void contract_failed(const source_location& source_location, const Event event, const std::string_view description)
+{
+  std::shared_ptr<Record> record_failed =
+      get_event_record(source_location, EventCategory::Contract, event, UUID());
+  record_failed->insert_or_assign("status"s, "Failed");
+  sink::g_sink_manager.write_record(record_failed);
+  sink::g_sink_manager.flush();   // throw could terminate program
+
+  const std::string message =
+      gformat("ERROR: {}: {}",
+              format_source_location(source_location), description);
+  throw contract_violation{message};
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void contract_passed(const source_location& source_location, const Event event)
+{
+  std::shared_ptr<Record> record_passed =
+      get_event_record(source_location, EventCategory::Contract, event, UUID());
+  record_passed->insert_or_assign("status"s, "Passed");
+  sink::g_sink_manager.write_record(record_passed);
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler
+#endif // GIOPLER_CORE_DEFINITIONS
+
 // -----------------------------------------------------------------------------
 #endif // defined GIOPLER_CONTRACT_HPP
@@ -0,0 +1,112 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_CONTROL_HPP
+#define GIOPLER_CONTROL_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+
+#include "giopler/config.hpp"
+#include "giopler/pcg.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler::dev {
+class Trace;
+class Profile;
+class Thread;
+class LinuxEvents;
+class PublishedFrames;
+class ThreadClass;
+class Span;
+}   // namespace giopler::dev
+
+namespace giopler::prod {
+class Id;
+class Class;
+class Attributes;
+}   // namespace giopler::prod
+
+// -----------------------------------------------------------------------------
+namespace giopler {
+
+// -----------------------------------------------------------------------------
+/// all the per-thread state of the library
+// this is a private class for library internal use only
+// Keeping it in one constant-initialized, trivially destructible object means every access
+// is a single load relative to the thread pointer, instead of a call to __tls_get_addr
+// or to a TLS wrapper function that checks whether the variable was initialized.
+// The fields used by every Function guard are in the first cache line.
+// The objects with real constructors and destructors (Thread, LinuxEvents, PublishedFrames)
+// are created when the thread first enters a Function, and are only pointed to from here.
+struct alignas(64) ThreadControlBlock {
+  enum class State : std::uint8_t { NotStarted, Running, Exited };
+  enum class Sampling : std::uint8_t { Undecided, Keep, Drop };   // see Sampler
+
+  // first cache line: every Function guard
+  dev::Trace* _trace_object                  = nullptr;   // innermost Trace
+  dev::Profile* _profile_object              = nullptr;   // innermost Profile
+  dev::LinuxEvents* _linux_events            = nullptr;   // performance counters (Prof)
+  dev::PublishedFrames* _published_frames    = nullptr;   // call stack readable by other threads
+  std::int64_t _sequence                     = 0;         // get_thread_sequence
+  prod::Id* _current_id                      = nullptr;
+  prod::Class* _current_class                = nullptr;
+  std::uint32_t _stack_depth                 = 0;         // Trace depth
+  State _state                               = State::NotStarted;
+  Sampling _sampling                         = Sampling::Undecided;   // for the current call tree
+  bool _uuid_seeded                          = false;
+
+  // second cache line: rarely used
+  alignas(64) pcg _uuid_generator{0, 0};                   // seeded on first use
+  prod::Attributes* _attributes              = nullptr;
+  dev::Thread* _thread                       = nullptr;
+  std::uint32_t _phase_generation            = 0;         // last g_phase_generation seen (Prof, Bench)
+  dev::ThreadClass* _thread_class            = nullptr;   // summarized thread, see set_thread_class
+  bool _counters_pending                     = false;     // open the counters on the first read
+  dev::Span* _span                           = nullptr;   // innermost span, see prod::Id (Prof)
+};
+static_assert(offsetof(ThreadControlBlock, _uuid_seeded) < 64, "guard fields must fit in the first cache line");
+
+// -----------------------------------------------------------------------------
+/// the control block of the current thread
+// external linkage, so every translation unit sees the same block
+// initial-exec requires the library to be linked into the program (or a library loaded at startup)
+[[gnu::tls_model("initial-exec")]] constinit inline thread_local ThreadControlBlock g_thread_control{};
+
+// -----------------------------------------------------------------------------
+/// a named phase of the program, see prod::Phase
+// this is a private class for library internal use only
+// the phases are interned and never destroyed, so any thread can keep a pointer to one
+struct PhaseInfo {
+  std::string _name;
+  bool _is_warmup = false;
+};
+
+// -----------------------------------------------------------------------------
+/// the innermost active phase of the program, or nullptr
+constinit inline std::atomic<const PhaseInfo*> g_current_phase{nullptr};
+
+/// changed every time a phase begins or ends
+// each thread compares it with ThreadControlBlock::_phase_generation to notice the change
+constinit inline std::atomic<std::uint32_t> g_phase_generation{1};
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_CONTROL_HPP
@@ -16,6 +16,11 @@
 #error Support for C++20 or newer is required to use this library.
 #endif
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
 #include <string>
 #include <string_view>
 
@@ -26,7 +31,7 @@ namespace giopler::dev {
 /// target += other
 // assumes all entries are numeric (Integer or Real)
 // assumes the 'other' Record contains all key values
-void add_number_record(Record& target, const Record& other) {
+inline void add_number_record(Record& target, const Record& other) {
   for (const auto& [key, value] : other) {
     if (value.get_type() == RecordValue::Type::Integer) {
       if (!target.contains(key)) {
@@ -49,7 +54,7 @@ void add_number_record(Record& target, const Record& other) {
 // assumes all entries are numeric (Integer or Real)
 // assumes the 'other' Record contains all key values
 // clamps values at zero - does not go negative
-void subtract_number_record(Record& target, const Record& other) {
+inline void subtract_number_record(Record& target, const Record& other) {
   for (const auto& [key, value] : other) {
     if (value.get_type() == RecordValue::Type::Integer) {
       if (!target.contains(key)) {
@@ -75,16 +80,139 @@ void subtract_number_record(Record& target, const Record& other) {
   }
 }
 
+// -----------------------------------------------------------------------------
+/// name of the set of counters read by read_event_counters()
+// "perf" (performance monitoring counters), "lite" (thread CPU time, resource usage, and time stamp counter),
+// or "none" (not a Prof build); reported in the program record
+extern std::string_view get_counter_set();
+
+// -----------------------------------------------------------------------------
+/// open platform-specific performance event counters for the current thread
+// called once when the thread starts, before read_event_counters()
+// a summarized thread sets ThreadControlBlock::_counters_pending instead, and they are opened on the first read
+extern void open_event_counters();
+
 // -----------------------------------------------------------------------------
 /// read platform-specific performance event counters
 // assumed to return the same set of keys on every invocation at a given platform
 extern Record read_event_counters();
 
+// -----------------------------------------------------------------------------
+/// read the CPU time and resource usage of the calling thread since it started
+// uses the same key names as the "lite" counter set, and does not need the counters to be open
+extern Record read_thread_counters();
+
+// -----------------------------------------------------------------------------
+/// read the CPU time and resource usage of the whole process
+// uses the same key names as the "lite" counter set
+extern Record read_process_counters();
+
+// -----------------------------------------------------------------------------
+/// an interned user-defined counter, see count()
+class CounterId final
+{
+ public:
+  constexpr CounterId() = default;   // not valid, counts are ignored
+
+  [[nodiscard]] bool is_valid() const {
+    return _index != _invalid;
+  }
+
+  [[nodiscard]] std::uint32_t get_index() const {
+    return _index;
+  }
+
+ private:
+  friend class UserCounterTable;
+  static constexpr std::uint32_t _invalid = UINT32_MAX;
+  std::uint32_t _index = _invalid;
+
+  constexpr explicit CounterId(const std::uint32_t index) : _index{index} { }
+};
+
+// -----------------------------------------------------------------------------
+/// the names of the user-defined counters
+// this is a private class for library internal use only
+// a counter name is interned once and never removed, so every Profile frame can keep
+// the counter values in a fixed-size array indexed by the counter id, without allocating
+// the names are reported with a "usr_" prefix, next to the hardware counters
+// lookups do not take the lock; a name is stored before the count that makes it visible
+class UserCounterTable final
+{
+ public:
+  static constexpr std::uint32_t _max_counters = 32;
+
+  /// id for the counter name, creating it the first time
+  // returns an invalid id if there are already _max_counters counters
+  CounterId intern(const std::string_view name) {
+    const CounterId found = find(name);
+    if (found.is_valid())   return found;
+
+    const std::lock_guard<std::mutex> lock{_mutex};
+    const std::uint32_t size = _size.load(std::memory_order_relaxed);
+    for (std::uint32_t index = 0; index < size; ++index) {
+      if (_names[index] == name)   return CounterId{index};
+    }
+    if (size == _max_counters) {
+      std::cerr << "WARNING: UserCounterTable: too many counters, '" << name << "' is ignored" << std::endl;
+      return CounterId{};
+    }
+    _names[size] = std::string{name};
+    _keys[size]  = "usr_" + std::string{name};
+    _size.store(size+1, std::memory_order_release);
+    return CounterId{size};
+  }
+
+  [[nodiscard]] std::uint32_t size() const {
+    return _size.load(std::memory_order_acquire);
+  }
+
+  /// record key for the counter
+  [[nodiscard]] const std::string& get_key(const std::uint32_t index) const {
+    return _keys[index];
+  }
+
+ private:
+  std::mutex _mutex;   // serializes the additions
+  std::atomic<std::uint32_t> _size{0};
+  std::array<std::string, _max_counters> _names;
+  std::array<std::string, _max_counters> _keys;
+
+  [[nodiscard]] CounterId find(const std::string_view name) const {
+    const std::uint32_t size = _size.load(std::memory_order_acquire);
+    for (std::uint32_t index = 0; index < size; ++index) {
+      if (_names[index] == name)   return CounterId{index};
+    }
+    return CounterId{};
+  }
+};
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY the single instance is in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+GIOPLER_CORE_INLINE UserCounterTable g_user_counters;
+#else
+extern UserCounterTable g_user_counters;
+#endif
+
+// -----------------------------------------------------------------------------
+/// id of the user-defined counter with this name, for use with count()
+// looking up the id once avoids comparing the name on every count
+// static const giopler::dev::CounterId rows_id = giopler::dev::get_counter_id("rows");
+inline CounterId get_counter_id([[maybe_unused]] const std::string_view name) {
+  if constexpr (g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench) {
+    return g_user_counters.intern(name);
+  } else {
+    return {};
+  }
+}
+
 // -----------------------------------------------------------------------------
 }   // namespace giopler::dev
 
 // -----------------------------------------------------------------------------
-#if defined(GIOPLER_PLATFORM_LINUX)
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if defined(GIOPLER_PLATFORM_LINUX) && GIOPLER_CORE_DEFINITIONS
 #include "giopler/linux/counter.hpp"
 #endif
 
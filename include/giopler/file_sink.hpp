@@ -0,0 +1,70 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_FILE_SINK_HPP
+#define GIOPLER_FILE_SINK_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "giopler/config.hpp"
+#include "giopler/utility.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler::sink {
+
+// -----------------------------------------------------------------------------
+/// records the events into a local file instead of sending them to the server
+// GIOPLER_RECORD is the path of the file, which is appended to
+// each batch of events is written as one JSON array, followed by a new line
+// the recordings are read by the tools, for example giopler_diff
+// there is only one of these objects, shared by all the sink processes
+// the stream lock keeps the batches from different processes from interleaving
+class File final
+{
+ public:
+  explicit File(const std::string& path)
+  : _file{std::fopen(path.c_str(), "ae")}
+  {
+    if (!_file) {
+      throw std::runtime_error{gformat("Giopler: could not open recording file '{}'", path)};
+    }
+  }
+
+  ~File() {
+    std::fclose(_file);
+  }
+
+  File(const File&) = delete;
+  File& operator=(const File&) = delete;
+
+  void write_records(std::string_view json_body) {
+    flockfile(_file);
+    std::fwrite(json_body.data(), 1, json_body.size(), _file);
+    std::fputc('\n', _file);
+    funlockfile(_file);
+  }
+
+ private:
+  std::FILE* _file;
+};
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::sink
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_FILE_SINK_HPP
@@ -0,0 +1,168 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_FRAME_HPP
+#define GIOPLER_FRAME_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "giopler/config.hpp"
+#include "giopler/platform.hpp"
+#include "giopler/control.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+class PublishedFrames;
+
+// -----------------------------------------------------------------------------
+/// list of the threads that are publishing their call stacks
+// this is a private class for library internal use only
+// the mutex is only taken by the monitored threads when they start and exit
+// sampler threads take it while they walk the list
+class FrameRegistry final
+{
+ public:
+  void add(PublishedFrames* frames) {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    _frames.push_back(frames);
+  }
+
+  void remove(PublishedFrames* frames) {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    _frames.erase(std::remove(_frames.begin(), _frames.end(), frames), _frames.end());
+  }
+
+  /// call the function once for every thread publishing its call stack
+  // the threads cannot exit while we are walking the list
+  template<typename F>
+  void for_each(F function) {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    for (PublishedFrames* frames : _frames) {
+      function(*frames);
+    }
+  }
+
+ private:
+  std::mutex _mutex;
+  std::vector<PublishedFrames*> _frames;
+};
+
+// -----------------------------------------------------------------------------
+inline FrameRegistry g_frame_registry;
+
+// -----------------------------------------------------------------------------
+/// call stack of function names and start times for one thread, readable by other threads
+// this is a private class for library internal use only
+// only the owning thread writes to it, and it never blocks while doing so
+// other threads might see a slightly stale stack, which is fine for sampling
+// frames deeper than max_depth are counted, but their names are not kept
+class PublishedFrames final
+{
+ public:
+  static constexpr std::uint32_t max_depth = 128;
+
+  /// copy of the stack taken by another thread
+  struct Snapshot {
+    std::uint64_t _thread_id = 0;
+    std::uint32_t _depth     = 0;   // frames kept, at most max_depth
+    std::array<const char*, max_depth> _functions{};
+    std::array<std::uint64_t, max_depth> _start_ns{};   // steady clock
+  };
+
+  ~PublishedFrames() {
+    if (g_thread_control._published_frames == this)   g_thread_control._published_frames = nullptr;
+    if (_thread_id)   g_frame_registry.remove(this);
+  }
+
+  void push(const char* function_name) {
+    if (!_thread_id) [[unlikely]] {   // first frame seen in this thread
+      _thread_id = giopler::get_thread_id();
+      g_frame_registry.add(this);
+    }
+
+    // odd while the frame is being written, see get_snapshot
+    const std::uint32_t changes = _changes.load(std::memory_order_relaxed);
+    _changes.store(changes+1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const std::uint32_t depth = _depth.load(std::memory_order_relaxed);
+    if (depth < max_depth) {
+      const auto start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+      _functions[depth].store(function_name, std::memory_order_relaxed);
+      _start_ns[depth].store(static_cast<std::uint64_t>(start_ns), std::memory_order_relaxed);
+    }
+    _depth.store(depth+1, std::memory_order_release);
+    _changes.store(changes+2, std::memory_order_release);
+  }
+
+  void pop() {
+    _depth.store(_depth.load(std::memory_order_relaxed)-1, std::memory_order_release);
+  }
+
+  /// name of the innermost function, or nullptr if none
+  [[nodiscard]] const char* get_top() const {
+    const std::uint32_t depth = std::min(_depth.load(std::memory_order_acquire), max_depth);
+    return depth ? _functions[depth-1].load(std::memory_order_relaxed) : nullptr;
+  }
+
+  [[nodiscard]] std::uint64_t get_thread_id() const {
+    return _thread_id;
+  }
+
+  /// copy the whole stack
+  // returns false if a frame was pushed while copying; try again later
+  // popped frames do not matter, the frames below them are unchanged
+  [[nodiscard]] bool get_snapshot(Snapshot& snapshot) const {
+    const std::uint32_t changes = _changes.load(std::memory_order_acquire);
+    if (changes & 1u)   return false;
+
+    snapshot._thread_id = _thread_id;
+    snapshot._depth     = std::min(_depth.load(std::memory_order_acquire), max_depth);
+    for (std::uint32_t frame = 0; frame < snapshot._depth; ++frame) {
+      snapshot._functions[frame] = _functions[frame].load(std::memory_order_relaxed);
+      snapshot._start_ns[frame]  = _start_ns[frame].load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return _changes.load(std::memory_order_relaxed) == changes;
+  }
+
+ private:
+  std::uint64_t _thread_id = 0;   // zero until registered
+  std::atomic<std::uint32_t> _depth{0};
+  std::atomic<std::uint32_t> _changes{0};   // incremented twice by every push
+  std::array<std::atomic<const char*>, max_depth> _functions{};
+  std::array<std::atomic<std::uint64_t>, max_depth> _start_ns{};
+};
+
+// -----------------------------------------------------------------------------
+/// call stack published by the current thread
+// accessed through ThreadControlBlock::_published_frames once the thread has started
+inline thread_local PublishedFrames g_published_frames;
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_FRAME_HPP
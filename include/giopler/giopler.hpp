@@ -21,9 +21,11 @@
 
 // -----------------------------------------------------------------------------
 // compiling in Release mode, we have lots of unused variables
+// the header-only core functions are declared noinline (GIOPLER_OUTLINE, GIOPLER_COLD) and defined inline
 #if defined(GIOPLER_COMPILER_GCC)
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-variable"
+#pragma GCC diagnostic ignored "-Wattributes"
 #elif defined(GIOPLER_COMPILER_CLANG)
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunused-variable"
@@ -34,6 +36,8 @@
 #include "giopler/utility.hpp"
 #include "giopler/record.hpp"
 #include "giopler/sink.hpp"
+#include "giopler/sampling.hpp"
+#include "giopler/probe.hpp"
 #include "giopler/exit.hpp"
 
 #include "giopler/contract.hpp"
@@ -41,7 +45,13 @@
 #include "giopler/log.hpp"
 
 #include "giopler/counter.hpp"
+#include "giopler/phase.hpp"
+#include "giopler/trigger.hpp"
 #include "giopler/profile.hpp"
+#include "giopler/parallel.hpp"
+#include "giopler/memory.hpp"
+#include "giopler/watchdog.hpp"
+#include "giopler/allocator.hpp"
 
 // -----------------------------------------------------------------------------
 // restore diagnostic settings
@@ -0,0 +1,71 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_HARDWARE_HPP
+#define GIOPLER_HARDWARE_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <memory>
+#include <string>
+
+#include "giopler/config.hpp"
+#include "giopler/utility.hpp"
+#include "giopler/record.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler {
+
+// -----------------------------------------------------------------------------
+/// read platform-specific hardware and operating system description
+// CPU model and flags, caches, SMT, NUMA, huge pages, kernel, and performance counter access
+// this is expensive to collect, use get_hardware_record() instead
+extern std::shared_ptr<Record> read_hardware_record();
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if defined(GIOPLER_PLATFORM_LINUX) && GIOPLER_CORE_DEFINITIONS
+#include "giopler/linux/hardware.hpp"
+#endif
+
+// -----------------------------------------------------------------------------
+namespace giopler {
+
+// -----------------------------------------------------------------------------
+/// hardware description, collected once per program run
+// it is sent in full only with the ProgramBegin event
+inline std::shared_ptr<Record> get_hardware_record() {
+  static const std::shared_ptr<Record> hardware_record{read_hardware_record()};
+  return hardware_record;
+}
+
+// -----------------------------------------------------------------------------
+/// identifies the hardware description
+// other events refer to the hardware description using this value
+inline std::string get_hardware_hash() {
+  static const std::string hardware_hash = [] {
+    std::string hardware_json;
+    record_to_json(get_hardware_record(), hardware_json);
+    return gformat("{:016x}", hash_fnv1a(hardware_json));
+  }();
+  return hardware_hash;
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_HARDWARE_HPP
@@ -0,0 +1,141 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_JSON_ESCAPE_HPP
+#define GIOPLER_JSON_ESCAPE_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// -----------------------------------------------------------------------------
+// https://www.rfc-editor.org/rfc/rfc8259#section-7
+namespace giopler {
+
+// -----------------------------------------------------------------------------
+/// true for the characters that must be escaped in a JSON string: '"', '\', and U+0000 to U+001F
+constexpr bool is_json_escaped(const char c) {
+  return static_cast<unsigned char>(c) < 0x20 || c == '"' || c == '\\';
+}
+
+// -----------------------------------------------------------------------------
+/// pointer to the first character that must be escaped, or end
+// most strings need no escaping, so the scan is done 32 or 16 bytes at a time where the processor allows it
+// the instruction set is chosen at compile time (-mavx2, or the SSE2 and NEON baselines)
+inline const char* find_json_escaped(const char* text, const char* const end)
+{
+#if defined(__AVX2__)
+  const __m256i quote32     = _mm256_set1_epi8('"');
+  const __m256i backslash32 = _mm256_set1_epi8('\\');
+  const __m256i control32   = _mm256_set1_epi8(0x1f);
+  while (end - text >= 32) {
+    const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text));
+    const __m256i found = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote32), _mm256_cmpeq_epi8(chunk, backslash32)),
+        _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, control32), chunk));   // unsigned chunk <= 0x1f
+    const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(found));
+    if (mask)   return text + std::countr_zero(mask);
+    text += 32;
+  }
+#endif
+
+#if defined(__SSE2__)
+  const __m128i quote     = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control   = _mm_set1_epi8(0x1f);
+  while (end - text >= 16) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text));
+    const __m128i found = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+        _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));   // unsigned chunk <= 0x1f
+    const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(found));
+    if (mask)   return text + std::countr_zero(mask);
+    text += 16;
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  const uint8x16_t quote     = vdupq_n_u8('"');
+  const uint8x16_t backslash = vdupq_n_u8('\\');
+  const uint8x16_t control   = vdupq_n_u8(0x1f);
+  while (end - text >= 16) {
+    const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const std::uint8_t*>(text));
+    const uint8x16_t found = vorrq_u8(vorrq_u8(vceqq_u8(chunk, quote), vceqq_u8(chunk, backslash)),
+                                      vcleq_u8(chunk, control));
+    if (vmaxvq_u8(found)) {
+      // narrow each byte of the mask to four bits, then count the zero bits before the first match
+      const std::uint64_t mask =
+          vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(found), 4)), 0);
+      return text + (std::countr_zero(mask) >> 2);
+    }
+    text += 16;
+  }
+#endif
+
+  while (text != end && !is_json_escaped(*text))   ++text;
+  return text;
+}
+
+// -----------------------------------------------------------------------------
+/// append the escape sequence for one character
+inline void append_json_escape(std::string& buffer, const char c)
+{
+  switch (c) {
+    case '"':   buffer.append("\\\""); break;
+    case '\\':  buffer.append("\\\\"); break;
+    case '\b':  buffer.append("\\b");  break;
+    case '\f':  buffer.append("\\f");  break;
+    case '\n':  buffer.append("\\n");  break;
+    case '\r':  buffer.append("\\r");  break;
+    case '\t':  buffer.append("\\t");  break;
+    default: {
+      constexpr std::string_view hex_digits = "0123456789abcdef";
+      const auto code = static_cast<unsigned char>(c);
+      const char escape[6] = {'\\', 'u', '0', '0', hex_digits[code >> 4], hex_digits[code & 0xf]};
+      buffer.append(escape, sizeof(escape));
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+/// append the text to the buffer as a quoted and escaped JSON string
+// the runs of characters that need no escaping are copied as a block
+// the bytes are otherwise passed through, so the text should be valid UTF-8
+inline void append_json_string(std::string& buffer, const std::string_view text)
+{
+  buffer.push_back('"');
+  const char* begin     = text.data();
+  const char* const end = begin + text.size();
+  while (true) {
+    const char* const escaped = find_json_escaped(begin, end);
+    buffer.append(begin, escaped);
+    if (escaped == end)   break;
+    append_json_escape(buffer, *escaped);
+    begin = escaped + 1;
+  }
+  buffer.push_back('"');
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_JSON_ESCAPE_HPP
@@ -17,8 +17,11 @@
 #endif
 
 #include <math.h>
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include "giopler/record.hpp"
+#include "giopler/linux/offcpu.hpp"
 
 // -----------------------------------------------------------------------------
 /// Performance Monitoring Counters (pmc), a Linux feature.
@@ -26,8 +29,14 @@
 #include <linux/hw_breakpoint.h>          // Definition of HW_* constants
 #include <sys/syscall.h>                  // Definition of SYS_* constants
 #include <sys/ioctl.h>
+#include <sys/resource.h>                 // getrusage
+#include <ctime>                          // clock_gettime
 #include <unistd.h>
 
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>                    // __rdtsc
+#endif
+
 // -----------------------------------------------------------------------------
 namespace giopler::dev
 {
@@ -49,7 +58,7 @@ class LinuxEvent final {
     _name2 = name2;
     _fd2   = open_event(name2, event_type2, event2, _fd1);
 
-    reset_event(name1, _fd1, (_num_events == 1 ? Group::single : Group::leader));
+    if (is_open())   reset_event(name1, _fd1, (_num_events == 1 ? Group::single : Group::leader));
   }
 
   LinuxEvent(const std::string_view name1, const uint32_t event_type1, const uint64_t event1,
@@ -62,7 +71,7 @@ class LinuxEvent final {
     _name3 = name3;
     _fd3   = open_event(name3, event_type3, event3, _fd1);
 
-    reset_event(name1, _fd1, (_num_events == 1 ? Group::single : Group::leader));
+    if (is_open())   reset_event(name1, _fd1, (_num_events == 1 ? Group::single : Group::leader));
   }
 
   LinuxEvent(const std::string_view name1, const uint32_t event_type1, const uint64_t event1,
@@ -78,11 +87,11 @@ class LinuxEvent final {
     _name4 = name4;
     _fd4   = open_event(name4, event_type4, event4, _fd1);
 
-    reset_event(name1, _fd1, (_num_events == 1 ? Group::single : Group::leader));
+    if (is_open())   reset_event(name1, _fd1, (_num_events == 1 ? Group::single : Group::leader));
   }
 
   ~LinuxEvent() {
-    disable_event(_name1, _fd1, (_num_events == 1 ? Group::single : Group::leader));
+    if (_fd1 != -1)   disable_event(_name1, _fd1, (_num_events == 1 ? Group::single : Group::leader));
 
     switch (_num_events) {
       case 4: close_event(_name4, _fd4);   /* fall-through */
@@ -92,6 +101,16 @@ class LinuxEvent final {
     }
   }
 
+  /// true if all the events of the group were opened
+  [[nodiscard]] bool is_open() const {
+    return !_failed_name.data();
+  }
+
+  /// the first event that could not be opened, and why
+  [[nodiscard]] std::string get_open_error() const {
+    return is_open() ? std::string{} : gformat("{}: {}", _failed_name, std::strerror(_open_errno));
+  }
+
   void reset_events() {
     reset_event(_name1, _fd1, (_num_events == 1 ? Group::single : Group::leader));
   }
@@ -124,11 +143,22 @@ class LinuxEvent final {
     return read_event(_name4, _fd4);
   }
 
+  /// fraction of the time the group was enabled that it was counting
+  // less than one when the kernel multiplexes more events than the hardware has counters;
+  // the values returned by read_event are scaled up by its inverse
+  double get_running_fraction() {
+    const ReadData read_data = read_data_event(_name1, _fd1);
+    if (!read_data.time_enabled)   return 1.0;
+    return static_cast<double>(read_data.time_running) / static_cast<double>(read_data.time_enabled);
+  }
+
  private:
   enum class Group { leader, single };
   const int _num_events;
   std::string_view _name1, _name2, _name3, _name4;
   int _fd1 = -1, _fd2 = -1, _fd3 = -1, _fd4 = -1;     // file descriptors
+  std::string_view _failed_name;                      // first event that could not be opened
+  int _open_errno = 0;
 
   // measures the calling process/thread on any CPU
   // state saved/restored on context switch
@@ -137,8 +167,9 @@ class LinuxEvent final {
     return static_cast<int>(syscall(__NR_perf_event_open, hw_event, pid, cpu, group_fd, flags));
   }
 
-  static int open_event(const std::string_view name,
-                        const uint32_t event_type, const uint64_t event, const int group_fd) {
+  // returns -1 if the event could not be opened; the caller checks is_open()
+  int open_event(const std::string_view name,
+                 const uint32_t event_type, const uint64_t event, const int group_fd) {
     struct perf_event_attr perf_event_attr{};
     perf_event_attr.size = sizeof(perf_event_attr);
     perf_event_attr.type = event_type;
@@ -149,63 +180,66 @@ class LinuxEvent final {
     perf_event_attr.exclude_hv = 1;
 
     const int fd = perf_event_open(&perf_event_attr, 0, -1, group_fd, 0);
-    if (fd == -1) {
-      std::cerr << "ERROR: LinuxEvent::open_event: " << name << ": " << std::strerror(errno) << std::endl;
-      std::exit(EXIT_FAILURE);
+    if (fd == -1 && is_open()) {
+      _failed_name = name;
+      _open_errno  = errno;
     }
 
     return fd;
   }
 
+  // the counters are only measurements; a failure must not stop the program
+  static void report_error(const std::string_view operation, const std::string_view name) {
+    static std::atomic_flag reported = ATOMIC_FLAG_INIT;
+    if (!reported.test_and_set()) {
+      std::cerr << "WARNING: LinuxEvent::" << operation << ": " << name << ": " << std::strerror(errno)
+                << " (some counter values will be zero)" << std::endl;
+    }
+  }
+
   static void reset_event(const std::string_view name, const int fd, const Group group) {
     const int status = ioctl(fd, PERF_EVENT_IOC_RESET, (group == Group::leader ? PERF_IOC_FLAG_GROUP : 0));
-    if (status == -1) {
-      std::cerr << "ERROR: LinuxEvent::reset_event: " << name << ": " << std::strerror(errno) << std::endl;
-      std::exit(EXIT_FAILURE);
-    }
+    if (status == -1)   report_error("reset_event", name);
   }
 
   static void disable_event(const std::string_view name, const int fd, const Group group) {
     const int status = ioctl(fd, PERF_EVENT_IOC_DISABLE, (group == Group::leader ? PERF_IOC_FLAG_GROUP : 0));
-    if (status == -1) {
-      std::cerr << "ERROR: LinuxEvent::disable_event: " << name << ": " << std::strerror(errno) << std::endl;
-      std::exit(EXIT_FAILURE);
-    }
+    if (status == -1)   report_error("disable_event", name);
   }
 
   static void enable_event(const std::string_view name, const int fd, const Group group) {
     const int status = ioctl(fd, PERF_EVENT_IOC_ENABLE, (group == Group::leader ? PERF_IOC_FLAG_GROUP : 0));
-    if (status == -1) {
-      std::cerr << "ERROR: LinuxEvent::enable_event: " << name << ": " << std::strerror(errno) << std::endl;
-      std::exit(EXIT_FAILURE);
-    }
+    if (status == -1)   report_error("enable_event", name);
   }
 
   static void close_event(const std::string_view name, const int fd) {
+    if (fd == -1)   return;   // was never opened
     const int status = close(fd);
-    if (status == -1) {
-      std::cerr << "ERROR: LinuxEvent::close_event: " << name << ": " << std::strerror(errno) << std::endl;
-      std::exit(EXIT_FAILURE);
-    }
+    if (status == -1)   report_error("close_event", name);
   }
 
-  /// read the counter value
-  // the value is scaled to account for performance counter multiplexing
-  static int64_t read_event(const std::string_view name, const int fd) {
-    struct ReadData {
-      uint64_t value;         /* The value of the event */
-      uint64_t time_enabled;  /* if PERF_FORMAT_TOTAL_TIME_ENABLED */
-      uint64_t time_running;  /* if PERF_FORMAT_TOTAL_TIME_RUNNING */
-      uint64_t id;            /* if PERF_FORMAT_ID */
-    };
+  struct ReadData {
+    uint64_t value;         /* The value of the event */
+    uint64_t time_enabled;  /* if PERF_FORMAT_TOTAL_TIME_ENABLED */
+    uint64_t time_running;  /* if PERF_FORMAT_TOTAL_TIME_RUNNING */
+    uint64_t id;            /* if PERF_FORMAT_ID */
+  };
 
+  /// read the unscaled counter value and its times
+  static ReadData read_data_event(const std::string_view name, const int fd) {
     ReadData read_data{};
     const ssize_t bytes_read = read(fd, &read_data, sizeof(read_data));
     if (bytes_read == -1) {
-      std::cerr << "ERROR: LinuxEvent::read_event: " << name << ": " << std::strerror(errno) << std::endl;
-      std::exit(EXIT_FAILURE);
+      report_error("read_event", name);
+      return ReadData{};
     }
+    return read_data;
+  }
 
+  /// read the counter value
+  // the value is scaled to account for performance counter multiplexing
+  static int64_t read_event(const std::string_view name, const int fd) {
+    const ReadData read_data = read_data_event(name, fd);
     if (read_data.time_enabled && read_data.time_running) {
       const double active_pct = static_cast<double>(read_data.time_running) / static_cast<double>(read_data.time_enabled);
       const std::int64_t scaled_counter = std::lround(static_cast<double>(read_data.value) * (1.0 / active_pct));
@@ -218,17 +252,92 @@ class LinuxEvent final {
   }
 };
 
+// -----------------------------------------------------------------------------
+/// the set of counters read by read_event_counters
+// Perf: performance monitoring counters (perf_event_open)
+// Lite: thread CPU time, thread resource usage, and the time stamp counter
+//       used when perf_event_open is not available, for example in containers
+//       with perf_event_paranoid=3, seccomp filters, or virtual machines without a PMU
+//       also selected with GIOPLER_COUNTERS=lite, since it is cheaper to read
+enum class CounterSet {None, Perf, Lite};
+
+// -----------------------------------------------------------------------------
+/// the time stamp counter, or the closest constant rate counter on the platform
+// counts at a constant rate whether the thread is running or not
+inline int64_t read_time_stamp_counter() {
+#if defined(__i386__) || defined(__x86_64__)
+  return static_cast<int64_t>(__rdtsc());
+#elif defined(__aarch64__)
+  uint64_t value;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(value));   // virtual counter, readable from user space
+  return static_cast<int64_t>(value);
+#else
+  return 0;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+/// CPU time and resource usage of the calling thread (RUSAGE_THREAD) or the process (RUSAGE_SELF)
+// the context switches and page faults keep the same names as the Perf counters
+inline Record get_resource_usage(const clockid_t clock_id, const int who) {
+  timespec cpu_time{};
+  clock_gettime(clock_id, &cpu_time);
+  rusage usage{};
+  getrusage(who, &usage);
+
+  return Record({
+    {"sw_task_clck"s,       static_cast<double>(cpu_time.tv_sec) + static_cast<double>(cpu_time.tv_nsec) / 1e9},
+    {"sw_user_time"s,       static_cast<double>(usage.ru_utime.tv_sec) + static_cast<double>(usage.ru_utime.tv_usec) / 1e6},
+    {"sw_sys_time"s,        static_cast<double>(usage.ru_stime.tv_sec) + static_cast<double>(usage.ru_stime.tv_usec) / 1e6},
+    {"sw_pg_fault"s,        static_cast<int64_t>(usage.ru_minflt + usage.ru_majflt)},
+    {"sw_pg_fault_min"s,    static_cast<int64_t>(usage.ru_minflt)},
+    {"sw_pg_fault_maj"s,    static_cast<int64_t>(usage.ru_majflt)},
+    {"sw_cntxt_swtch"s,     static_cast<int64_t>(usage.ru_nvcsw + usage.ru_nivcsw)},
+    {"sw_cntxt_swtch_vol"s, static_cast<int64_t>(usage.ru_nvcsw)},
+    {"sw_cntxt_swtch_inv"s, static_cast<int64_t>(usage.ru_nivcsw)}
+  });
+}
+
 // -----------------------------------------------------------------------------
 class LinuxEvents final {
  public:
-  explicit LinuxEvents() {
+  explicit LinuxEvents() : LinuxEvents(get_counter_set()) {
     if constexpr (g_build_mode == BuildMode::Prof) {
-      open_events();
-      enable_events();
+      if (_counter_set == CounterSet::None && get_counter_set() == CounterSet::Perf) {
+        // the probe worked, but this thread could not open them (for example, out of file descriptors)
+        static std::atomic_flag warned = ATOMIC_FLAG_INIT;
+        if (!warned.test_and_set()) {
+          std::cerr << "WARNING: LinuxEvents: " << _open_error << " (some threads will not have counters)" << std::endl;
+        }
+      }
+
+      static const bool is_off_cpu = std::getenv("GIOPLER_OFF_CPU");   // convert pointer to boolean
+      if (is_off_cpu && _counter_set != CounterSet::None) {
+        _off_cpu = std::make_unique<LinuxOffCpu>();
+        if (!_off_cpu->is_open())   _off_cpu.reset();
+      }
     }
   }
 
-  ~LinuxEvents() = default;   // events are closed when the objects are destroyed
+  ~LinuxEvents() {   // events are closed when the objects are destroyed
+    if (g_thread_control._linux_events == this)   g_thread_control._linux_events = nullptr;
+  }
+
+  /// the counter set every thread uses, decided once per process
+  // the probe opens the full set of performance counters once, and falls back to Lite if that fails
+  static CounterSet get_counter_set() {
+    static const CounterSet counter_set = probe_counter_set();
+    return counter_set;
+  }
+
+  static std::string_view get_counter_set_name() {
+    switch (get_counter_set()) {
+      case CounterSet::None:  return "none"sv;
+      case CounterSet::Perf:  return "perf"sv;
+      case CounterSet::Lite:  return "lite"sv;
+    }
+    return "none"sv;
+  }
 
   void enable_events() {
     _fd_sw_cpu_clock->enable_events();
@@ -247,8 +356,77 @@ class LinuxEvents final {
     _fd_hw_cache_references_misses_group->enable_events();
   }
 
+  /// the lowest running fraction of the hardware counter groups (see LinuxEvent::get_running_fraction)
+  // one unless the Perf counters are multiplexed
+  double get_running_fraction() {
+    if (_counter_set != CounterSet::Perf)   return 1.0;
+    return std::min({_fd_hw_cpu_cycles_instr_group->get_running_fraction(),
+                     _fd_hw_cpu_stalled_cycles_group->get_running_fraction(),
+                     _fd_hw_cache_references_misses_group->get_running_fraction(),
+                     _fd_hw_branch_instructions_misses_group->get_running_fraction()});
+  }
+
   /// get the current values of the performance counters
   Record get_snapshot() {
+    Record snapshot{(_counter_set == CounterSet::Perf) ? get_perf_snapshot() :
+                    (_counter_set == CounterSet::Lite) ? get_lite_snapshot() : Record{}};
+
+    if (_off_cpu) {
+      snapshot.insert({
+        {"off_cpu"s,            ns_to_sec(_off_cpu->get_off_cpu_ns())},
+        {"off_cpu_prmpt"s,      ns_to_sec(_off_cpu->get_preempted_ns())},
+        {"off_cpu_swtch"s,      _off_cpu->get_switch_count()}
+      });
+    }
+
+    return snapshot;
+  }
+
+ private:
+  CounterSet _counter_set = CounterSet::None;
+  std::string _open_error;   // why the Perf counters could not be opened
+
+  // opens the counters of the requested set, or leaves _counter_set as None if they cannot be opened
+  explicit LinuxEvents(const CounterSet counter_set) {
+    if constexpr (g_build_mode == BuildMode::Prof) {
+      if (counter_set == CounterSet::Perf) {
+        open_events();
+        _open_error = get_open_error();
+        if (_open_error.empty()) {
+          enable_events();
+          _counter_set = CounterSet::Perf;
+        }
+      } else {
+        _counter_set = counter_set;
+      }
+    }
+  }
+
+  static CounterSet probe_counter_set() {
+    if constexpr (g_build_mode != BuildMode::Prof) {
+      return CounterSet::None;
+    } else {
+      const char* counters = std::getenv("GIOPLER_COUNTERS");
+      if (counters && counters == "lite"sv)   return CounterSet::Lite;
+
+      const LinuxEvents probe{CounterSet::Perf};
+      if (probe._counter_set == CounterSet::Perf)   return CounterSet::Perf;
+
+      std::cerr << "WARNING: LinuxEvents: " << probe._open_error
+                << " (performance counters not available, using the lite counter set)" << std::endl;
+      return CounterSet::Lite;
+    }
+  }
+
+  /// thread CPU time and resource usage: one clock_gettime and one getrusage call
+  // the context switches and page faults keep the same names as the Perf counters
+  static Record get_lite_snapshot() {
+    Record snapshot{get_resource_usage(CLOCK_THREAD_CPUTIME_ID, RUSAGE_THREAD)};
+    snapshot.insert({{"tsc_cycl"s, read_time_stamp_counter()}});
+    return snapshot;
+  }
+
+  Record get_perf_snapshot() {
     return Record({
       {"sw_cpu_clck"s,        ns_to_sec(_fd_sw_cpu_clock->read_event())},
       {"sw_task_clck"s,       ns_to_sec(_fd_sw_task_clock->read_event())},
@@ -266,15 +444,14 @@ class LinuxEvents final {
       {"hw_stall_cycl_frnt"s, _fd_hw_cpu_stalled_cycles_group->read_event1()},
       {"hw_stall_cycl_back"s, _fd_hw_cpu_stalled_cycles_group->read_event2()},
 
-      {"hw_cache_ref"s,       _fd_hw_branch_instructions_misses_group->read_event1()},
-      {"hw_cache_miss"s,      _fd_hw_branch_instructions_misses_group->read_event2()},
+      {"hw_cache_ref"s,       _fd_hw_cache_references_misses_group->read_event1()},
+      {"hw_cache_miss"s,      _fd_hw_cache_references_misses_group->read_event2()},
 
-      {"hw_brnch_instr"s,     _fd_hw_cache_references_misses_group->read_event1()},
-      {"hw_brnch_miss"s,      _fd_hw_cache_references_misses_group->read_event2()}
+      {"hw_brnch_instr"s,     _fd_hw_branch_instructions_misses_group->read_event1()},
+      {"hw_brnch_miss"s,      _fd_hw_branch_instructions_misses_group->read_event2()}
     });
   }
 
- private:
   std::unique_ptr<LinuxEvent> _fd_sw_cpu_clock;         // CPU clock, a high-resolution per-CPU timer
   std::unique_ptr<LinuxEvent> _fd_sw_task_clock;        // clock count specific to the task that is running
   std::unique_ptr<LinuxEvent> _fd_sw_page_faults;       // number of page faults
@@ -301,6 +478,9 @@ class LinuxEvents final {
   // Mispredicted branch instructions.
   std::unique_ptr<LinuxEvent> _fd_hw_branch_instructions_misses_group;
 
+  // Time spent blocked or waiting for a CPU (GIOPLER_OFF_CPU).
+  std::unique_ptr<LinuxOffCpu> _off_cpu;
+
   // ---------------------------------------------------------------------------
   void open_events() {
     _fd_sw_cpu_clock = std::make_unique<LinuxEvent>("PERF_COUNT_SW_CPU_CLOCK",
@@ -346,17 +526,63 @@ class LinuxEvents final {
                                      "PERF_COUNT_HW_CACHE_MISSES",
                                      PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
   }
+
+  // the first event that could not be opened, or empty if all of them were
+  [[nodiscard]] std::string get_open_error() const {
+    for (const LinuxEvent* event : {_fd_sw_cpu_clock.get(), _fd_sw_task_clock.get(), _fd_sw_page_faults.get(),
+                                    _fd_sw_context_switches.get(), _fd_sw_cpu_migrations.get(),
+                                    _fd_sw_page_faults_min.get(), _fd_sw_page_faults_maj.get(),
+                                    _fd_sw_alignment_faults.get(), _fd_sw_emulation_faults.get(),
+                                    _fd_hw_cpu_cycles_instr_group.get(), _fd_hw_cpu_stalled_cycles_group.get(),
+                                    _fd_hw_cache_references_misses_group.get(), _fd_hw_branch_instructions_misses_group.get()}) {
+      if (!event->is_open())   return event->get_open_error();
+    }
+    return {};
+  }
 };
 
 // -----------------------------------------------------------------------------
 /// open the event counters when the thread is started
-static inline thread_local LinuxEvents g_linux_events;
+inline thread_local LinuxEvents g_linux_events;
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE std::string_view get_counter_set() {
+  return LinuxEvents::get_counter_set_name();
+}
+
+// -----------------------------------------------------------------------------
+/// open platform-specific performance event counters for the current thread
+// called once when the thread starts, before read_event_counters()
+GIOPLER_CORE_INLINE void open_event_counters() {
+  if constexpr (g_build_mode == BuildMode::Prof) {
+    g_thread_control._linux_events = &g_linux_events;
+  }
+}
 
 // -----------------------------------------------------------------------------
 /// read platform-specific performance event counters
 // assumed to return the same set of keys on every invocation at a given platform
-Record read_event_counters() {
-  return g_linux_events.get_snapshot();
+// returns an empty record if the counters are not open, or were already closed
+GIOPLER_CORE_INLINE Record read_event_counters() {
+  ThreadControlBlock& thread_control = g_thread_control;
+  if (thread_control._counters_pending) [[unlikely]] {
+    thread_control._counters_pending = false;   // only once, they are not reopened after the thread exits
+    open_event_counters();
+  }
+  LinuxEvents* linux_events = thread_control._linux_events;
+  return linux_events ? linux_events->get_snapshot() : Record{};
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE Record read_thread_counters() {
+  return get_resource_usage(CLOCK_THREAD_CPUTIME_ID, RUSAGE_THREAD);
+}
+
+// -----------------------------------------------------------------------------
+/// read the CPU time and resource usage of the whole process
+// available in every build mode; used at the boundaries of prod::Phase
+GIOPLER_CORE_INLINE Record read_process_counters() {
+  return get_resource_usage(CLOCK_PROCESS_CPUTIME_ID, RUSAGE_SELF);
 }
 
 // -----------------------------------------------------------------------------
@@ -0,0 +1,210 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_LINUX_HARDWARE_HPP
+#define GIOPLER_LINUX_HARDWARE_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/utsname.h>
+
+#include "giopler/record.hpp"
+
+// -----------------------------------------------------------------------------
+// https://www.kernel.org/doc/html/latest/admin-guide/abi-stable.html
+// https://www.kernel.org/doc/Documentation/ABI/testing/sysfs-devices-system-cpu
+// https://www.kernel.org/doc/html/latest/admin-guide/mm/hugetlbpage.html
+// https://www.kernel.org/doc/html/latest/admin-guide/perf-security.html
+namespace giopler {
+
+// -----------------------------------------------------------------------------
+/// first line of a /proc or /sys file, or empty if it could not be read
+GIOPLER_CORE_INLINE std::string read_system_file(const std::filesystem::path& path)
+{
+  std::ifstream file(path);
+  std::string line;
+  std::getline(file, line);
+  return line;
+}
+
+// -----------------------------------------------------------------------------
+/// integer value of a /proc or /sys file, or the default if it could not be read
+GIOPLER_CORE_INLINE int64_t read_system_file_integer(const std::filesystem::path& path, const int64_t default_value = 0)
+{
+  std::ifstream file(path);
+  int64_t value = default_value;
+  file >> value;
+  return file ? value : default_value;
+}
+
+// -----------------------------------------------------------------------------
+/// value of the first "name : value" line in /proc/cpuinfo with one of the given names
+// x86 and ARM use different names for the same fields
+GIOPLER_CORE_INLINE std::string read_cpuinfo_field(std::initializer_list<std::string_view> field_names)
+{
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    const std::size_t colon = line.find(':');
+    if (colon == std::string::npos)   continue;
+    std::string_view name = std::string_view(line).substr(0, colon);
+    name = name.substr(0, name.find_last_not_of(" \t") + 1);
+    if (std::find(field_names.begin(), field_names.end(), name) != field_names.end()) {
+      const std::size_t value_start = line.find_first_not_of(" \t", colon+1);
+      return (value_start == std::string::npos) ? ""s : line.substr(value_start);
+    }
+  }
+  return ""s;
+}
+
+// -----------------------------------------------------------------------------
+/// convert a sysfs size value ("32K", "8192K", "16M") into bytes
+GIOPLER_CORE_INLINE uint64_t parse_system_size(std::string_view size)
+{
+  uint64_t value = 0;
+  std::size_t index = 0;
+  while (index < size.size() && size[index] >= '0' && size[index] <= '9') {
+    value = value*10 + static_cast<uint64_t>(size[index++] - '0');
+  }
+  if (index < size.size()) {
+    switch (size[index]) {
+      case 'K': return value * 1024;
+      case 'M': return value * 1024 * 1024;
+      case 'G': return value * 1024 * 1024 * 1024;
+      default:  break;
+    }
+  }
+  return value;
+}
+
+// -----------------------------------------------------------------------------
+/// number of CPUs in a sysfs CPU list ("0-3,8-11")
+GIOPLER_CORE_INLINE uint64_t count_cpu_list(std::string_view cpu_list)
+{
+  uint64_t count = 0;
+  std::istringstream list_stream{std::string(cpu_list)};
+  std::string range;
+  while (std::getline(list_stream, range, ',')) {
+    const std::size_t dash = range.find('-');
+    if (dash == std::string::npos) {
+      count++;
+    } else {
+      count += std::stoul(range.substr(dash+1)) - std::stoul(range.substr(0, dash)) + 1;
+    }
+  }
+  return count;
+}
+
+// -----------------------------------------------------------------------------
+/// caches seen by the first CPU core
+// [{level, type, size, line, shared}, ...] with sizes in bytes
+GIOPLER_CORE_INLINE std::shared_ptr<giopler::Array> read_cache_array()
+{
+  std::shared_ptr<giopler::Array> caches{make_arena_shared<giopler::Array>()};
+  const std::filesystem::path cache_path{"/sys/devices/system/cpu/cpu0/cache"};
+  for (int index = 0; ; ++index) {
+    const std::filesystem::path index_path = cache_path / ("index" + std::to_string(index));
+    if (!std::filesystem::exists(index_path))   break;
+
+    caches->emplace_back(make_arena_shared<Record>(Record{
+        {"level"s,    read_system_file_integer(index_path / "level")},
+        {"type"s,     read_system_file(index_path / "type")},
+        {"size"s,     parse_system_size(read_system_file(index_path / "size"))},
+        {"line"s,     read_system_file_integer(index_path / "coherency_line_size")},
+        {"shared"s,   count_cpu_list(read_system_file(index_path / "shared_cpu_list"))}
+    }));
+  }
+  return caches;
+}
+
+// -----------------------------------------------------------------------------
+/// NUMA node distance matrix
+// [[10, 21], [21, 10]] for two nodes
+GIOPLER_CORE_INLINE std::shared_ptr<giopler::Array> read_numa_distance_array()
+{
+  std::shared_ptr<giopler::Array> distances{make_arena_shared<giopler::Array>()};
+  const std::filesystem::path node_path{"/sys/devices/system/node"};
+  for (int node = 0; ; ++node) {
+    const std::filesystem::path distance_path = node_path / ("node" + std::to_string(node)) / "distance";
+    if (!std::filesystem::exists(distance_path))   break;
+
+    std::shared_ptr<giopler::Array> node_distances{make_arena_shared<giopler::Array>()};
+    std::istringstream distance_stream{read_system_file(distance_path)};
+    int64_t distance;
+    while (distance_stream >> distance) {
+      node_distances->emplace_back(distance);
+    }
+    distances->emplace_back(node_distances);
+  }
+  return distances;
+}
+
+// -----------------------------------------------------------------------------
+/// huge page sizes supported by the kernel, in bytes
+GIOPLER_CORE_INLINE std::shared_ptr<giopler::Array> read_huge_page_array()
+{
+  std::shared_ptr<giopler::Array> huge_pages{make_arena_shared<giopler::Array>()};
+  std::error_code error_code;
+  for (const auto& entry : std::filesystem::directory_iterator("/sys/kernel/mm/hugepages", error_code)) {
+    const std::string name = entry.path().filename().string();   // hugepages-2048kB
+    if (name.starts_with("hugepages-")) {
+      huge_pages->emplace_back(static_cast<uint64_t>(std::stoull(name.substr("hugepages-"sv.size())) * 1024));
+    }
+  }
+  std::sort(huge_pages->begin(), huge_pages->end(), [](const RecordValue& a, const RecordValue& b) {
+    return a.get_integer() < b.get_integer();
+  });
+  return huge_pages;
+}
+
+// -----------------------------------------------------------------------------
+/// selected value in a sysfs option list ("always [madvise] never")
+GIOPLER_CORE_INLINE std::string read_system_file_selection(const std::filesystem::path& path)
+{
+  const std::string options = read_system_file(path);
+  const std::size_t begin = options.find('[');
+  const std::size_t end   = options.find(']', begin);
+  return (begin == std::string::npos || end == std::string::npos) ? options : options.substr(begin+1, end-begin-1);
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE std::shared_ptr<Record> read_hardware_record()
+{
+  struct utsname uts_name{};
+  const std::string kernel = (uname(&uts_name) == 0) ? uts_name.release : ""s;
+  const std::filesystem::path cpu0_path{"/sys/devices/system/cpu/cpu0"};
+
+  return make_arena_shared<Record>(Record{
+      {"cpu_model"s,      read_cpuinfo_field({"model name"sv, "Model"sv, "Processor"sv})},
+      {"cpu_flags"s,      read_cpuinfo_field({"flags"sv, "Features"sv})},
+      {"caches"s,         read_cache_array()},
+      {"smt_siblings"s,   count_cpu_list(read_system_file(cpu0_path / "topology/thread_siblings_list"))},
+      {"numa_dist"s,      read_numa_distance_array()},
+      {"huge_pages"s,     read_huge_page_array()},
+      {"thp"s,            read_system_file_selection("/sys/kernel/mm/transparent_hugepage/enabled")},
+      {"kernel"s,         kernel},
+      {"governor"s,       read_system_file(cpu0_path / "cpufreq/scaling_governor")},
+      {"perf_paranoid"s,  read_system_file_integer("/proc/sys/kernel/perf_event_paranoid", 2)}
+  });
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_LINUX_HARDWARE_HPP
@@ -0,0 +1,182 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_LINUX_OFFCPU_HPP
+#define GIOPLER_LINUX_OFFCPU_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+#include <linux/perf_event.h>             // Definition of PERF_* constants
+#include <sys/mman.h>
+#include <sys/syscall.h>                  // Definition of SYS_* constants
+#include <unistd.h>
+
+// -----------------------------------------------------------------------------
+// https://man7.org/linux/man-pages/man2/perf_event_open.2.html
+// https://www.brendangregg.com/offcpuanalysis.html
+namespace giopler::dev
+{
+
+// -----------------------------------------------------------------------------
+/// measures the time the current thread spends off the CPU
+// this is a private class for library internal use only
+// the kernel writes a PERF_RECORD_SWITCH record into a ring buffer every time the thread
+// is switched out or back in; the time between the two is time spent blocked (lock waits,
+// I/O, sleeps) or, if the thread was preempted, waiting for a CPU
+// the ring is drained every time the counters are read, so the totals are exact
+// at Function entry and exit, and the Profile deltas attribute the off-CPU time
+// to the Function that was running when the thread was switched out
+// enabled with GIOPLER_OFF_CPU because it costs two records per context switch
+class LinuxOffCpu final {
+ public:
+  LinuxOffCpu() {
+    struct perf_event_attr perf_event_attr{};
+    perf_event_attr.size           = sizeof(perf_event_attr);
+    perf_event_attr.type           = PERF_TYPE_SOFTWARE;
+    perf_event_attr.config         = PERF_COUNT_SW_DUMMY;   // we only want the side-band records
+    perf_event_attr.sample_type    = PERF_SAMPLE_TIME;
+    perf_event_attr.sample_id_all  = 1;                     // adds the time to the switch records
+    perf_event_attr.context_switch = 1;
+    perf_event_attr.use_clockid    = 1;
+    perf_event_attr.clockid        = CLOCK_MONOTONIC;
+    perf_event_attr.exclude_kernel = 1;
+    perf_event_attr.exclude_hv     = 1;
+
+    _fd = static_cast<int>(syscall(__NR_perf_event_open, &perf_event_attr, 0, -1, -1, 0));
+    if (_fd == -1) {
+      warn_once("perf_event_open");
+      return;
+    }
+
+    _ring = mmap(nullptr, (1+_data_pages)*_page_size, PROT_READ|PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (_ring == MAP_FAILED) {
+      warn_once("mmap");
+      _ring = nullptr;
+    }
+  }
+
+  ~LinuxOffCpu() {
+    if (_ring)     munmap(_ring, (1+_data_pages)*_page_size);
+    if (_fd != -1) close(_fd);
+  }
+
+  LinuxOffCpu(const LinuxOffCpu&) = delete;
+  LinuxOffCpu& operator=(const LinuxOffCpu&) = delete;
+
+  [[nodiscard]] bool is_open() const {
+    return _ring;
+  }
+
+  /// total time off the CPU since the thread started, in nanoseconds
+  [[nodiscard]] std::uint64_t get_off_cpu_ns()      { drain(); return _off_cpu_ns; }
+
+  /// part of the total caused by preemption rather than by the thread blocking
+  [[nodiscard]] std::uint64_t get_preempted_ns()    { drain(); return _preempted_ns; }
+
+  /// number of times the thread was switched out
+  [[nodiscard]] std::uint64_t get_switch_count()    { drain(); return _switch_count; }
+
+  /// records the kernel could not write because the ring was full
+  [[nodiscard]] std::uint64_t get_lost_count()      { drain(); return _lost_count; }
+
+ private:
+  static constexpr std::size_t _data_pages = 8;   // must be a power of two
+  static inline const std::size_t _page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+
+  int _fd = -1;
+  void* _ring = nullptr;
+  std::uint64_t _off_cpu_ns   = 0;
+  std::uint64_t _preempted_ns = 0;
+  std::uint64_t _switch_count = 0;
+  std::uint64_t _lost_count   = 0;
+  std::uint64_t _switch_out_time = 0;   // zero while running
+  bool _switch_out_preempted     = false;
+
+  static void warn_once(const char* operation) {
+    static std::atomic_flag warned = ATOMIC_FLAG_INIT;
+    if (!warned.test_and_set()) {
+      std::cerr << "WARNING: LinuxOffCpu: " << operation << ": " << std::strerror(errno)
+                << " (off-CPU times will not be reported)" << std::endl;
+    }
+  }
+
+  /// process all the records written since the last time
+  void drain() {
+    if (!_ring)   return;
+    auto* metadata           = static_cast<perf_event_mmap_page*>(_ring);
+    const auto* data         = static_cast<const std::uint8_t*>(_ring) + _page_size;
+    const std::uint64_t size = _data_pages * _page_size;
+
+    const std::uint64_t head = __atomic_load_n(&metadata->data_head, __ATOMIC_ACQUIRE);
+    std::uint64_t tail       = metadata->data_tail;
+
+    while (tail < head) {
+      // records are 8-byte aligned, so the header never wraps around the end of the ring
+      perf_event_header header{};
+      std::memcpy(&header, data + (tail % size), sizeof(header));
+
+      switch (header.type) {
+        case PERF_RECORD_SWITCH: {
+          // followed by sample_id, which only has the time in it
+          std::uint64_t time = 0;
+          const std::uint64_t time_offset = (tail + sizeof(header)) % size;
+          std::memcpy(&time, data + time_offset, sizeof(time));
+          on_switch(header.misc, time);
+          break;
+        }
+
+        case PERF_RECORD_LOST: {
+          std::uint64_t lost[2] = {};   // id, lost
+          const std::uint64_t lost_offset = (tail + sizeof(header)) % size;
+          std::memcpy(lost, data + lost_offset, sizeof(lost));
+          _lost_count += lost[1];
+          _switch_out_time = 0;   // we do not know which state we are in, so skip the next interval
+          break;
+        }
+
+        default:
+          break;
+      }
+
+      tail += header.size;
+    }
+
+    __atomic_store_n(&metadata->data_tail, tail, __ATOMIC_RELEASE);
+  }
+
+  void on_switch(const std::uint16_t misc, const std::uint64_t time) {
+    if (misc & PERF_RECORD_MISC_SWITCH_OUT) {
+      _switch_out_time      = time;
+      _switch_out_preempted = (misc & PERF_RECORD_MISC_SWITCH_OUT_PREEMPT);
+      _switch_count++;
+    } else if (_switch_out_time) {
+      const std::uint64_t off_cpu_ns = (time > _switch_out_time) ? time - _switch_out_time : 0;
+      _off_cpu_ns += off_cpu_ns;
+      if (_switch_out_preempted)   _preempted_ns += off_cpu_ns;
+      _switch_out_time = 0;
+    }
+  }
+};
+
+// -----------------------------------------------------------------------------
+} // namespace giopler::dev
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_LINUX_OFFCPU_HPP
@@ -27,7 +27,7 @@
 #if defined(GIOPLER_PLATFORM_LINUX)      // Linux kernel; could be GNU or Android
 #include <unistd.h>
 namespace giopler {
-uint64_t get_memory_page_size()
+GIOPLER_CORE_INLINE uint64_t get_memory_page_size()
 {
   static const auto memory_page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
   return memory_page_size;
@@ -35,7 +35,7 @@ uint64_t get_memory_page_size()
 }   // namespace giopler
 #else
 namespace giopler {
-uint64_t get_memory_page_size()
+GIOPLER_CORE_INLINE uint64_t get_memory_page_size()
 {
   return 4096;   // assume 4KB unless we know otherwise
 }
@@ -49,7 +49,7 @@ uint64_t get_memory_page_size()
 #if defined(GIOPLER_PLATFORM_LINUX)      // Linux kernel; could be GNU or Android
 #include <unistd.h>
 namespace giopler {
-uint64_t get_physical_memory()
+GIOPLER_CORE_INLINE uint64_t get_physical_memory()
 {
   static const auto physical_memory =
       get_memory_page_size()*static_cast<uint64_t>(sysconf(_SC_PHYS_PAGES));
@@ -58,7 +58,7 @@ uint64_t get_physical_memory()
 }   // namespace giopler
 #else
 namespace giopler {
-uint64_t get_physical_memory()
+GIOPLER_CORE_INLINE uint64_t get_physical_memory()
 {
   return 0;
 }
@@ -74,7 +74,7 @@ uint64_t get_physical_memory()
 #if defined(GIOPLER_PLATFORM_LINUX)      // Linux kernel; could be GNU or Android
 #include <sys/sysinfo.h>
 namespace giopler {
-uint64_t get_conf_cpu_cores()
+GIOPLER_CORE_INLINE uint64_t get_conf_cpu_cores()
 {
   static const auto total_cpu_cores = static_cast<uint64_t>(get_nprocs_conf());
   return total_cpu_cores;
@@ -82,7 +82,7 @@ uint64_t get_conf_cpu_cores()
 }   // namespace giopler
 #else
 namespace giopler {
-uint64_t get_conf_cpu_cores()
+GIOPLER_CORE_INLINE uint64_t get_conf_cpu_cores()
 {
   return 0;
 }
@@ -97,7 +97,7 @@ uint64_t get_conf_cpu_cores()
 #if defined(GIOPLER_PLATFORM_LINUX)      // Linux kernel; could be GNU or Android
 #include <sys/sysinfo.h>
 namespace giopler {
-uint64_t get_available_cpu_cores()
+GIOPLER_CORE_INLINE uint64_t get_available_cpu_cores()
 {
   static const auto available_cpu_cores = static_cast<uint64_t>(get_nprocs());
   return available_cpu_cores;
@@ -105,7 +105,7 @@ uint64_t get_available_cpu_cores()
 }   // namespace giopler
 #else
 namespace giopler {
-uint64_t get_available_cpu_cores()
+GIOPLER_CORE_INLINE uint64_t get_available_cpu_cores()
 {
   return 0;
 }
@@ -120,14 +120,14 @@ uint64_t get_available_cpu_cores()
 #endif
 #include <cerrno>
 namespace giopler {
-std::string get_program_name()
+GIOPLER_CORE_INLINE std::string get_program_name()
 {
   return program_invocation_short_name;
 }
 }   // namespace giopler
 #else
 namespace giopler {
-std::string get_program_name()
+GIOPLER_CORE_INLINE std::string get_program_name()
 {
   return "unknown";
 }
@@ -139,14 +139,14 @@ std::string get_program_name()
 #if defined(GIOPLER_PLATFORM_LINUX)      // Linux kernel; could be GNU or Android
 #include <unistd.h>
 namespace giopler {
-uint64_t get_process_id()
+GIOPLER_CORE_INLINE uint64_t get_process_id()
 {
   return getpid();
 }
 }   // namespace giopler
 #else
 namespace giopler {
-uint64_t get_process_id()
+GIOPLER_CORE_INLINE uint64_t get_process_id()
 {
   return 0;
 }
@@ -160,7 +160,7 @@ uint64_t get_process_id()
 #if defined(GIOPLER_PLATFORM_LINUX)      // Linux kernel; could be GNU or Android
 #include <sys/utsname.h>
 namespace giopler {
-std::string get_architecture()
+GIOPLER_CORE_INLINE std::string get_architecture()
 {
   struct utsname uts_name{};
   const int status = uname(&uts_name);
@@ -173,7 +173,7 @@ std::string get_architecture()
 }   // namespace giopler
 #else
 namespace giopler {
-std::string get_architecture()
+GIOPLER_CORE_INLINE std::string get_architecture()
 {
   return ""s;
 }
@@ -186,7 +186,7 @@ std::string get_architecture()
 #include <unistd.h>
 #include <climits>                      // HOST_NAME_MAX
 namespace giopler {
-std::string get_host_name()
+GIOPLER_CORE_INLINE std::string get_host_name()
 {
   char host_name[HOST_NAME_MAX];
   const int status = gethostname(host_name, HOST_NAME_MAX);
@@ -200,7 +200,7 @@ std::string get_host_name()
 }   // namespace giopler
 #else
 namespace giopler {
-std::string get_host_name()
+GIOPLER_CORE_INLINE std::string get_host_name()
 {
   return ""s;
 }
@@ -214,7 +214,7 @@ std::string get_host_name()
 #include <sys/types.h>
 #include <pwd.h>
 namespace giopler {
-std::string get_real_username()
+GIOPLER_CORE_INLINE std::string get_real_username()
 {
   const uid_t user_id{getuid()};
   const struct passwd * password_entry = getpwuid(user_id);
@@ -227,7 +227,7 @@ std::string get_real_username()
 }   // namespace giopler
 #else
 namespace giopler {
-std::string get_real_username()
+GIOPLER_CORE_INLINE std::string get_real_username()
 {
   return ""s;
 }
@@ -241,7 +241,7 @@ std::string get_real_username()
 #include <sys/types.h>
 #include <pwd.h>
 namespace giopler {
-std::string get_effective_username()
+GIOPLER_CORE_INLINE std::string get_effective_username()
 {
   const uid_t effective_user_id{geteuid()};
   const struct passwd * password_entry = getpwuid(effective_user_id);
@@ -254,7 +254,7 @@ std::string get_effective_username()
 }   // namespace giopler
 #else
 namespace giopler {
-std::string get_effective_username()
+GIOPLER_CORE_INLINE std::string get_effective_username()
 {
   return ""s;
 }
@@ -269,14 +269,14 @@ std::string get_effective_username()
 #endif
 #include <unistd.h>
 namespace giopler {
-uint64_t get_thread_id()
+GIOPLER_CORE_INLINE uint64_t get_thread_id()
 {
   return gettid();
 }
 }   // namespace giopler
 #else
 namespace giopler {
-uint64_t get_thread_id()
+GIOPLER_CORE_INLINE uint64_t get_thread_id()
 {
   return 0;
 }
@@ -292,7 +292,7 @@ uint64_t get_thread_id()
 #endif
 #include <sched.h>
 namespace giopler {
-uint64_t get_node_id()
+GIOPLER_CORE_INLINE uint64_t get_node_id()
 {
   unsigned int node;
   const int status = getcpu(NULL, &node);
@@ -305,7 +305,7 @@ uint64_t get_node_id()
 }   // namespace giopler
 #else
 namespace giopler {
-uint64_t get_node_id()
+GIOPLER_CORE_INLINE uint64_t get_node_id()
 {
   return 0;
 }
@@ -321,7 +321,7 @@ uint64_t get_node_id()
 #endif
 #include <sched.h>
 namespace giopler {
-uint64_t get_cpu_id()
+GIOPLER_CORE_INLINE uint64_t get_cpu_id()
 {
   unsigned int cpu;
   const int status = getcpu(&cpu, NULL);
@@ -334,7 +334,7 @@ uint64_t get_cpu_id()
 }   // namespace giopler
 #else
 namespace giopler {
-uint64_t get_cpu_id()
+GIOPLER_CORE_INLINE uint64_t get_cpu_id()
 {
   return 0;
 }
@@ -348,22 +348,100 @@ uint64_t get_cpu_id()
 #if defined(GIOPLER_PLATFORM_LINUX)      // Linux kernel; could be GNU or Android
 #include <unistd.h>
 namespace giopler {
-uint64_t get_available_memory()
+GIOPLER_CORE_INLINE uint64_t get_available_memory()
 {
-  static const auto available_memory =
-      get_memory_page_size()*static_cast<uint64_t>(sysconf(_SC_AVPHYS_PAGES));
-  return available_memory;
+  return get_memory_page_size()*static_cast<uint64_t>(sysconf(_SC_AVPHYS_PAGES));
 }
 }   // namespace giopler
 #else
 namespace giopler {
-uint64_t get_available_memory()
+GIOPLER_CORE_INLINE uint64_t get_available_memory()
 {
   return 0;
 }
 }   // namespace giopler
 #endif   // defined GIOPLER_PLATFORM_LINUX
 
+// -----------------------------------------------------------------------------
+/// memory used by this process
+// most values come from /proc/self/status, which is cheap to read
+// AnonHugePages is only reported by /proc/self/smaps_rollup (Linux 4.14+)
+// smaps_rollup walks the page tables, so do not call this on every event
+// https://www.kernel.org/doc/html/latest/filesystems/proc.html
+#if defined(GIOPLER_PLATFORM_LINUX)      // Linux kernel; could be GNU or Android
+#include <fstream>
+#include <sstream>
+#include <string>
+namespace giopler {
+GIOPLER_CORE_INLINE ProcessMemory get_process_memory()
+{
+  ProcessMemory process_memory;
+
+  // lines look like "VmRSS:      1234 kB"
+  const auto read_kb_fields = [](const char* path, auto store_field) {
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+      const std::size_t colon = line.find(':');
+      if (colon == std::string::npos)   continue;
+      std::istringstream value_stream(line.substr(colon+1));
+      uint64_t value_kb = 0;
+      if (value_stream >> value_kb) {
+        store_field(std::string_view(line).substr(0, colon), value_kb*1024);
+      }
+    }
+  };
+
+  read_kb_fields("/proc/self/status", [&](std::string_view field, uint64_t bytes) {
+    if      (field == "VmRSS")     process_memory.rss  = bytes;
+    else if (field == "RssAnon")   process_memory.anon = bytes;
+    else if (field == "RssFile")   process_memory.file = bytes;
+    else if (field == "VmSwap")    process_memory.swap = bytes;
+    else if (field == "VmHWM")     process_memory.hwm  = bytes;
+  });
+
+  read_kb_fields("/proc/self/smaps_rollup", [&](std::string_view field, uint64_t bytes) {
+    if (field == "AnonHugePages")  process_memory.anon_huge = bytes;
+  });
+
+  return process_memory;
+}
+}   // namespace giopler
+#else
+namespace giopler {
+GIOPLER_CORE_INLINE ProcessMemory get_process_memory()
+{
+  return ProcessMemory{};
+}
+}   // namespace giopler
+#endif   // defined GIOPLER_PLATFORM_LINUX
+
+// -----------------------------------------------------------------------------
+/// ask for the memory range to be backed by transparent huge pages
+// only whole huge pages inside the range are affected
+// https://www.kernel.org/doc/html/latest/admin-guide/mm/transhuge.html
+#if defined(GIOPLER_PLATFORM_LINUX)      // Linux kernel; could be GNU or Android
+#include <cstdint>
+#include <sys/mman.h>
+namespace giopler {
+GIOPLER_CORE_INLINE void advise_huge_pages(void* address, const std::size_t length)
+{
+  constexpr std::uintptr_t huge_page_size = 2*1024*1024;
+  const auto begin = (reinterpret_cast<std::uintptr_t>(address) + huge_page_size - 1) & ~(huge_page_size - 1);
+  const auto end   = (reinterpret_cast<std::uintptr_t>(address) + length) & ~(huge_page_size - 1);
+  if (begin < end) {
+    madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE);   // only a hint; ignore errors
+  }
+}
+}   // namespace giopler
+#else
+namespace giopler {
+GIOPLER_CORE_INLINE void advise_huge_pages([[maybe_unused]] void* address, [[maybe_unused]] const std::size_t length)
+{
+}
+}   // namespace giopler
+#endif   // defined GIOPLER_PLATFORM_LINUX
+
 // -----------------------------------------------------------------------------
 /// current frequency in kHz for the current CPU core
 // we use the value reported by the system
@@ -372,7 +450,7 @@ uint64_t get_available_memory()
 #include <fstream>
 #include <string>
 namespace giopler {
-uint64_t get_cur_freq()
+GIOPLER_CORE_INLINE uint64_t get_cur_freq()
 {
   const uint64_t cpu_id = get_cpu_id();
   std::ifstream freq_file("/sys/devices/system/cpu/cpu" + std::to_string(cpu_id) + "/cpufreq/scaling_cur_freq");
@@ -387,7 +465,7 @@ uint64_t get_cur_freq()
 }   // namespace giopler
 #else
 namespace giopler {
-uint64_t get_cur_freq()
+GIOPLER_CORE_INLINE uint64_t get_cur_freq()
 {
   return 0;
 }
@@ -403,7 +481,7 @@ uint64_t get_cur_freq()
 #include <fstream>
 #include <string>
 namespace giopler {
-uint64_t get_max_freq()
+GIOPLER_CORE_INLINE uint64_t get_max_freq()
 {
   const uint64_t cpu_id = get_cpu_id();
   std::ifstream freq_file("/sys/devices/system/cpu/cpu" + std::to_string(cpu_id) + "/cpufreq/scaling_max_freq");
@@ -418,7 +496,7 @@ uint64_t get_max_freq()
 }   // namespace giopler
 #else
 namespace giopler {
-uint64_t get_max_freq()
+GIOPLER_CORE_INLINE uint64_t get_max_freq()
 {
   return 0;
 }
@@ -432,19 +510,19 @@ uint64_t get_max_freq()
 #if defined(GIOPLER_PLATFORM_LINUX)      // Linux kernel; could be GNU or Android
 #include <cstdlib>
 namespace giopler {
-double get_load_average1()
+GIOPLER_CORE_INLINE double get_load_average1()
 {
   double loads[3];
   const int status = getloadavg(loads, 3);
   return (status == -1) ? 0 : (loads[0] / get_available_cpu_cores());
 }
-double get_load_average5()
+GIOPLER_CORE_INLINE double get_load_average5()
 {
   double loads[3];
   const int status = getloadavg(loads, 3);
   return (status == -1) ? 0 : (loads[1] / get_available_cpu_cores());
 }
-double get_load_average15()
+GIOPLER_CORE_INLINE double get_load_average15()
 {
   double loads[3];
   const int status = getloadavg(loads, 3);
@@ -453,15 +531,15 @@ double get_load_average15()
 }   // namespace giopler
 #else
 namespace giopler {
-double get_load_average1()
+GIOPLER_CORE_INLINE double get_load_average1()
 {
   return 0;
 }
-double get_load_average5()
+GIOPLER_CORE_INLINE double get_load_average5()
 {
   return 0;
 }
-double get_load_average15()
+GIOPLER_CORE_INLINE double get_load_average15()
 {
   return 0;
 }
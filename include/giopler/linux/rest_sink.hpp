@@ -28,8 +28,7 @@
 #include <openssl/ssl.h>
 using namespace std::literals;
 
-#define ZLIB_CONST
-#include "zlib.h"
+#include "giopler/codec.hpp"
 
 // -----------------------------------------------------------------------------
 // https://stackoverflow.com/questions/22077802/simple-c-example-of-doing-an-http-post-and-consuming-the-response
@@ -82,6 +81,14 @@ class Rest
     _server_host            = _is_localhost ? "127.0.0.1" : "www.giopler.com";
     _server_port            = _is_localhost ? "3000" : "443";
 
+    // used to send the events to a stand-in server, for example giopler_ingest
+    const char* server_host = std::getenv("GIOPLER_SERVER_HOST");
+    if (server_host)   _server_host = server_host;
+    const char* server_port = std::getenv("GIOPLER_SERVER_PORT");
+    if (server_port)   _server_port = server_port;
+    const char* ca_file     = std::getenv("GIOPLER_CA_FILE");
+    _ca_file                = ca_file ? ca_file : "";
+
     _json_web_token         = std::getenv("GIOPLER_TOKEN");
 
     if (!_is_localhost)   open_connection();
@@ -104,11 +111,13 @@ class Rest
   const std::regex _http_first_line_regex{"^HTTP/1\\.[01] ([[:digit:]]+) ", std::regex::optimize};
   const std::regex _http_chunked_regex{"transfer-encoding: chunked", std::regex::optimize|std::regex::icase};
   const std::regex _http_end_chunk_regex{"0\r\n\r\n", std::regex::optimize};
+  const std::regex _http_accept_encoding_regex{"\r\naccept-encoding: *([^\r]*)", std::regex::optimize|std::regex::icase};
   std::string _proxy_host;
   std::string _proxy_port;
   std::string _server_host;
   std::string _server_port;
   std::string _json_web_token;
+  std::string _ca_file;   // additional trusted certificates (PEM)
   bool _is_proxy = false;
   bool _is_localhost = false;
 
@@ -117,6 +126,8 @@ class Rest
   BIO* _bio = nullptr;   // OpenSSL I/O stream abstraction (similar to FILE*)
   SSL* _ssl = nullptr;   // no need to free
   char _result_buffer[RESULT_BUFFER_SIZE] = "";
+  std::vector<std::uint8_t> _compressed_body;   // reused for every batch
+  Compressor _compressor;
 
   /// open a secure and persistent connection to the server
   void open_connection()
@@ -135,6 +146,12 @@ class Rest
     ERR_print_errors_fp(stderr);
     assert(verify_paths_status == 1);
 
+    if (!_ca_file.empty()) {
+      const int load_verify_status = SSL_CTX_load_verify_locations(_ssl_ctx, _ca_file.c_str(), nullptr);
+      ERR_print_errors_fp(stderr);
+      assert(load_verify_status == 1);
+    }
+
     SSL_CTX_set_verify_depth(_ssl_ctx, 5);
     ERR_print_errors_fp(stderr);
 
@@ -226,8 +243,16 @@ class Rest
 
     if (!check_reopen_connection()) {
       read_response();
-      const int response_status = parse_response_status();
-      assert(response_status == 201);
+      int response_status = parse_response_status();
+      if (response_status == 415 && _compressor.get_codec() != Codec::Gzip) {
+        // the server does not accept the codec, so send the batch again with one it does
+        change_codec(_result_buffer, _result_buffer + strlen(_result_buffer));
+        if (is_chunked_response())   read_response();
+        send_request(json_content);
+        read_response();
+        response_status = parse_response_status();
+      }
+      if (response_status != 201)   report_rejected(response_status);
 
       if (is_chunked_response()) {
         read_response();          // discard zero length end chunk
@@ -237,7 +262,8 @@ class Rest
 
   void send_request(std::string_view json_content) {
     char headers[1024];
-    const std::vector<std::uint8_t> compressed_body = compress_gzip(json_content);
+    std::vector<std::uint8_t>& compressed_body = _compressed_body;
+    _compressor.compress(json_content, compressed_body);
     std::size_t total, sent, bytes;
 
     sprintf(headers,
@@ -250,8 +276,10 @@ class Rest
         "Accept: application/json\r\n"
         "Accept-Encoding: identity\r\n"
         "Content-Type: application/octet-stream\r\n"
+        "Content-Encoding: %s\r\n"
         "Content-Length: %lu\r\n\r\n",
-        _server_host.c_str(), _server_port.c_str(), _json_web_token.c_str(), compressed_body.size());
+        _server_host.c_str(), _server_port.c_str(), _json_web_token.c_str(),
+        get_codec_name(_compressor.get_codec()).data(), compressed_body.size());
 
     // send the headers
     total = strlen(headers);
@@ -287,7 +315,7 @@ class Rest
   // so we punt and just read some bytes and then discard them
   void read_response() {
       std::size_t bytes_read = 0;
-      const int read_status = BIO_read_ex(_bio, _result_buffer, RESULT_BUFFER_SIZE, &bytes_read);
+      const int read_status = BIO_read_ex(_bio, _result_buffer, RESULT_BUFFER_SIZE-1, &bytes_read);
       ERR_print_errors_fp(stderr);
       assert(read_status > 0);
       _result_buffer[bytes_read] = '\0';
@@ -320,45 +348,25 @@ class Rest
   }
 
   // -----------------------------------------------------------------------------
-  // initialize the gzip data structure
-  static void init_gzip(std::string_view input, std::uint8_t* output, int max_output_size, z_stream& zstream) {
-    zstream.zalloc     = Z_NULL;
-    zstream.zfree      = Z_NULL;
-    zstream.opaque     = Z_NULL;
-    zstream.avail_in   = static_cast<uint32_t>(input.size());
-    zstream.next_in    = reinterpret_cast<const uint8_t*>(input.data());
-    zstream.avail_out  = static_cast<uint32_t>(max_output_size);
-    zstream.next_out   = reinterpret_cast<uint8_t*>(output);
-
-    // Hard to believe they don't have a macro for gzip encoding. "Add 16" is the best thing zlib can do:
-    // "Add 16 to windowBits to write a simple gzip header and trailer around the compressed data instead of a zlib wrapper"
-    const int status = deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 | 16, 9, Z_DEFAULT_STRATEGY);
-    assert(status == Z_OK);
+  /// the server refused the codec (HTTP status 415), so change to one in the Accept-Encoding of its response
+  // https://www.rfc-editor.org/rfc/rfc7694
+  void change_codec(const char* response_begin, const char* response_end) {
+    std::cmatch match;
+    std::regex_search(response_begin, response_end, match, _http_accept_encoding_regex);
+    const std::string_view accepted = (match.size() == 2) ?
+        std::string_view{match[1].first, static_cast<std::size_t>(match[1].length())} : ""sv;
+    const Codec refused = _compressor.get_codec();
+    const Codec codec   = negotiate_codec(accepted, refused);
+    _compressor.set_codec(codec);
+    std::cerr << gformat("Giopler: WARNING: the server does not accept {} compression, using {}\n",
+                         get_codec_name(refused), get_codec_name(codec));
   }
 
   // -----------------------------------------------------------------------------
-  // return the maximum possible size of the compressed data
-  static std::size_t max_compress_size_gzip(std::string_view input) {
-    z_stream zstream;
-    init_gzip(input, nullptr, 0, zstream);
-    return deflateBound(&zstream, input.size());
-  }
-
-  // -----------------------------------------------------------------------------
-  // compress the input buffer using gzip data compression
-  static std::vector<std::uint8_t> compress_gzip(std::string_view input)
-  {
-    const std::size_t max_output_size = max_compress_size_gzip(input);
-    std::vector<std::uint8_t> output(max_output_size);
-
-    z_stream zstream;
-    init_gzip(input, output.data(), static_cast<int>(max_output_size), zstream);
-    const int deflate_status = deflate(&zstream, Z_FINISH);
-    assert(deflate_status == Z_STREAM_END);
-    output.resize(zstream.total_out);
-    const int deflate_end_status = deflateEnd(&zstream);
-    assert(deflate_end_status == Z_OK);
-    return output;
+  /// the server did not accept the batch, so the events in it are lost
+  // the server can refuse a batch when it is overloaded; keep sending the following batches
+  static void report_rejected(const int response_status) {
+    std::cerr << gformat("Giopler: WARNING: the server rejected a batch of events (HTTP status {})\n", response_status);
   }
 
   // -----------------------------------------------------------------------------
@@ -373,14 +381,15 @@ class Rest
   // uses the Linux socket API
   // closes the connection after each POST message
   // https://stackoverflow.com/questions/22077802/simple-c-example-of-doing-an-http-post-and-consuming-the-response
-  static void http_post(std::string token, std::string host, std::string port_str, std::string_view json_body)
+  void http_post(std::string token, std::string host, std::string port_str, std::string_view json_body)
   {
       uint16_t port = std::atoi(port_str.c_str());
       struct hostent *server;
       struct sockaddr_in serv_addr;
       int sockfd, bytes, sent, received, total;
       char headers[4096], response[4096];
-      const std::vector<std::uint8_t> compressed_body = compress_gzip(json_body);
+      std::vector<std::uint8_t>& compressed_body = _compressed_body;
+      _compressor.compress(json_body, compressed_body);
 
       sprintf(headers,
         "POST /api/v1/post_event HTTP/1.1\r\n"
@@ -391,8 +400,9 @@ class Rest
         "Accept: application/json\r\n"
         "Accept-Encoding: identity\r\n"
         "Content-Type: application/octet-stream\r\n"
+        "Content-Encoding: %s\r\n"
         "Content-Length: %lu\r\n\r\n",
-        host.c_str(), port, token.c_str(), compressed_body.size());
+        host.c_str(), port, token.c_str(), get_codec_name(_compressor.get_codec()).data(), compressed_body.size());
 
       // printf("HTTP Request Headers:\n%s\n", headers);
       // printf("HTTP Request Body:\n%s\n", json_body.data());
@@ -460,12 +470,20 @@ class Rest
       if (received == total)
           http_error("ERROR storing complete response from socket");
 
-      if (response[9] != '2')
-          http_error(response);
-
       // close the socket
       close(sockfd);
 
+      const int response_status = (received >= 12) ? std::atoi(response+9) : 0;
+      if (response_status == 415 && _compressor.get_codec() != Codec::Gzip) {
+          // the server does not accept the codec, so send the batch again with one it does
+          change_codec(response, response+received);
+          http_post(std::move(token), std::move(host), std::move(port_str), json_body);
+          return;
+      }
+
+      if (received < 12 || response[9] != '2')
+          report_rejected(response_status);
+
       // process response
       // printf("HTTP Response:\n%s\n",response);
   }
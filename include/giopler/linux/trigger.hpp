@@ -0,0 +1,121 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_LINUX_TRIGGER_HPP
+#define GIOPLER_LINUX_TRIGGER_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+
+#include <linux/perf_event.h>             // Definition of PERF_* constants
+#include <sys/syscall.h>                  // Definition of SYS_* constants
+#include <unistd.h>
+
+// -----------------------------------------------------------------------------
+// https://man7.org/linux/man-pages/man2/perf_event_open.2.html
+namespace giopler::dev
+{
+
+// -----------------------------------------------------------------------------
+/// hardware counters of a thread and the threads it creates afterwards
+// this is a private class for library internal use only
+// with inherit set, reading a counter returns the total of the thread and its descendants;
+// inherited counters cannot be read as a group, so each is read on its own,
+// and scaled by the time it was actually counting, in case the kernel multiplexed them
+class LinuxProcessCounters final {
+ public:
+  void open() {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    if (_is_opened)   return;
+    _is_opened = true;
+
+    for (std::size_t counter = 0; counter < _counters.size(); ++counter) {
+      perf_event_attr attr{};
+      attr.size           = sizeof(attr);
+      attr.type           = PERF_TYPE_HARDWARE;
+      attr.config         = _counters[counter].second;
+      attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      attr.inherit        = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      _fds[counter] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+      if (_fds[counter] == -1) {
+        close_all();
+        return;
+      }
+    }
+  }
+
+  Record read() {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    Record counters;
+    if (_fds[0] == -1)   return counters;
+
+    for (std::size_t counter = 0; counter < _counters.size(); ++counter) {
+      std::uint64_t values[3]{};   // value, time enabled, time running
+      if (::read(_fds[counter], values, sizeof(values)) != static_cast<ssize_t>(sizeof(values)))   return Record{};
+      const double scale = values[2] ? static_cast<double>(values[1]) / static_cast<double>(values[2]) : 0.0;
+      counters.insert({{std::string{_counters[counter].first},
+                        static_cast<std::int64_t>(static_cast<double>(values[0]) * scale)}});
+    }
+    return counters;
+  }
+
+  ~LinuxProcessCounters() {
+    close_all();
+  }
+
+ private:
+  static constexpr std::array<std::pair<std::string_view, std::uint64_t>, 4> _counters{{
+    {"hw_cpu_cycl"sv,   PERF_COUNT_HW_CPU_CYCLES},
+    {"hw_instr"sv,      PERF_COUNT_HW_INSTRUCTIONS},
+    {"hw_cache_ref"sv,  PERF_COUNT_HW_CACHE_REFERENCES},
+    {"hw_cache_miss"sv, PERF_COUNT_HW_CACHE_MISSES}
+  }};
+
+  std::mutex _mutex;
+  bool _is_opened = false;
+  std::array<int, _counters.size()> _fds{-1, -1, -1, -1};
+
+  void close_all() {
+    for (int& fd : _fds) {
+      if (fd != -1)   ::close(fd);
+      fd = -1;
+    }
+  }
+};
+
+// -----------------------------------------------------------------------------
+constinit inline LinuxProcessCounters g_linux_process_counters;
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE void open_process_hardware_counters()
+{
+  g_linux_process_counters.open();
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE Record read_process_hardware_counters()
+{
+  return g_linux_process_counters.read();
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_LINUX_TRIGGER_HPP
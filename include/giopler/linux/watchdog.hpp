@@ -0,0 +1,137 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_LINUX_WATCHDOG_HPP
+#define GIOPLER_LINUX_WATCHDOG_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <execinfo.h>
+#include <sys/syscall.h>                  // Definition of SYS_* constants
+#include <unistd.h>
+
+// -----------------------------------------------------------------------------
+// https://man7.org/linux/man-pages/man2/tgkill.2.html
+// https://man7.org/linux/man-pages/man3/backtrace.3.html
+namespace giopler::dev
+{
+
+// -----------------------------------------------------------------------------
+/// captures the native call stack of another thread
+// this is a private class for library internal use only
+// a real-time signal is sent to the thread, and its handler records the return addresses
+// the addresses are converted to text by the capturing thread, outside the handler
+// the signal is installed with SA_RESTART, so most interrupted system calls are restarted
+// the handler is only installed if the signal is not already used by the program
+class LinuxBacktrace final {
+ public:
+  static std::vector<std::string> capture(const std::uint64_t thread_id) {
+    std::vector<std::string> backtrace_lines;
+    const std::lock_guard<std::mutex> lock{_mutex};
+    if (!install_handler())   return backtrace_lines;
+
+    _frame_count.store(-1, std::memory_order_relaxed);
+    _target.store(static_cast<pid_t>(thread_id), std::memory_order_release);
+    if (syscall(SYS_tgkill, getpid(), static_cast<pid_t>(thread_id), get_signal()) == -1) {
+      _target.store(0, std::memory_order_relaxed);
+      return backtrace_lines;   // the thread already exited
+    }
+
+    // the thread might have the signal blocked; a late handler finds it is not the target anymore
+    int frame_count = -1;
+    const auto deadline = std::chrono::steady_clock::now() + _max_wait;
+    while ((frame_count = _frame_count.load(std::memory_order_acquire)) < 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    _target.store(0, std::memory_order_release);
+    if (frame_count <= _handler_frames)   return backtrace_lines;
+
+    char** symbols = backtrace_symbols(_frames + _handler_frames, frame_count - _handler_frames);
+    if (!symbols)   return backtrace_lines;
+    for (int frame = 0; frame < frame_count - _handler_frames; ++frame) {
+      backtrace_lines.emplace_back(symbols[frame]);
+    }
+    std::free(symbols);
+    return backtrace_lines;
+  }
+
+ private:
+  static constexpr int _max_frames     = 64;
+  static constexpr int _handler_frames = 2;   // the handler and the signal trampoline
+  static constexpr auto _max_wait      = std::chrono::milliseconds(100);
+
+  static inline std::mutex _mutex;   // one capture at a time
+  static inline std::atomic<pid_t> _target{0};
+  static inline std::atomic<int> _frame_count{-1};
+  static inline void* _frames[_max_frames];
+
+  /// the first real-time signals are often taken by threading libraries
+  static int get_signal() {
+    return SIGRTMIN + 4;
+  }
+
+  static void handler(int, siginfo_t*, void*) {
+    const int saved_errno = errno;
+    if (_target.load(std::memory_order_acquire) == static_cast<pid_t>(syscall(SYS_gettid))) {
+      _frame_count.store(backtrace(_frames, _max_frames), std::memory_order_release);
+    }
+    errno = saved_errno;
+  }
+
+  static bool install_handler() {
+    static const bool is_installed = [] {
+      void* frames[1];
+      backtrace(frames, 1);   // loads libgcc now, so the signal handler does not allocate
+
+      struct sigaction action{};
+      if (sigaction(get_signal(), nullptr, &action) == -1 ||
+          (action.sa_flags & SA_SIGINFO) || action.sa_handler != SIG_DFL) {
+        std::cerr << "WARNING: LinuxBacktrace: signal " << get_signal()
+                  << " is already in use (native backtraces will not be reported)" << std::endl;
+        return false;
+      }
+
+      action = {};
+      action.sa_sigaction = handler;
+      action.sa_flags     = SA_SIGINFO | SA_RESTART;
+      sigemptyset(&action.sa_mask);
+      return sigaction(get_signal(), &action, nullptr) == 0;
+    }();
+    return is_installed;
+  }
+};
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE std::vector<std::string> get_thread_backtrace(const std::uint64_t thread_id)
+{
+  return LinuxBacktrace::capture(thread_id);
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_LINUX_WATCHDOG_HPP
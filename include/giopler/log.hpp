@@ -21,6 +21,28 @@
 
 #include "giopler/config.hpp"
 #include "giopler/utility.hpp"
+#include "giopler/sink.hpp"
+#include "giopler/probe.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler
+{
+
+// -----------------------------------------------------------------------------
+/// write a Warning or Error event, marked as Failed
+// this is a private function for library internal use only
+// Error events are flushed, the user's code could throw and terminate the program
+GIOPLER_COLD
+void write_log_failure(const source_location& source_location, Event event, std::string_view message);
+
+// -----------------------------------------------------------------------------
+/// write a Message event
+// this is a private function for library internal use only
+GIOPLER_OUTLINE
+void write_log_message(const source_location& source_location, std::string_view message);
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler
 
 // -----------------------------------------------------------------------------
 namespace giopler::dev
@@ -28,15 +50,11 @@ namespace giopler::dev
 
 // -----------------------------------------------------------------------------
 /// signal a potentially erroneous condition
-void warning([[maybe_unused]] const std::string_view message = ""sv,
-             [[maybe_unused]] const source_location& source_location = source_location::current())
+inline void warning([[maybe_unused]] const std::string_view message = ""sv,
+                    [[maybe_unused]] const source_location& source_location = source_location::current())
 {
   if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Test) {
-    std::shared_ptr<Record> record_log =
-        get_event_record(source_location, EventCategory::Log, Event::Warning, UUID());
-    record_log->insert_or_assign("msg"s, message);
-    record_log->insert_or_assign("status"s, "Failed");
-    sink::g_sink_manager.write_record(record_log);
+    write_log_failure(source_location, Event::Warning, message);
   }
 }
 
@@ -46,11 +64,7 @@ void warning([[maybe_unused]] StringFunction auto message_function,
              [[maybe_unused]] const source_location& source_location = source_location::current())
 {
   if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Test) {
-    std::shared_ptr<Record> record_log =
-        get_event_record(source_location, EventCategory::Log, Event::Warning, UUID());
-    record_log->insert_or_assign("msg"s, message_function());
-    record_log->insert_or_assign("status"s, "Failed");
-    sink::g_sink_manager.write_record(record_log);
+    write_log_failure(source_location, Event::Warning, std::string{message_function()});
   }
 }
 
@@ -63,16 +77,11 @@ namespace giopler::prod
 
 // -----------------------------------------------------------------------------
 /// signal a definitely erroneous condition
-void error([[maybe_unused]] const std::string_view message = ""sv,
-           [[maybe_unused]] const source_location& source_location = source_location::current())
+inline void error([[maybe_unused]] const std::string_view message = ""sv,
+                  [[maybe_unused]] const source_location& source_location = source_location::current())
 {
   if constexpr (g_build_mode != BuildMode::Off) {
-    std::shared_ptr<Record> record_log =
-        get_event_record(source_location, EventCategory::Log, Event::Error, UUID());
-    record_log->insert_or_assign("msg"s, message);
-    record_log->insert_or_assign("status"s, "Failed");
-    sink::g_sink_manager.write_record(record_log);
-    sink::g_sink_manager.flush();   // user's code could throw and terminate program
+    write_log_failure(source_location, Event::Error, message);
   }
 }
 
@@ -82,41 +91,67 @@ void error([[maybe_unused]] StringFunction auto message_function,
            [[maybe_unused]] const source_location& source_location = source_location::current())
 {
   if constexpr (g_build_mode != BuildMode::Off) {
-    std::shared_ptr<Record> record_log =
-        get_event_record(source_location, EventCategory::Log, Event::Error, UUID());
-    record_log->insert_or_assign("msg"s, message_function());
-    record_log->insert_or_assign("status"s, "Failed");
-    sink::g_sink_manager.write_record(record_log);
-    sink::g_sink_manager.flush();   // user's code could throw and terminate program
+    write_log_failure(source_location, Event::Error, std::string{message_function()});
   }
 }
 
 // -----------------------------------------------------------------------------
-void message([[maybe_unused]] const std::string_view message = ""sv,
-             [[maybe_unused]] const source_location& source_location = source_location::current())
+GIOPLER_SITE_INLINE void message([[maybe_unused]] const std::string_view message = ""sv,
+                    [[maybe_unused]] const source_location& source_location = source_location::current())
 {
   if constexpr (g_build_mode != BuildMode::Off) {
-    std::shared_ptr<Record> record_log =
-        get_event_record(source_location, EventCategory::Log, Event::Message, UUID());
-    record_log->insert_or_assign("msg"s, message);
-    sink::g_sink_manager.write_record(record_log);
+    GIOPLER_PROBE_SITE(site, "message", EventCategory::Log, Event::Message, source_location);
+    if (dev::is_probe_enabled(site, source_location))   write_log_message(source_location, message);
   }
 }
 
 // -----------------------------------------------------------------------------
-void message([[maybe_unused]] StringFunction auto message_function,
+GIOPLER_SITE_INLINE void message([[maybe_unused]] StringFunction auto message_function,
              [[maybe_unused]] const source_location& source_location = source_location::current())
 {
   if constexpr (g_build_mode != BuildMode::Off) {
-    std::shared_ptr<Record> record_log =
-        get_event_record(source_location, EventCategory::Log, Event::Message, UUID());
-    record_log->insert_or_assign("msg"s, message_function());
-    sink::g_sink_manager.write_record(record_log);
+    GIOPLER_PROBE_SITE(site, "message", EventCategory::Log, Event::Message, source_location);
+    if (dev::is_probe_enabled(site, source_location)) {
+      write_log_message(source_location, std::string{message_function()});
+    }
   }
 }
 
 // -----------------------------------------------------------------------------
 }   // namespace giopler::prod
 
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+namespace giopler {
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void write_log_failure(const source_location& source_location, const Event event, const std::string_view message)
+{
+  std::shared_ptr<Record> record_log =
+      get_event_record(source_location, EventCategory::Log, event, UUID());
+  record_log->insert_or_assign("msg"s, message);
+  record_log->insert_or_assign("status"s, "Failed");
+  sink::g_sink_manager.write_record(record_log);
+  if (event == Event::Error) {
+    sink::g_sink_manager.flush();   // user's code could throw and terminate program
+  }
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void write_log_message(const source_location& source_location, const std::string_view message)
+{
+  std::shared_ptr<Record> record_log =
+      get_event_record(source_location, EventCategory::Log, Event::Message, UUID());
+  record_log->insert_or_assign("msg"s, message);
+  sink::g_sink_manager.write_record(record_log);
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler
+#endif // GIOPLER_CORE_DEFINITIONS
+
 // -----------------------------------------------------------------------------
 #endif // defined GIOPLER_LOG_HPP
@@ -0,0 +1,146 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_MEMORY_HPP
+#define GIOPLER_MEMORY_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "giopler/config.hpp"
+#include "giopler/record.hpp"
+#include "giopler/sink.hpp"
+#include "giopler/frame.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+/// periodically samples the memory used by the process
+// this is a private class for library internal use only
+// each sample is sent as a Memory event, together with the functions
+// that were running in the most threads at the time of the sample
+// GIOPLER_MEMORY_INTERVAL sets the milliseconds between samples (0=disabled)
+class MemorySampler final
+{
+ public:
+  explicit MemorySampler([[maybe_unused]] giopler::source_location source_location = giopler::source_location::current())
+  {
+    if constexpr (g_build_mode == BuildMode::Prof) {
+      const char* interval = std::getenv("GIOPLER_MEMORY_INTERVAL");
+      const auto interval_ms = std::chrono::milliseconds(interval ? std::atoll(interval) : 1000);
+      if (interval_ms.count() > 0) {
+        _data = std::make_unique<SamplerData>(source_location);
+        _data->_process = std::jthread(_process_function, _data.get(), interval_ms);
+      }
+    }
+  }
+
+  ~MemorySampler() {
+    if (_data) {
+      _data->_process.request_stop();
+      _data->_process.join();
+    }
+  }
+
+ private:
+  static constexpr std::size_t _max_functions = 5;   // functions reported per sample
+
+  struct SamplerData {
+    explicit SamplerData(const giopler::source_location& source_location)
+    : _source_location(source_location.file_name(), "<memory>", source_location.line()) { }
+
+    giopler::source_location _source_location;
+    std::mutex _mutex;
+    std::condition_variable_any _cond_var;
+    std::jthread _process;
+  };
+
+  // use a data object to help minimize impact when not enabled
+  std::unique_ptr<SamplerData> _data;
+
+  /// the innermost functions running in the most threads, with their thread counts
+  static std::shared_ptr<giopler::Array> get_active_functions() {
+    std::unordered_map<const char*, int64_t> function_threads;
+    g_frame_registry.for_each([&](const PublishedFrames& frames) {
+      const char* function_name = frames.get_top();
+      if (function_name)   function_threads[function_name]++;
+    });
+
+    std::vector<std::pair<const char*, int64_t>> functions(function_threads.begin(), function_threads.end());
+    const std::size_t functions_count = std::min(functions.size(), _max_functions);
+    std::partial_sort(functions.begin(), functions.begin() + static_cast<std::ptrdiff_t>(functions_count), functions.end(),
+                      [](const auto& a, const auto& b) { return a.second > b.second; });
+
+    std::shared_ptr<giopler::Array> active_functions{make_arena_shared<giopler::Array>()};
+    active_functions->reserve(functions_count);
+    for (std::size_t index = 0; index < functions_count; ++index) {
+      active_functions->emplace_back(make_arena_shared<Record>(Record{
+          {"func"s,   functions[index].first},
+          {"thrds"s,  functions[index].second}
+      }));
+    }
+    return active_functions;
+  }
+
+  static std::shared_ptr<Record> get_memory_record() {
+    const ProcessMemory process_memory = get_process_memory();
+    return make_arena_shared<Record>(Record{
+        {"rss"s,        process_memory.rss},
+        {"anon"s,       process_memory.anon},
+        {"file"s,       process_memory.file},
+        {"anon_huge"s,  process_memory.anon_huge},
+        {"swap"s,       process_memory.swap},
+        {"hwm"s,        process_memory.hwm}
+    });
+  }
+
+  static void _process_function(std::stop_token stop_token, SamplerData* data, std::chrono::milliseconds interval) {
+    do {
+      std::shared_ptr<Record> record_memory =
+          get_event_record(data->_source_location, EventCategory::Profile, Event::Memory, UUID());
+      record_memory->insert({{"mem"s, get_memory_record()}});
+      record_memory->insert({{"funcs"s, get_active_functions()}});
+      sink::g_sink_manager.write_record(record_memory);
+
+      std::unique_lock<std::mutex> lock{data->_mutex};
+      data->_cond_var.wait_for(lock, stop_token, interval, [] { return false; });
+    } while (!stop_token.stop_requested());
+  }
+};
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY the single instance is in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+GIOPLER_CORE_INLINE MemorySampler g_memory_sampler;
+#else
+extern MemorySampler g_memory_sampler;
+#endif
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_MEMORY_HPP
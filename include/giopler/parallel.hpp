@@ -0,0 +1,430 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_PARALLEL_HPP
+#define GIOPLER_PARALLEL_HPP
+
+#if __cplusplus < 202002L
+#error C++20 or newer support required to use this header-only library.
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "giopler/counter.hpp"
+#include "giopler/profile.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+/// the share of a ParallelRegion run by one thread
+// this is a private class for library internal use only
+// claimed by the thread on its first Participant, and then only written by that thread
+// the region reads it after the threads have finished (joined)
+struct alignas(64) ParallelParticipant {
+  std::atomic<bool> _is_claimed{false};
+  std::thread::id _thread;               // identifies the owner
+  std::uint64_t _thread_id      = 0;     // reported (get_thread_id)
+  std::uint64_t _first_start_ns = 0;     // steady clock
+  std::uint64_t _last_end_ns    = 0;
+  std::uint64_t _work_ns        = 0;     // sum of the Participant lifetimes
+  std::uint64_t _calls          = 0;     // number of Participant objects
+  std::shared_ptr<Record> _counters;     // sum of the counter deltas (Prof)
+};
+
+// -----------------------------------------------------------------------------
+/// profile one invocation of a region of code run by several threads
+// create the region on the thread that starts the parallel work,
+// and let it go out of scope only after all the participants have finished
+// each thread doing part of the work creates a Participant on the region for the duration of that work
+// a thread may create any number of Participant objects, one after the other; their times are added up
+// on exit a ParallelRegion event is written with, for every participating thread,
+// the time spent working, the time idle (waiting to start, or for the other threads to finish),
+// and the counter deltas, together with the load imbalance (max/mean work),
+// the parallel efficiency (total work / (threads * wall time)), and the straggler thread
+// only enabled in Prof mode, and skipped if the call tree is not sampled (see Sampler)
+class ParallelRegion final
+{
+ public:
+  explicit ParallelRegion([[maybe_unused]] const std::string_view name = ""sv,
+                          [[maybe_unused]] const giopler::source_location& source_location = giopler::source_location::current())
+  : _data{_is_enabled && g_thread_control._sampling != ThreadControlBlock::Sampling::Drop ?
+          begin(name, source_location) : nullptr}
+  { }
+
+  ~ParallelRegion() {
+    if constexpr (_is_enabled) {
+      if (_data)   end(_data.release());
+    }
+  }
+
+  ParallelRegion(const ParallelRegion&)            = delete;
+  ParallelRegion& operator=(const ParallelRegion&) = delete;
+
+  /// one thread working on its share of the region
+  // ParallelRegion::Participant participant{region};
+  class Participant final
+  {
+   public:
+    explicit Participant([[maybe_unused]] ParallelRegion& region) {
+      if constexpr (_is_enabled) {
+        begin(region);
+      }
+    }
+
+    ~Participant() {
+      if constexpr (_is_enabled) {
+        end();
+      }
+    }
+
+    Participant(const Participant&)            = delete;
+    Participant& operator=(const Participant&) = delete;
+
+   private:
+    ParallelParticipant* _participant = nullptr;   // nullptr=region full
+    std::uint64_t _start_ns = 0;
+    std::shared_ptr<Record> _counters_start;
+
+    GIOPLER_OUTLINE void begin(ParallelRegion& region);
+    GIOPLER_OUTLINE void end();
+  };
+
+  /// number of pieces to split n work items into
+  // a few per hardware thread, so the scheduler can still balance the load,
+  // while the counters are only read twice per piece
+  static std::size_t get_chunk_count(const std::size_t n) {
+    const std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    return std::min(n, _chunks_per_thread * threads);
+  }
+
+ private:
+  static constexpr bool _is_enabled = (g_build_mode == BuildMode::Prof);
+  static constexpr std::size_t _max_participants  = 256;   // threads beyond this are not reported
+  static constexpr std::size_t _chunks_per_thread = 4;
+
+  struct RegionData {
+    explicit RegionData(const std::string_view name, const giopler::source_location& source_location)
+    : _name(name), _source_location(source_location) { }
+
+    std::string _name;
+    giopler::source_location _source_location;
+    std::uint64_t _begin_ns = 0;
+    std::atomic<std::size_t> _participant_count{0};   // may exceed _max_participants
+    std::array<ParallelParticipant, _max_participants> _participants;
+  };
+
+  /// start timing the region
+  GIOPLER_OUTLINE static RegionData* begin(std::string_view name, const giopler::source_location& source_location);
+
+  /// compute the load balance metrics and write the ParallelRegion event
+  // takes ownership of the data
+  GIOPLER_OUTLINE static void end(RegionData* data);
+
+  /// find or claim the participant for the current thread
+  // nullptr if the region has no room left for another thread
+  GIOPLER_OUTLINE ParallelParticipant* get_participant();
+
+  // use a data object to help minimize impact when not enabled
+  std::unique_ptr<RegionData> _data;   // nullptr=not enabled, or not sampled
+};
+
+// -----------------------------------------------------------------------------
+/// instrumented versions of the parallel standard algorithms
+// giopler::dev::par::for_each(std::execution::par, v.begin(), v.end(), f);
+// each call is profiled as its own ParallelRegion, named after the algorithm
+// the range is split into a few chunks per hardware thread, each run as a Participant,
+// so the work time and counters are measured per chunk and not per element
+// the execution policy is passed through; outside Prof mode these call the standard algorithm directly
+// the program must include <execution> (and with libstdc++, link with TBB) to use the parallel policies
+namespace par {
+
+// -----------------------------------------------------------------------------
+/// run chunk_function(chunk, chunk_begin, chunk_end) over [0, n) with the execution policy, as a ParallelRegion
+// this is a private function for library internal use only
+template<typename ExecutionPolicy, typename ChunkFunction>
+void run_chunks(ExecutionPolicy&& policy, const std::size_t n, const char* const name,
+                const giopler::source_location& source_location, ChunkFunction&& chunk_function)
+{
+  ParallelRegion region{name, source_location};
+  const std::size_t chunk_count = ParallelRegion::get_chunk_count(n);
+  std::vector<std::size_t> chunks(chunk_count);
+  std::iota(chunks.begin(), chunks.end(), 0);
+
+  std::for_each(std::forward<ExecutionPolicy>(policy), chunks.begin(), chunks.end(),
+      [&region, &chunk_function, n, chunk_count](const std::size_t chunk) {
+        ParallelRegion::Participant participant{region};
+        chunk_function(chunk, n * chunk / chunk_count, n * (chunk+1) / chunk_count);
+      });
+}
+
+// -----------------------------------------------------------------------------
+template<typename ExecutionPolicy, std::random_access_iterator Iterator, typename Function>
+void for_each(ExecutionPolicy&& policy, Iterator first, Iterator last, Function function,
+              const giopler::source_location& source_location = giopler::source_location::current())
+{
+  if constexpr (g_build_mode == BuildMode::Prof) {
+    run_chunks(std::forward<ExecutionPolicy>(policy), static_cast<std::size_t>(last - first), "for_each", source_location,
+        [first, &function](std::size_t /*chunk*/, const std::size_t chunk_begin, const std::size_t chunk_end) {
+          std::for_each(first + chunk_begin, first + chunk_end, function);
+        });
+  } else {
+    std::for_each(std::forward<ExecutionPolicy>(policy), first, last, function);
+  }
+}
+
+// -----------------------------------------------------------------------------
+template<typename ExecutionPolicy, std::random_access_iterator Iterator, typename Size, typename Function>
+Iterator for_each_n(ExecutionPolicy&& policy, Iterator first, Size n, Function function,
+                    const giopler::source_location& source_location = giopler::source_location::current())
+{
+  if constexpr (g_build_mode == BuildMode::Prof) {
+    const std::size_t count = n > 0 ? static_cast<std::size_t>(n) : 0;
+    run_chunks(std::forward<ExecutionPolicy>(policy), count, "for_each_n", source_location,
+        [first, &function](std::size_t /*chunk*/, const std::size_t chunk_begin, const std::size_t chunk_end) {
+          std::for_each(first + chunk_begin, first + chunk_end, function);
+        });
+    return first + count;
+  } else {
+    return std::for_each_n(std::forward<ExecutionPolicy>(policy), first, n, function);
+  }
+}
+
+// -----------------------------------------------------------------------------
+template<typename ExecutionPolicy, std::random_access_iterator Iterator,
+         std::random_access_iterator OutputIterator, typename UnaryOperation>
+OutputIterator transform(ExecutionPolicy&& policy, Iterator first, Iterator last, OutputIterator d_first,
+                         UnaryOperation unary_op,
+                         const giopler::source_location& source_location = giopler::source_location::current())
+{
+  if constexpr (g_build_mode == BuildMode::Prof) {
+    const auto n = static_cast<std::size_t>(last - first);
+    run_chunks(std::forward<ExecutionPolicy>(policy), n, "transform", source_location,
+        [first, d_first, &unary_op](std::size_t /*chunk*/, const std::size_t chunk_begin, const std::size_t chunk_end) {
+          std::transform(first + chunk_begin, first + chunk_end, d_first + chunk_begin, unary_op);
+        });
+    return d_first + n;
+  } else {
+    return std::transform(std::forward<ExecutionPolicy>(policy), first, last, d_first, unary_op);
+  }
+}
+
+// -----------------------------------------------------------------------------
+template<typename ExecutionPolicy, std::random_access_iterator Iterator1, std::random_access_iterator Iterator2,
+         std::random_access_iterator OutputIterator, typename BinaryOperation>
+OutputIterator transform(ExecutionPolicy&& policy, Iterator1 first1, Iterator1 last1, Iterator2 first2,
+                         OutputIterator d_first, BinaryOperation binary_op,
+                         const giopler::source_location& source_location = giopler::source_location::current())
+{
+  if constexpr (g_build_mode == BuildMode::Prof) {
+    const auto n = static_cast<std::size_t>(last1 - first1);
+    run_chunks(std::forward<ExecutionPolicy>(policy), n, "transform", source_location,
+        [first1, first2, d_first, &binary_op](std::size_t /*chunk*/, const std::size_t chunk_begin, const std::size_t chunk_end) {
+          std::transform(first1 + chunk_begin, first1 + chunk_end, first2 + chunk_begin, d_first + chunk_begin, binary_op);
+        });
+    return d_first + n;
+  } else {
+    return std::transform(std::forward<ExecutionPolicy>(policy), first1, last1, first2, d_first, binary_op);
+  }
+}
+
+// -----------------------------------------------------------------------------
+/// the chunk results are combined in chunk order
+// like the standard algorithm, reduce must be associative and commutative
+template<typename ExecutionPolicy, std::random_access_iterator Iterator,
+         typename T, typename BinaryReduceOperation, typename UnaryTransformOperation>
+T transform_reduce(ExecutionPolicy&& policy, Iterator first, Iterator last, T init,
+                   BinaryReduceOperation reduce, UnaryTransformOperation transform,
+                   const giopler::source_location& source_location = giopler::source_location::current())
+{
+  if constexpr (g_build_mode == BuildMode::Prof) {
+    const auto n = static_cast<std::size_t>(last - first);
+    std::vector<T> results(ParallelRegion::get_chunk_count(n), init);
+    run_chunks(std::forward<ExecutionPolicy>(policy), n, "transform_reduce", source_location,
+        [first, &results, &reduce, &transform](const std::size_t chunk, const std::size_t chunk_begin, const std::size_t chunk_end) {
+          T result = transform(*(first + chunk_begin));
+          for (std::size_t pos = chunk_begin+1; pos < chunk_end; ++pos) {
+            result = reduce(std::move(result), transform(*(first + pos)));
+          }
+          results[chunk] = std::move(result);
+        });
+    for (T& result : results) {
+      init = reduce(std::move(init), std::move(result));
+    }
+    return init;
+  } else {
+    return std::transform_reduce(std::forward<ExecutionPolicy>(policy), first, last, init, reduce, transform);
+  }
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace par
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+ParallelRegion::RegionData* ParallelRegion::begin(const std::string_view name, const giopler::source_location& source_location)
+{
+  std::unique_ptr<RegionData> data = std::make_unique<RegionData>(name, source_location);
+  data->_begin_ns = to_nanoseconds(now_steady());
+  return data.release();
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void ParallelRegion::end(RegionData* const data)
+{
+  const std::unique_ptr<RegionData> data_owner{data};
+  const std::uint64_t end_ns = to_nanoseconds(now_steady());
+  const std::uint64_t wall_ns = end_ns - data->_begin_ns;
+  const std::size_t participant_count =
+      std::min(data->_participant_count.load(std::memory_order_acquire), _max_participants);
+
+  std::shared_ptr<giopler::Array> participants_array = make_arena_shared<giopler::Array>();
+  std::shared_ptr<Record> counters_total = make_arena_shared<Record>();
+  std::size_t threads = 0;
+  std::uint64_t work_sum_ns = 0;
+  std::uint64_t work_max_ns = 0;
+  std::uint64_t work_min_ns = UINT64_MAX;
+  const ParallelParticipant* straggler = nullptr;
+
+  for (std::size_t pos = 0; pos < participant_count; ++pos) {
+    const ParallelParticipant& participant = data->_participants[pos];
+    if (!participant._is_claimed.load(std::memory_order_acquire))   continue;
+    threads++;
+    work_sum_ns += participant._work_ns;
+    work_max_ns  = std::max(work_max_ns, participant._work_ns);
+    work_min_ns  = std::min(work_min_ns, participant._work_ns);
+    if (!straggler || participant._last_end_ns > straggler->_last_end_ns)   straggler = &participant;
+
+    // idle = waiting to be scheduled, between calls, and for the other threads at the join
+    std::shared_ptr<Record> participant_record = make_arena_shared<Record>(RecordInitList{
+      {"thrd_id"s,   participant._thread_id},
+      {"work"s,      ns_to_sec(participant._work_ns)},
+      {"idle"s,      ns_to_sec(wall_ns - std::min(wall_ns, participant._work_ns))},
+      {"fork_wait"s, ns_to_sec(participant._first_start_ns - data->_begin_ns)},
+      {"join_wait"s, ns_to_sec(end_ns - participant._last_end_ns)},
+      {"calls"s,     participant._calls},
+    });
+    if (participant._counters) {
+      participant_record->insert({{"prof"s, participant._counters}});
+      add_number_record(*counters_total, *participant._counters);
+    }
+    participants_array->emplace_back(participant_record);
+  }
+
+  const double wall      = ns_to_sec(wall_ns);
+  const double work_mean = threads ? ns_to_sec(work_sum_ns) / static_cast<double>(threads) : 0;
+  const double imbalance = work_mean > 0 ? ns_to_sec(work_max_ns) / work_mean : 0;
+  const double efficiency = (threads && wall > 0) ? ns_to_sec(work_sum_ns) / (static_cast<double>(threads) * wall) : 0;
+
+  std::shared_ptr<Record> record =
+      get_event_record(data->_source_location, EventCategory::Profile, Event::ParallelRegion, UUID());
+  record->insert_or_assign("msg"s,       data->_name);
+  record->insert_or_assign("wall"s,      wall);
+  record->insert_or_assign("threads"s,   threads);
+  record->insert_or_assign("dropped"s,   data->_participant_count.load() - participant_count);
+  record->insert_or_assign("work_sum"s,  ns_to_sec(work_sum_ns));
+  record->insert_or_assign("work_max"s,  ns_to_sec(work_max_ns));
+  record->insert_or_assign("work_min"s,  threads ? ns_to_sec(work_min_ns) : 0);
+  record->insert_or_assign("work_mean"s, work_mean);
+  record->insert_or_assign("imbal"s,     imbalance);
+  record->insert_or_assign("par_eff"s,   efficiency);
+  record->insert_or_assign("strag_id"s,  straggler ? straggler->_thread_id : 0);
+  record->insert_or_assign("strag_work"s, straggler ? ns_to_sec(straggler->_work_ns) : 0);
+  record->insert({{"parts"s, participants_array}});
+  if (!counters_total->empty())   record->insert({{"prof_tot"s, counters_total}});
+  sink::g_sink_manager.write_record(record);
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+ParallelParticipant* ParallelRegion::get_participant()
+{
+  RegionData& data = *_data;
+  const std::thread::id this_thread = std::this_thread::get_id();
+
+  // a slot that is not published yet belongs to some other thread
+  const std::size_t count = std::min(data._participant_count.load(std::memory_order_acquire), _max_participants);
+  for (std::size_t pos = 0; pos < count; ++pos) {
+    ParallelParticipant& participant = data._participants[pos];
+    if (participant._is_claimed.load(std::memory_order_acquire) && participant._thread == this_thread) {
+      return &participant;
+    }
+  }
+
+  const std::size_t pos = data._participant_count.fetch_add(1, std::memory_order_acq_rel);
+  if (pos >= _max_participants)   return nullptr;
+  ParallelParticipant& participant = data._participants[pos];
+  participant._thread    = this_thread;
+  participant._thread_id = get_thread_id();
+  participant._is_claimed.store(true, std::memory_order_release);
+  return &participant;
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void ParallelRegion::Participant::begin(ParallelRegion& region)
+{
+  if (!region._data)   return;
+  if (g_thread_control._state == ThreadControlBlock::State::NotStarted) [[unlikely]]   Thread::start();
+  _participant = region.get_participant();
+  if (!_participant)   return;
+
+  _counters_start = make_arena_shared<Record>(read_event_counters());
+  _start_ns       = to_nanoseconds(now_steady());
+  if (_participant->_calls == 0)   _participant->_first_start_ns = _start_ns;
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void ParallelRegion::Participant::end()
+{
+  if (!_participant)   return;
+  const std::uint64_t end_ns = to_nanoseconds(now_steady());
+  std::shared_ptr<Record> counters = make_arena_shared<Record>(read_event_counters());
+  subtract_number_record(*counters, *_counters_start);
+
+  _participant->_work_ns    += end_ns - _start_ns;
+  _participant->_last_end_ns = end_ns;
+  _participant->_calls++;
+  if (_participant->_counters) {
+    add_number_record(*(_participant->_counters), *counters);
+  } else {
+    _participant->_counters = counters;
+  }
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+#endif // GIOPLER_CORE_DEFINITIONS
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_PARALLEL_HPP
@@ -34,15 +34,25 @@ class pcg {
     std::random_device rd;   // uses /dev/random on Linux
     const auto s0 = (static_cast<uint64_t>(rd()) << 32) | rd();
     const auto s1 = (static_cast<uint64_t>(rd()) << 32) | rd();
+    *this = from_seed(s1, s0);
+  }
 
-    m_state = 0;
-    m_inc = (s0 << 1) | 1;
-    (void) operator()();
-    m_state += s1;
-    (void) operator()();
+  /// generator for a seed and a stream, like pcg32_srandom_r
+  // generators with different streams produce different sequences, even with the same seed
+  static constexpr pcg from_seed(const uint64_t seed, const uint64_t stream) {
+    pcg generator{0, (stream << 1) | 1};
+    (void) generator();
+    generator.m_state += seed;
+    (void) generator();
+    return generator;
   }
 
-  result_type operator()() {
+  /// generator with a given state, allows constant initialization
+  // the default constructor should be used to get a seeded generator
+  constexpr explicit pcg(const uint64_t state, const uint64_t inc)
+  : m_state{state}, m_inc{inc} { }
+
+  constexpr result_type operator()() {
     const uint64_t oldstate   = m_state;
     m_state                   = oldstate * 6364136223846793005ULL + m_inc;
     const auto xorshifted     = static_cast<uint32_t>(((oldstate >> 18u) ^ oldstate) >> 27u);
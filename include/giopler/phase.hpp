@@ -0,0 +1,309 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_PHASE_HPP
+#define GIOPLER_PHASE_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "giopler/config.hpp"
+#include "giopler/control.hpp"
+#include "giopler/counter.hpp"
+#include "giopler/platform.hpp"
+#include "giopler/record.hpp"
+#include "giopler/sink.hpp"
+#include "giopler/utility.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+/// the interned phases of the program
+// this is a private class for library internal use only
+// a phase with the same name and kind is only stored once, and is never destroyed
+class PhaseTable final
+{
+ public:
+  const PhaseInfo* intern(const std::string_view name, const bool is_warmup) {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    for (const PhaseInfo& phase : _phases) {
+      if (phase._name == name && phase._is_warmup == is_warmup)   return &phase;
+    }
+    return &_phases.emplace_back(PhaseInfo{std::string{name}, is_warmup});
+  }
+
+ private:
+  std::mutex _mutex;
+  std::deque<PhaseInfo> _phases;   // stable addresses
+};
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY the single instance is in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+GIOPLER_CORE_INLINE PhaseTable g_phase_table;
+#else
+extern PhaseTable g_phase_table;
+#endif
+
+// -----------------------------------------------------------------------------
+/// the counter totals of the current thread for each phase (Prof, Bench)
+// this is a private class for library internal use only
+// a thread notices a phase change at its next Function entry or exit, and charges the
+// counters since its previous boundary to the phase it was running in
+// a thread that is not running instrumented functions charges a phase change late
+// the totals are reported with the ThreadEnd event
+class ThreadPhases final
+{
+ public:
+  /// start the first segment, when the thread starts
+  void start() {
+    begin_segment(read_counters());
+  }
+
+  /// check for a phase change, called on every Function entry and exit
+  void check() {
+    if (g_thread_control._phase_generation != g_phase_generation.load(std::memory_order_relaxed)) [[unlikely]] {
+      switch_phase();
+    }
+  }
+
+  /// close the last segment, and return [{"phase":name, "warmup":bool, "prof":{...}}, ...]
+  // empty if the thread did not run in any phase
+  GIOPLER_OUTLINE std::shared_ptr<giopler::Array> get_phases_array();
+
+ private:
+  const PhaseInfo* _phase = nullptr;   // phase of the current segment
+  Record _segment_start;
+  std::vector<std::pair<const PhaseInfo*, Record>> _totals;   // few phases, in order of first use
+
+  static Record read_counters() {
+    const TimestampSteady now = now_steady();
+    Record counters{read_event_counters()};
+    counters.insert({{"dur"s, to_seconds(now)}});
+    return counters;
+  }
+
+  void begin_segment(Record counters) {
+    g_thread_control._phase_generation = g_phase_generation.load(std::memory_order_acquire);
+    _phase         = g_current_phase.load(std::memory_order_acquire);
+    _segment_start = std::move(counters);
+  }
+
+  /// add the counters of the current segment to the totals of its phase
+  GIOPLER_OUTLINE void end_segment(const Record& counters);
+
+  GIOPLER_COLD void switch_phase() {
+    Record counters{read_counters()};
+    end_segment(counters);
+    begin_segment(std::move(counters));
+  }
+};
+
+// -----------------------------------------------------------------------------
+/// counter totals for each phase of the current thread
+// created before the Thread object, so it is destroyed after it
+inline thread_local ThreadPhases g_thread_phases;
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+
+// -----------------------------------------------------------------------------
+namespace giopler::prod {
+
+// -----------------------------------------------------------------------------
+/// measured phases are included in aggregations, warm-up phases are excluded by default
+enum class PhaseKind { Measured, WarmUp };
+
+// -----------------------------------------------------------------------------
+/// a phase of the program, like load, warm-up, steady state, or drain
+// phases are program-wide: every event sent by any thread while the phase is active
+// has its name in the "phase" field, and warm-up phases also set "warmup" to true
+// phases can be nested; they should begin and end in the same order, usually in the main thread
+// the PhaseEnd event has the process-wide counter totals for the phase ("prof_proc"),
+// and the derived metrics: CPU utilization, page fault and context switch rates, memory growth
+// in Prof and Bench modes each thread also reports its counter totals for each phase
+// in Bench mode the Function events inside a warm-up phase are not sent
+// giopler::prod::Phase phase{"warm-up", giopler::prod::PhaseKind::WarmUp};
+class Phase final
+{
+ public:
+  explicit Phase([[maybe_unused]] const std::string_view name,
+                 [[maybe_unused]] const PhaseKind kind = PhaseKind::Measured,
+                 [[maybe_unused]] const giopler::source_location& source_location = giopler::source_location::current())
+  : _data{_is_enabled ? begin(name, kind, source_location) : nullptr}
+  { }
+
+  ~Phase() {
+    if constexpr (_is_enabled) {
+      end(_data.release());
+    }
+  }
+
+  Phase(const Phase&) = delete;
+  Phase& operator=(const Phase&) = delete;
+
+  /// true inside a warm-up phase
+  static bool is_warmup() {
+    const PhaseInfo* const phase = g_current_phase.load(std::memory_order_acquire);
+    return phase && phase->_is_warmup;
+  }
+
+ private:
+  static constexpr bool _is_enabled = (g_build_mode != BuildMode::Off);
+
+  struct PhaseData {
+    std::unique_ptr<giopler::source_location> _source_location;
+    UUID _begin_id;
+    UUID _end_id;
+    const PhaseInfo* _phase;
+    const PhaseInfo* _parent_phase;
+    TimestampSteady _start_time;
+    Record _process_counters_start;
+    std::uint64_t _rss_start;
+  };
+
+  /// make the phase current, and write the PhaseBegin event
+  GIOPLER_OUTLINE static PhaseData* begin(std::string_view name, PhaseKind kind,
+                                          const giopler::source_location& source_location);
+
+  /// write the PhaseEnd event, and make the parent phase current again
+  // takes ownership of the data
+  GIOPLER_OUTLINE static void end(PhaseData* data);
+
+  // use a data object to help minimize impact when not enabled
+  std::unique_ptr<PhaseData> _data;
+};
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::prod
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void ThreadPhases::end_segment(const Record& counters)
+{
+  if (!_phase)   return;   // time outside any phase is not reported
+
+  Record segment{counters};
+  subtract_number_record(segment, _segment_start);
+  for (auto& [phase, total] : _totals) {
+    if (phase == _phase) {
+      add_number_record(total, segment);
+      return;
+    }
+  }
+  _totals.emplace_back(_phase, std::move(segment));
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+std::shared_ptr<giopler::Array> ThreadPhases::get_phases_array()
+{
+  end_segment(read_counters());
+  _phase = nullptr;
+
+  std::shared_ptr<giopler::Array> phases = make_arena_shared<giopler::Array>();
+  for (const auto& [phase, total] : _totals) {
+    phases->emplace_back(make_arena_shared<Record>(Record{
+        {"phase"s,    std::string_view{phase->_name}},
+        {"warmup"s,   phase->_is_warmup},
+        {"prof"s,     make_arena_shared<Record>(total)}
+    }));
+  }
+  return phases;
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+
+namespace giopler::prod {
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+Phase::PhaseData* Phase::begin(const std::string_view name, const PhaseKind kind,
+                               const giopler::source_location& source_location)
+{
+  std::unique_ptr<PhaseData> data = std::make_unique<PhaseData>();
+  data->_source_location        = std::make_unique<giopler::source_location>(source_location);
+  data->_phase                  = dev::g_phase_table.intern(name, kind == PhaseKind::WarmUp);
+  data->_parent_phase           = g_current_phase.exchange(data->_phase, std::memory_order_acq_rel);
+  g_phase_generation.fetch_add(1, std::memory_order_release);
+
+  data->_rss_start              = get_process_memory().rss;
+  data->_process_counters_start = dev::read_process_counters();
+  data->_start_time             = now_steady();
+
+  std::shared_ptr<Record> record_begin =
+      get_event_record(source_location, EventCategory::Profile, Event::PhaseBegin, data->_begin_id);
+  record_begin->insert_or_assign("other_id"s, data->_end_id.get_string());
+  record_begin->insert_or_assign("msg"s, name);
+  record_begin->insert_or_assign("warmup"s, kind == PhaseKind::WarmUp);
+  sink::g_sink_manager.write_record(record_begin);
+  return data.release();
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void Phase::end(PhaseData* const data)
+{
+  const std::unique_ptr<PhaseData> data_owner{data};
+  const TimestampSteady end_time = now_steady();
+  std::shared_ptr<Record> process_counters = make_arena_shared<Record>(dev::read_process_counters());
+  dev::subtract_number_record(*process_counters, data->_process_counters_start);
+  const std::uint64_t rss = get_process_memory().rss;
+
+  const double duration      = timestamp_diff(data->_start_time, end_time);
+  const double cpu_time      = (*process_counters)["sw_task_clck"s].get_real();
+  const auto per_second      = [duration](const double value) { return duration > 0 ? value / duration : 0.0; };
+  const double cpu_cores     = static_cast<double>(get_available_cpu_cores());
+
+  std::shared_ptr<Record> record_end =
+      get_event_record(*(data->_source_location), EventCategory::Profile, Event::PhaseEnd, data->_end_id);
+  record_end->insert_or_assign("other_id"s, data->_begin_id.get_string());
+  record_end->insert_or_assign("msg"s, std::string_view{data->_phase->_name});
+  record_end->insert_or_assign("warmup"s, data->_phase->_is_warmup);
+  record_end->insert({
+      {"dur"s,                duration},
+      {"cpu_util"s,           per_second(cpu_time)},   // average number of busy cores
+      {"cpu_frac"s,           cpu_cores > 0 ? per_second(cpu_time) / cpu_cores : 0.0},
+      {"pg_fault_rate"s,      per_second(static_cast<double>((*process_counters)["sw_pg_fault"s].get_integer()))},
+      {"cntxt_swtch_rate"s,   per_second(static_cast<double>((*process_counters)["sw_cntxt_swtch"s].get_integer()))},
+      {"rss"s,                static_cast<std::int64_t>(rss)},
+      {"rss_diff"s,           static_cast<std::int64_t>(rss) - static_cast<std::int64_t>(data->_rss_start)},
+      {"prof_proc"s,          process_counters}
+  });
+  sink::g_sink_manager.write_record(record_end);
+
+  g_current_phase.store(data->_parent_phase, std::memory_order_release);
+  g_phase_generation.fetch_add(1, std::memory_order_release);
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::prod
+#endif // GIOPLER_CORE_DEFINITIONS
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_PHASE_HPP
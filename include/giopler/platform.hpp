@@ -17,6 +17,7 @@
 #endif
 
 #include <string>
+#include <cstddef>
 #include <cstdint>
 
 #include "giopler/config.hpp"
@@ -26,7 +27,7 @@ namespace giopler {
 // these values are assumed to be constant for the duration of the program execution
 extern uint64_t get_memory_page_size();
 extern uint64_t get_physical_memory();
-extern uint64_t get_total_cpu_cores();
+extern uint64_t get_conf_cpu_cores();
 extern uint64_t get_available_cpu_cores();
 extern std::string get_program_name();
 extern uint64_t get_process_id();
@@ -40,10 +41,30 @@ extern uint64_t get_thread_id();
 extern uint64_t get_node_id();
 extern uint64_t get_cpu_id();
 extern uint64_t get_available_memory();
+extern uint64_t get_cur_freq();
+extern uint64_t get_max_freq();
+extern double get_load_average1();
+extern double get_load_average5();
+extern double get_load_average15();
+
+/// memory used by this process, in bytes
+struct ProcessMemory {
+  uint64_t rss{};         // resident set size
+  uint64_t anon{};        // resident anonymous memory
+  uint64_t file{};        // resident file-backed memory
+  uint64_t anon_huge{};   // anonymous memory backed by transparent huge pages
+  uint64_t swap{};        // anonymous memory swapped out
+  uint64_t hwm{};         // peak resident set size (high water mark)
+};
+extern ProcessMemory get_process_memory();
+
+// memory management hints
+extern void advise_huge_pages(void* address, std::size_t length);
 }   // namespace giopler
 
 // -----------------------------------------------------------------------------
-#if defined(GIOPLER_PLATFORM_LINUX)
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if defined(GIOPLER_PLATFORM_LINUX) && GIOPLER_CORE_DEFINITIONS
 #include "giopler/linux/platform.hpp"
 #endif
 
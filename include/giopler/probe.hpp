@@ -0,0 +1,281 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_PROBE_HPP
+#define GIOPLER_PROBE_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "giopler/config.hpp"
+#include "giopler/record.hpp"
+#include "giopler/utility.hpp"
+
+// -----------------------------------------------------------------------------
+// https://sourceware.org/systemtap/wiki/UserSpaceProbeImplementation
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+/// one instrumentation site (Function, branch, message, or contract)
+// the assembler writes a descriptor for every place a site's code is emitted into the
+// giopler_sites section, so the table is complete when the program starts
+// the code address identifies the site; the file, function, and line are written the first
+// time the site runs, and can be found before that from the debug information of the address
+// a disabled site does not write its events, but a failed contract is always reported
+// external tools can enable or disable a site by writing its enable byte in the running process
+// layout, 32 bytes: address, file, function, line (int32), category, event, enabled, reserved
+struct ProbeSite final
+{
+  const void* _address;
+  const char* _file;
+  const char* _function;
+  std::int32_t _line;
+  std::uint8_t _category;   // EventCategory
+  std::uint8_t _event;      // Event
+  std::uint8_t _enabled;
+  std::uint8_t _reserved;
+
+  [[nodiscard]] bool is_enabled() {
+    return std::atomic_ref<std::uint8_t>{_enabled}.load(std::memory_order_relaxed);
+  }
+
+  void set_enabled(const bool enabled) {
+    std::atomic_ref<std::uint8_t>{_enabled}.store(enabled, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] bool is_located() {
+    return std::atomic_ref<const char*>{_file}.load(std::memory_order_acquire) != nullptr;
+  }
+
+  /// note the source location, and apply the GIOPLER_PROBES_OFF rules, the first time the site runs
+  GIOPLER_COLD void locate(const source_location& source_location);
+};
+
+// -----------------------------------------------------------------------------
+/// true if the site should write its events
+// the check is two loads from the site's descriptor
+[[gnu::always_inline]] inline bool is_probe_enabled(ProbeSite* const site, const source_location& source_location)
+{
+  if (!site->is_located()) [[unlikely]]   site->locate(source_location);
+  return site->is_enabled();
+}
+
+// -----------------------------------------------------------------------------
+/// the rules of GIOPLER_PROBES_OFF
+// this is a private class for library internal use only
+// a comma separated list of category names, event names, files, or file:line
+// "Trace,Message,parser.cpp,main.cpp:42"; a file matches the end of the site's path
+class ProbeRules final
+{
+ public:
+  explicit ProbeRules() {
+    const char* rules = std::getenv("GIOPLER_PROBES_OFF");
+    std::string_view rules_view{rules ? rules : ""};
+    while (!rules_view.empty()) {
+      const std::size_t end = std::min(rules_view.find(','), rules_view.size());
+      const std::string_view rule = rules_view.substr(0, end);
+      const std::size_t colon = rule.rfind(':');
+      if (colon != std::string_view::npos && colon > 0) {
+        _rules.push_back(Rule{std::string{rule.substr(0, colon)}, std::atoi(std::string{rule.substr(colon+1)}.c_str())});
+      } else if (!rule.empty()) {
+        _rules.push_back(Rule{std::string{rule}, 0});
+      }
+      rules_view.remove_prefix(std::min(end+1, rules_view.size()));
+    }
+  }
+
+  /// true if a rule disables the site
+  // the rules are not changed after construction
+  [[nodiscard]] bool is_disabled(const ProbeSite& site, const source_location& source_location) const {
+    const std::string_view category = get_event_category_name(static_cast<EventCategory>(site._category));
+    const std::string_view event    = get_event_name(static_cast<Event>(site._event));
+    const std::string_view file{source_location.file_name()};
+    for (const Rule& rule : _rules) {
+      if (rule._line == 0 && (rule._text == category || rule._text == event))   return true;
+      if (file.ends_with(rule._text) && (rule._line == 0 || rule._line == source_location.line()))   return true;
+    }
+    return false;
+  }
+
+ private:
+  struct Rule {
+    std::string _text;
+    int _line;   // 0 for any line
+  };
+  std::vector<Rule> _rules;
+};
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY the single instance is in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+GIOPLER_CORE_INLINE ProbeRules g_probe_rules;
+#else
+extern ProbeRules g_probe_rules;
+#endif
+
+// -----------------------------------------------------------------------------
+// the site table is written by the assembler on x86-64 and aarch64 ELF platforms;
+// elsewhere every site of an event shares a single descriptor
+#if defined(GIOPLER_PLATFORM_LINUX) && (defined(__x86_64__) || defined(__aarch64__))
+#define GIOPLER_PROBE_SECTION 1
+static_assert(sizeof(ProbeSite) == 32);
+
+// the linker defines these for a section whose name is an identifier
+// they are hidden, so each shared library sees its own sites
+extern "C" {
+extern ProbeSite __start_giopler_sites[] __attribute__((weak, visibility("hidden")));
+extern ProbeSite __stop_giopler_sites[]  __attribute__((weak, visibility("hidden")));
+}
+
+#if defined(__x86_64__)
+#define GIOPLER_PROBE_ADDRESS "lea 995b(%%rip), %[probe_site]\n"
+#else
+#define GIOPLER_PROBE_ADDRESS "adrp %[probe_site], 995b\n\tadd %[probe_site], %[probe_site], :lo12:995b\n"
+#endif
+
+// -----------------------------------------------------------------------------
+/// declare the descriptor of the site where it is expanded, for library internal use only
+// the nop is the probe point, with a SystemTap SDT note (as written by <sys/sdt.h>) so that
+// stap, perf, bpftrace, and gdb can attach to "giopler:<name>" with the arguments file, line, function
+// the "?" flag puts the note and the descriptor in the section group of the code, if any, so they
+// are discarded with it; the functions expanding it are always inlined, so each site has its own entry
+#define GIOPLER_PROBE_SITE(site, name, category, event, location)                                   \
+  [[maybe_unused]] ::giopler::dev::ProbeSite* site;                                                 \
+  asm volatile("990: nop\n"                                                                         \
+               ".pushsection .note.stapsdt,\"?\",\"note\"\n"                                        \
+               ".balign 4\n"                                                                        \
+               ".4byte 992f-991f, 994f-993f, 3\n"                                                   \
+               "991: .asciz \"stapsdt\"\n"                                                          \
+               "992: .balign 4\n"                                                                   \
+               "993: .8byte 990b\n"                                                                 \
+               ".8byte _.stapsdt.base\n"                                                            \
+               ".8byte 0\n"                                                                         \
+               ".asciz \"giopler\"\n"                                                               \
+               ".asciz \"" name "\"\n"                                                              \
+               ".asciz \"8@%[probe_file] -4@%[probe_line] 8@%[probe_function]\"\n"                  \
+               "994: .balign 4\n"                                                                   \
+               ".popsection\n"                                                                      \
+               ".ifndef _.stapsdt.base\n"                                                           \
+               ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"              \
+               ".weak _.stapsdt.base\n"                                                             \
+               ".hidden _.stapsdt.base\n"                                                           \
+               "_.stapsdt.base: .space 1\n"                                                         \
+               ".size _.stapsdt.base, 1\n"                                                          \
+               ".popsection\n"                                                                      \
+               ".endif\n"                                                                           \
+               ".pushsection giopler_sites,\"?aw\"\n"                                               \
+               ".balign 8\n"                                                                        \
+               "995: .8byte 990b, 0, 0\n"                                                           \
+               ".4byte 0\n"                                                                         \
+               ".byte %c[probe_category], %c[probe_event], 1, 0\n"                                  \
+               ".popsection\n"                                                                      \
+               GIOPLER_PROBE_ADDRESS                                                                \
+               : [probe_site] "=r"(site)                                                            \
+               : [probe_category] "n"(static_cast<int>(category)), [probe_event] "n"(static_cast<int>(event)), \
+                 [probe_file] "nor"(location.file_name()), [probe_line] "nor"(location.line()),     \
+                 [probe_function] "nor"(location.function_name()))
+
+// -----------------------------------------------------------------------------
+/// the sites of the program or shared library that includes this header
+inline std::span<ProbeSite> get_probe_sites()
+{
+  if (!__start_giopler_sites)   return {};
+  return {__start_giopler_sites, __stop_giopler_sites};
+}
+
+#else
+// -----------------------------------------------------------------------------
+constexpr std::size_t g_probe_site_count = static_cast<std::size_t>(Event::AllocationSummary) + 1;   // last event
+
+/// an enabled descriptor for each event
+consteval std::array<ProbeSite, g_probe_site_count> make_probe_sites()
+{
+  std::array<ProbeSite, g_probe_site_count> sites{};
+  for (std::size_t event = 0; event < g_probe_site_count; ++event) {
+    const auto category = event <= static_cast<std::size_t>(Event::Certify) ? EventCategory::Contract :
+                          event <= static_cast<std::size_t>(Event::Branch)  ? EventCategory::Trace :
+                          event <= static_cast<std::size_t>(Event::Message) ? EventCategory::Log : EventCategory::Profile;
+    sites[event]._category = static_cast<std::uint8_t>(category);
+    sites[event]._event    = static_cast<std::uint8_t>(event);
+    sites[event]._enabled  = 1;
+  }
+  return sites;
+}
+
+/// the shared descriptor of each event
+// this is a private variable for library internal use only
+constinit inline std::array<ProbeSite, g_probe_site_count> g_probe_sites = make_probe_sites();
+
+#define GIOPLER_PROBE_SITE(site, name, category, event, location)                                   \
+  [[maybe_unused]] ::giopler::dev::ProbeSite* const site =                                          \
+      &::giopler::dev::g_probe_sites[static_cast<std::size_t>(event)]
+
+// -----------------------------------------------------------------------------
+/// the descriptor of every event that has run
+inline std::span<ProbeSite> get_probe_sites()
+{
+  return g_probe_sites;
+}
+#endif
+
+// -----------------------------------------------------------------------------
+/// enable or disable all the sites of an event category
+inline void set_probes_enabled(const EventCategory category, const bool enabled)
+{
+  for (ProbeSite& site : get_probe_sites()) {
+    if (site._category == static_cast<std::uint8_t>(category))   site.set_enabled(enabled);
+  }
+}
+
+// -----------------------------------------------------------------------------
+/// enable or disable all the sites of an event
+inline void set_probes_enabled(const Event event, const bool enabled)
+{
+  for (ProbeSite& site : get_probe_sites()) {
+    if (site._event == static_cast<std::uint8_t>(event))   site.set_enabled(enabled);
+  }
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void ProbeSite::locate(const source_location& source_location)
+{
+  if (g_probe_rules.is_disabled(*this, source_location))   set_enabled(false);
+  std::atomic_ref<const char*>{_function}.store(source_location.function_name(), std::memory_order_relaxed);
+  std::atomic_ref<std::int32_t>{_line}.store(source_location.line(), std::memory_order_relaxed);
+  std::atomic_ref<const char*>{_file}.store(source_location.file_name(), std::memory_order_release);
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+#endif // GIOPLER_CORE_DEFINITIONS
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_PROBE_HPP
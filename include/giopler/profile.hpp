@@ -16,12 +16,25 @@
 #error C++20 or newer support required to use this header-only library.
 #endif
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstdlib>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <type_traits>
+#include <vector>
 
 #include "giopler/counter.hpp"
+#include "giopler/frame.hpp"
+#include "giopler/hardware.hpp"
+#include "giopler/phase.hpp"
+#include "giopler/probe.hpp"
+#include "giopler/sampling.hpp"
+#include "giopler/span.hpp"
+#include "giopler/trigger.hpp"
 
 // -----------------------------------------------------------------------------
 namespace giopler::dev {
@@ -37,23 +50,28 @@ class Trace final
   explicit Trace(UUID uuid, const char* function_name)
   : _uuid{std::move(uuid)}, _function_name(function_name)
   {
-    _stack_depth++;
-    _parent_trace_object  = _trace_object;
-    _trace_object         = this;
+    ThreadControlBlock& thread_control = g_thread_control;
+    thread_control._stack_depth++;
+    _parent_trace_object          = thread_control._trace_object;
+    thread_control._trace_object  = this;
     if (_parent_trace_object)   _parent_trace_object->_is_leaf = false;   // by definition
+    if (thread_control._published_frames)   thread_control._published_frames->push(function_name);
   }
 
   ~Trace() {
-    _trace_object = _parent_trace_object;
-    _stack_depth--;
+    ThreadControlBlock& thread_control = g_thread_control;
+    if (thread_control._published_frames)   thread_control._published_frames->pop();
+    thread_control._trace_object = _parent_trace_object;
+    thread_control._stack_depth--;
   }
 
   /// generates the JSON compatible function id call stack
   // [0]=thread, [_stack_depth-1]=current function
   // [<thread start event id>, <function start event id>, ...]
   std::shared_ptr<giopler::Array> get_uuids() {
-    std::shared_ptr<giopler::Array> stack{std::make_shared<giopler::Array>(_stack_depth)};
-    std::size_t current_stack_frame = _stack_depth-1;
+    const std::uint32_t stack_depth = g_thread_control._stack_depth;
+    std::shared_ptr<giopler::Array> stack{make_arena_shared<giopler::Array>(stack_depth)};
+    std::size_t current_stack_frame = stack_depth-1;
     Trace* trace_object             = this;
 
     while (trace_object) {
@@ -68,8 +86,9 @@ class Trace final
   // [0]=thread, [_stack_depth-1]=current function
   // [<thread start event id>, <function start event id>, ...]
   std::shared_ptr<giopler::Array> get_function_names() {
-    std::shared_ptr<giopler::Array> stack{std::make_shared<giopler::Array>(_stack_depth)};
-    std::size_t current_stack_frame = _stack_depth-1;
+    const std::uint32_t stack_depth = g_thread_control._stack_depth;
+    std::shared_ptr<giopler::Array> stack{make_arena_shared<giopler::Array>(stack_depth)};
+    std::size_t current_stack_frame = stack_depth-1;
     Trace* trace_object             = this;
 
     while (trace_object) {
@@ -86,8 +105,6 @@ class Trace final
   }
 
  private:
-  static inline thread_local Trace* _trace_object       = nullptr;
-  static inline thread_local std::uint32_t _stack_depth = 0;
   Trace* _parent_trace_object;
   UUID _uuid;                   // UUID for this stack frame (ThreadEnd or FunctionEnd)
   const char* _function_name;   // function name for this stack frame
@@ -98,21 +115,24 @@ class Trace final
 /// keeps track of the profiling performance counters for Function
 // this is a private class for library internal use only
 // this is an internal implementation detail of the Function class
+// the user-defined counters (see count()) are kept in a fixed array of slots, one per counter id;
+// they are added to the parent frame when this frame stops, like the hardware counters include the children
 class Profile final
 {
  public:
   explicit Profile() {
     const TimestampSteady start_time = now_steady();
-    _event_counters_start = std::make_shared<Record>(read_event_counters());
+    _event_counters_start = make_arena_shared<Record>(read_event_counters());
     _event_counters_start->insert({{"dur"s, to_seconds(start_time) }});
-    _event_counters_children = std::make_shared<Record>();
+    _event_counters_children = make_arena_shared<Record>();
 
-    _parent_profile_object  = _profile_object;
-    _profile_object         = this;
+    ThreadControlBlock& thread_control = g_thread_control;
+    _parent_profile_object          = thread_control._profile_object;
+    thread_control._profile_object  = this;
   }
 
   ~Profile() {
-    _profile_object = _parent_profile_object;
+    g_thread_control._profile_object = _parent_profile_object;
   }
 
   std::shared_ptr<Record> get_total_counters_record() {
@@ -125,10 +145,15 @@ class Profile final
     return event_counters_self;
   }
 
+  /// add to a user-defined counter of this frame
+  void add_user_counter(const CounterId id, const std::int64_t delta) {
+    _user_counters[id.get_index()] += delta;
+  }
+
  private:
   bool _frozen = false;
   Profile* _parent_profile_object;
-  static inline thread_local Profile* _profile_object = nullptr;
+  std::array<std::int64_t, UserCounterTable::_max_counters> _user_counters{};   // this frame and its children
 
   std::shared_ptr<Record> _event_counters_start;
   std::shared_ptr<Record> _event_counters_children;
@@ -141,19 +166,92 @@ class Profile final
     _frozen = true;
 
     const TimestampSteady end_time = now_steady();
-    event_counters_total = std::make_shared<Record>(read_event_counters());
+    event_counters_total = make_arena_shared<Record>(read_event_counters());
     event_counters_total->insert({{"dur"s, to_seconds(end_time) }});
     subtract_number_record(*event_counters_total, *_event_counters_start);
 
+    const std::uint32_t user_counters = g_user_counters.size();
+    for (std::uint32_t index = 0; index < user_counters; ++index) {
+      event_counters_total->insert({{g_user_counters.get_key(index), _user_counters[index]}});
+    }
+
     if (_parent_profile_object) {   // subtract our times from the parent's children record
       add_number_record(*(_parent_profile_object->_event_counters_children), *event_counters_total);
+      for (std::uint32_t index = 0; index < user_counters; ++index) {
+        _parent_profile_object->_user_counters[index] += _user_counters[index];
+      }
     }
 
-    event_counters_self = std::make_shared<Record>(*event_counters_total);
+    event_counters_self = make_arena_shared<Record>(*event_counters_total);
     subtract_number_record(*event_counters_self, *_event_counters_children);
   }
 };
 
+// -----------------------------------------------------------------------------
+/// the totals of the summarized threads with the same class name, see set_thread_class
+// this is a private class for library internal use only
+// guarded by the mutex of ThreadClasses
+class ThreadClass final
+{
+ public:
+  explicit ThreadClass(const std::string_view name, const giopler::source_location& source_location)
+  : _name{name}, _source_location{source_location.file_name(), "<thread>", source_location.line()}
+  { }
+
+ private:
+  friend class ThreadClasses;
+  std::string _name;
+  giopler::source_location _source_location;   // of the first set_thread_class call
+  std::int64_t _threads = 0;
+  double _duration = 0;
+  double _duration_max = 0;
+  Record _counters;   // sum of read_thread_counters()
+};
+
+// -----------------------------------------------------------------------------
+/// the classes of the summarized threads
+// this is a private class for library internal use only
+// a ThreadSummary event is written every GIOPLER_THREAD_SUMMARY threads of a class (default 1000),
+// and at program end for the threads not yet reported
+class ThreadClasses final
+{
+ public:
+  explicit ThreadClasses() {
+    const char* threads = std::getenv("GIOPLER_THREAD_SUMMARY");
+    if (threads && std::atoll(threads) > 0)   _summary_threads = std::atoll(threads);
+  }
+
+  ThreadClass* intern(const std::string_view name, const giopler::source_location& source_location) {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    for (ThreadClass& thread_class : _classes) {
+      if (thread_class._name == name)   return &thread_class;
+    }
+    return &_classes.emplace_back(name, source_location);
+  }
+
+  /// add a thread that ended to the totals of its class
+  GIOPLER_OUTLINE void add_thread(ThreadClass& thread_class, double duration, const Record& counters);
+
+  /// write the summaries of the threads not yet reported
+  GIOPLER_COLD void write_summaries();
+
+ private:
+  std::mutex _mutex;
+  std::deque<ThreadClass> _classes;   // stable addresses
+  std::int64_t _summary_threads = 1000;
+
+  /// the ThreadSummary event, and reset the totals; called with the mutex held
+  static std::shared_ptr<Record> get_summary_record(ThreadClass& thread_class);
+};
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY the single instance is in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+GIOPLER_CORE_INLINE ThreadClasses g_thread_classes;
+#else
+extern ThreadClasses g_thread_classes;
+#endif
+
 // -----------------------------------------------------------------------------
 // -----------------------------------------------------------------------------
 /// singleton instance for program-wide data
@@ -173,16 +271,26 @@ class Program final
             get_event_record(*(_data->_source_location), EventCategory::Profile, Event::ProgramBegin, _data->_begin_id);
         record_begin->insert_or_assign("other_id"s, _data->_end_id.get_string());
         record_begin->insert({{"run"s, get_program_record()}});
+        record_begin->insert({{"hw"s, get_hardware_record()}});   // sent in full only once per run
+        record_begin->insert({{"hw_hash"s, get_hardware_hash()}});
         sink::g_sink_manager.write_record(record_begin);
       }
     }
 
     ~Program() {
       if constexpr (g_build_mode != BuildMode::Off) {
+        if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench) {
+          g_thread_classes.write_summaries();
+        }
+        if constexpr (g_build_mode == BuildMode::Prof) {
+          g_span_classes.write_summaries();
+        }
         std::shared_ptr<Record> record_end =
             get_event_record(*(_data->_source_location), EventCategory::Profile, Event::ProgramEnd, _data->_end_id);
         record_end->insert_or_assign("other_id"s, _data->_begin_id.get_string());
         record_end->insert({{"run"s, get_program_record()}});   // used for data aggregation
+        record_end->insert({{"hw_hash"s, get_hardware_hash()}});
+        record_end->insert({{"sink"s, sink::g_sink_manager.get_metrics()}});   // delivery of the events before this one
         sink::g_sink_manager.write_record(record_end);
       }
     }
@@ -199,19 +307,32 @@ class Program final
 };
 
 // -----------------------------------------------------------------------------
-static inline Program g_program;
+// with GIOPLER_CORE_LIBRARY the single instance is in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+GIOPLER_CORE_INLINE Program g_program;
+#else
+extern Program g_program;
+#endif
 
 // -----------------------------------------------------------------------------
 /// one instance per thread
 // this is a private class for library internal use only
 // tries to match the lifetime of the thread
 // we keep trrack of the Trace, but don't bother to report it (empty stack)
+// a summarized thread (see set_thread_class) only adds its lifetime and resource usage
+// to the totals of its class, and has the nil id at the base of its call stacks
 class Thread final
 {
  public:
     explicit Thread([[maybe_unused]] giopler::source_location source_location = giopler::source_location::current())
     {
       if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench) {
+        if (g_thread_control._thread_class) {
+          _summary_data = std::make_unique<SummaryData>(SummaryData{
+              g_thread_control._thread_class, now_steady(), std::make_unique<Trace>(UUID::get_nil(), "<thread>")});
+          return;
+        }
+
         _data = std::make_unique<ThreadData>();
         constexpr bool is_profiling = (g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench);
 
@@ -233,6 +354,13 @@ class Thread final
 
     ~Thread() {
       if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench) {
+        if (_summary_data) {
+          g_thread_classes.add_thread(*_summary_data->_thread_class,
+                                      timestamp_diff(_summary_data->_start_time, now_steady()), read_thread_counters());
+          g_thread_control._state = ThreadControlBlock::State::Exited;
+          return;
+        }
+
         constexpr bool is_profiling = (g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench);
         std::shared_ptr<Record> record_end =
             get_event_record(*(_data->_source_location), EventCategory::Profile, Event::ThreadEnd, _data->_end_id);
@@ -241,14 +369,41 @@ class Thread final
         if constexpr (is_profiling) {
           record_end->insert({{"prof_tot"s, _data->_profile->get_total_counters_record()}});
           record_end->insert({{"prof_self"s,  _data->_profile->get_self_counters_record()}});
+          std::shared_ptr<giopler::Array> phases = g_thread_phases.get_phases_array();
+          if (!phases->empty())   record_end->insert({{"phases"s, phases}});
         }
 
         sink::g_sink_manager.write_record(record_end);
+        g_thread_control._state = ThreadControlBlock::State::Exited;
       }
     }
 
     // force the compiler to retain the g_thread object
-    static const Thread* get_thread() { return g_thread.get(); }
+    static const Thread* get_thread() {
+      if (g_thread_control._state == ThreadControlBlock::State::NotStarted)   start();
+      return g_thread_control._thread;
+    }
+
+    /// create the Thread object for the current thread
+    // called the first time the thread enters a Function
+    // the per-thread objects are created before the Thread object, so they are destroyed after it
+    [[gnu::cold, gnu::noinline]] static void start() {
+      ThreadControlBlock& thread_control = g_thread_control;
+      thread_control._state            = ThreadControlBlock::State::Running;
+      thread_control._published_frames = &g_published_frames;
+      if (thread_control._thread_class) {
+        // summarized threads open their counters and start their phases at the first profiled function
+        thread_control._counters_pending = true;
+      } else {
+        open_event_counters();
+        if constexpr (g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench) {
+          g_thread_phases.start();
+        }
+      }
+      std::unique_ptr<Thread> thread   = std::make_unique<Thread>();
+      thread_control._thread           = thread.get();
+      g_thread                         = std::move(thread);
+    }
 
  private:
     // -----------------------------------------------------------------------------
@@ -256,7 +411,8 @@ class Thread final
     // depends on the counters declared static inline in linux/counters.hpp
     // Note: static initialization order fiasco does not apply when the variables are also inline
     // Static variables in one translation unit are initialized according to their definition order.
-    static inline thread_local std::unique_ptr<Thread> g_thread{std::make_unique<Thread>()};
+    // created by start(), see ThreadControlBlock
+    static inline thread_local std::unique_ptr<Thread> g_thread;
 
     struct ThreadData {
         std::unique_ptr<giopler::source_location> _source_location;
@@ -266,10 +422,34 @@ class Thread final
         std::unique_ptr<Profile> _profile;
     };
 
+    struct SummaryData {
+        ThreadClass* _thread_class;
+        TimestampSteady _start_time;
+        std::unique_ptr<Trace> _trace;
+    };
+
     // use a data object to help minimize impact when not enabled
     std::unique_ptr<ThreadData> _data;
+    std::unique_ptr<SummaryData> _summary_data;
 };
 
+// -----------------------------------------------------------------------------
+/// summarize the current thread with the other threads of this class
+// for short-lived threads, like those of a thread-per-connection server: the thread does not
+// send ThreadBegin and ThreadEnd events, and its counters are opened at its first profiled function;
+// its lifetime and resource usage are added to a ThreadSummary event of the class
+// must be called before the first Function of the thread, it has no effect afterwards
+inline void set_thread_class([[maybe_unused]] const std::string_view name,
+                             [[maybe_unused]] const giopler::source_location& source_location = giopler::source_location::current())
+{
+  if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench) {
+    ThreadControlBlock& thread_control = g_thread_control;
+    if (thread_control._state == ThreadControlBlock::State::NotStarted) {
+      thread_control._thread_class = g_thread_classes.intern(name, source_location);
+    }
+  }
+}
+
 // -----------------------------------------------------------------------------
 /// trace or profile a function
 // in Dev mode we only keep track of locations for tracing
@@ -278,69 +458,102 @@ class Thread final
 //   this way we can refer to the function instance while it is still running
 // workload is a user-supplied amount of work performed estimate
 // report stack trace on entry and profile on exit
+// the outermost Function of a thread, outside any prod::Id, makes the sampling decision (see Sampler)
+// in Bench mode the functions called inside a warm-up prod::Phase are not reported
+// in a span (see prod::IdScope) the function is always profiled, and only adds its self time to the span
 class Function final
 {
  public:
-    explicit Function([[maybe_unused]] const double workload = 0,
-                      [[maybe_unused]] giopler::source_location source_location = giopler::source_location::current())
+    GIOPLER_SITE_INLINE explicit Function([[maybe_unused]] const double workload = 0,
+                      [[maybe_unused]] const giopler::source_location& source_location = giopler::source_location::current())
     {
-      if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench) {
-        _data = std::make_unique<FunctionData>();
-        constexpr bool is_profiling = (g_build_mode == BuildMode::Prof);
-
-        if constexpr (is_profiling) {
-          _data->_profile = std::make_unique<Profile>();
+      if constexpr (_is_enabled) {
+        GIOPLER_PROBE_SITE(site, "function", EventCategory::Profile, Event::FunctionBegin, source_location);
+        if (!is_probe_enabled(site, source_location))   return;
+        ThreadControlBlock& thread_control = g_thread_control;
+        if (thread_control._sampling == ThreadControlBlock::Sampling::Undecided) [[unlikely]] {
+          _is_sampling_root = true;
+          thread_control._sampling = g_sampler.is_kept() ?
+              ThreadControlBlock::Sampling::Keep : ThreadControlBlock::Sampling::Drop;
+        }
+        if ((thread_control._sampling == ThreadControlBlock::Sampling::Keep || thread_control._span) &&
+            !is_warmup_skipped()) {
+          _data.reset(begin(workload, source_location));
         }
-
-        _data->_source_location = std::make_unique<giopler::source_location>(source_location);
-        _data->_workload        = workload;
-        _data->_trace           = std::make_unique<Trace>(_data->_end_id, _data->_source_location->function_name());
-
-        std::shared_ptr<Record> record_begin =
-            get_event_record(source_location, EventCategory::Profile, Event::FunctionBegin, _data->_begin_id);
-        record_begin->insert_or_assign("other_id"s, _data->_end_id.get_string());
-        record_begin->insert_or_assign("wrkld"s, workload);
-        sink::g_sink_manager.write_record(record_begin);
       }
     }
 
     ~Function() {
-      if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench) {
-        constexpr bool is_profiling = (g_build_mode == BuildMode::Prof);
-        std::shared_ptr<Record> record_end =
-            get_event_record(*(_data->_source_location), EventCategory::Profile, Event::FunctionEnd, _data->_end_id);
-
-        record_end->insert_or_assign("other_id"s, _data->_begin_id.get_string());
-        record_end->insert_or_assign("wrkld"s, _data->_workload);
-        record_end->insert_or_assign("is_leaf"s, _data->_trace->is_leaf());
-        record_end->insert({{"uuids"s, _data->_trace->get_uuids()}});
-        record_end->insert({{"funcs"s, _data->_trace->get_function_names()}});
-
-        if constexpr (is_profiling) {
-          record_end->insert({{"prof_tot"s, _data->_profile->get_total_counters_record()}});
-          record_end->insert({{"prof_self"s,  _data->_profile->get_self_counters_record()}});
-        }
-
-        sink::g_sink_manager.write_record(record_end);
+      if constexpr (_is_enabled) {
+        if (_data)               end(_data.release());
+        if (_is_sampling_root)   g_thread_control._sampling = ThreadControlBlock::Sampling::Undecided;
       }
     }
 
  private:
+  static constexpr bool _is_enabled =
+      (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench);
   static inline volatile const Thread* _thread{Thread::get_thread()};   // force compiler to retain code for g_thread
 
+  /// benchmarks exclude the warm-up phases
+  static bool is_warmup_skipped() {
+    if constexpr (g_build_mode == BuildMode::Bench) {
+      return prod::Phase::is_warmup();
+    } else {
+      return false;
+    }
+  }
+
   struct FunctionData {
       std::unique_ptr<giopler::source_location> _source_location;
       UUID _begin_id;
       UUID _end_id;
       double _workload{};
+      bool _is_live{};   // sent, or kept in the flight recorder (see CaptureTrigger)
+      bool _is_written{};   // false for the functions summarized by a span
+      Span* _span{};
       std::unique_ptr<Trace> _trace;
       std::unique_ptr<Profile> _profile;
   };
 
+  /// start tracing and profiling the function, and write the FunctionBegin event
+  // kept out of line, so the instrumented function only has the calls to begin and end
+  // raw pointers are passed in and out, so the address of _data does not escape,
+  // and the compiler can see that the unique_ptr destructor has nothing left to do
+  GIOPLER_OUTLINE static FunctionData* begin(double workload, const giopler::source_location& source_location);
+
+  /// write the FunctionEnd event, then stop tracing and profiling the function
+  // takes ownership of the data
+  GIOPLER_OUTLINE static void end(FunctionData* data);
+
   // use a data object to help minimize impact when not enabled
-  std::unique_ptr<FunctionData> _data;
+  std::unique_ptr<FunctionData> _data;   // nullptr=not enabled, or not sampled
+  bool _is_sampling_root = false;
 };
 
+// -----------------------------------------------------------------------------
+/// add to a user-defined counter of the innermost profiled function (Prof) or thread (Prof, Bench)
+// the counter is reported as "usr_<name>" in prof_tot and prof_self, and rolls up to the
+// calling functions like the hardware counters; counters are expected to only increase
+// giopler::dev::count(rows_id, rows.size());
+inline void count([[maybe_unused]] const CounterId id, [[maybe_unused]] const std::int64_t delta = 1)
+{
+  if constexpr (g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench) {
+    Profile* const profile = g_thread_control._profile_object;
+    if (profile && id.is_valid())   profile->add_user_counter(id, delta);
+  }
+}
+
+// -----------------------------------------------------------------------------
+/// add to a user-defined counter, looking it up by name
+// giopler::dev::count("bytes_parsed", buffer.size());
+inline void count([[maybe_unused]] const std::string_view name, [[maybe_unused]] const std::int64_t delta = 1)
+{
+  if constexpr (g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench) {
+    if (g_thread_control._profile_object)   count(get_counter_id(name), delta);
+  }
+}
+
 // -----------------------------------------------------------------------------
 /// track the lifetime of an object
 // report stack trace on entry and profile on exit
@@ -348,35 +561,32 @@ class Function final
 class Object final
 {
  public:
-    explicit Object([[maybe_unused]] giopler::source_location source_location = giopler::source_location::current())
-    {
-      if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Prof) {
-        _data = std::make_unique<ObjectData>();
-        _data->_source_location = std::make_unique<giopler::source_location>(source_location);
-
-        std::shared_ptr<Record> record_begin =
-            get_event_record(source_location, EventCategory::Profile, Event::ObjectBegin, _data->_begin_id);
-        record_begin->insert_or_assign("other_id"s, _data->_end_id.get_string());
-        sink::g_sink_manager.write_record(record_begin);
-      }
-    }
+    explicit Object([[maybe_unused]] const giopler::source_location& source_location = giopler::source_location::current())
+    : _data{_is_enabled ? begin(source_location) : nullptr}
+    { }
 
     ~Object() {
-      if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Prof) {
-        std::shared_ptr<Record> record_end =
-            get_event_record(*(_data->_source_location), EventCategory::Profile, Event::ObjectEnd, _data->_end_id);
-        record_end->insert_or_assign("other_id"s, _data->_begin_id.get_string());
-        sink::g_sink_manager.write_record(record_end);
+      if constexpr (_is_enabled) {
+        end(_data.release());
       }
     }
 
  private:
+  static constexpr bool _is_enabled = (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Prof);
+
   struct ObjectData {
       std::unique_ptr<giopler::source_location> _source_location;
       UUID _begin_id;
       UUID _end_id;
   };
 
+  /// write the ObjectBegin event
+  GIOPLER_OUTLINE static ObjectData* begin(const giopler::source_location& source_location);
+
+  /// write the ObjectEnd event
+  // takes ownership of the data
+  GIOPLER_OUTLINE static void end(ObjectData* data);
+
   // use a data object to help minimize impact when not enabled
   std::unique_ptr<ObjectData> _data;
 };
@@ -384,5 +594,173 @@ class Object final
 // -----------------------------------------------------------------------------
 }   // namespace giopler::dev
 
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void ThreadClasses::add_thread(ThreadClass& thread_class, const double duration, const Record& counters)
+{
+  std::shared_ptr<Record> record_summary;
+  {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    thread_class._threads++;
+    thread_class._duration     += duration;
+    thread_class._duration_max  = std::max(thread_class._duration_max, duration);
+    add_number_record(thread_class._counters, counters);
+    if (thread_class._threads >= _summary_threads)   record_summary = get_summary_record(thread_class);
+  }
+  if (record_summary)   sink::g_sink_manager.write_record(record_summary);
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void ThreadClasses::write_summaries()
+{
+  std::vector<std::shared_ptr<Record>> records_summary;
+  {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    for (ThreadClass& thread_class : _classes) {
+      if (thread_class._threads)   records_summary.push_back(get_summary_record(thread_class));
+    }
+  }
+  for (const std::shared_ptr<Record>& record_summary : records_summary) {
+    sink::g_sink_manager.write_record(record_summary);
+  }
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+std::shared_ptr<Record> ThreadClasses::get_summary_record(ThreadClass& thread_class)
+{
+  std::shared_ptr<Record> record_summary =
+      get_event_record(thread_class._source_location, EventCategory::Profile, Event::ThreadSummary, UUID());
+  record_summary->insert_or_assign("msg"s, std::string_view{thread_class._name});
+  record_summary->insert({
+      {"threads"s,    thread_class._threads},
+      {"dur"s,        thread_class._duration},
+      {"dur_avg"s,    thread_class._duration / static_cast<double>(thread_class._threads)},
+      {"dur_max"s,    thread_class._duration_max},
+      {"prof_tot"s,   make_arena_shared<Record>(thread_class._counters)}
+  });
+
+  thread_class._threads      = 0;
+  thread_class._duration     = 0;
+  thread_class._duration_max = 0;
+  thread_class._counters     = Record{};
+  return record_summary;
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+Function::FunctionData* Function::begin(const double workload, const giopler::source_location& source_location)
+{
+  if (g_thread_control._state == ThreadControlBlock::State::NotStarted) [[unlikely]]   Thread::start();
+  if constexpr (g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench) {
+    g_thread_phases.check();
+  }
+  std::unique_ptr<FunctionData> data = std::make_unique<FunctionData>();
+  constexpr bool is_profiling = (g_build_mode == BuildMode::Prof);
+
+  if constexpr (is_profiling) {
+    data->_profile = std::make_unique<Profile>();
+  }
+
+  data->_source_location = std::make_unique<giopler::source_location>(source_location);
+  data->_workload        = workload;
+  data->_is_live         = g_capture_trigger.is_live();
+  data->_trace           = std::make_unique<Trace>(data->_end_id, data->_source_location->function_name());
+  data->_span            = g_thread_control._span;
+  data->_is_written      = !data->_span || (g_span_classes.is_function_events() &&
+                                            g_thread_control._sampling == ThreadControlBlock::Sampling::Keep);
+  if (!data->_is_written)   return data.release();
+
+  std::shared_ptr<Record> record_begin =
+      get_event_record(source_location, EventCategory::Profile, Event::FunctionBegin, data->_begin_id);
+  record_begin->insert_or_assign("other_id"s, data->_end_id.get_string());
+  record_begin->insert_or_assign("wrkld"s, workload);
+  g_capture_trigger.write_record(record_begin, data->_is_live);
+  return data.release();
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void Function::end(FunctionData* const data)
+{
+  const std::unique_ptr<FunctionData> data_owner{data};
+  if constexpr (g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench) {
+    g_thread_phases.check();
+  }
+  constexpr bool is_profiling = (g_build_mode == BuildMode::Prof);
+  if constexpr (is_profiling) {
+    if (data->_span)   data->_span->add_site(*(data->_source_location), *(data->_profile->get_self_counters_record()));
+  }
+  if (!data->_is_written)   return;
+
+  std::shared_ptr<Record> record_end =
+      get_event_record(*(data->_source_location), EventCategory::Profile, Event::FunctionEnd, data->_end_id);
+
+  record_end->insert_or_assign("other_id"s, data->_begin_id.get_string());
+  record_end->insert_or_assign("wrkld"s, data->_workload);
+  record_end->insert_or_assign("is_leaf"s, data->_trace->is_leaf());
+  record_end->insert({{"uuids"s, data->_trace->get_uuids()}});
+  record_end->insert({{"funcs"s, data->_trace->get_function_names()}});
+
+  if constexpr (is_profiling) {
+    record_end->insert({{"prof_tot"s, data->_profile->get_total_counters_record()}});
+    record_end->insert({{"prof_self"s,  data->_profile->get_self_counters_record()}});
+  }
+
+  g_capture_trigger.write_record(record_end, data->_is_live);
+}
+
+// -----------------------------------------------------------------------------
+/// start a span for a prod::Id scope; the caller owns the span until end_span
+GIOPLER_CORE_INLINE
+Span* begin_span(const std::string_view id, const giopler::source_location& source_location)
+{
+  if (g_thread_control._state == ThreadControlBlock::State::NotStarted) [[unlikely]]   Thread::start();
+  return std::make_unique<Span>(id, source_location).release();
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void end_span(Span* const span)
+{
+  const std::unique_ptr<Span> span_owner{span};
+  span->end();
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+Object::ObjectData* Object::begin(const giopler::source_location& source_location)
+{
+  std::unique_ptr<ObjectData> data = std::make_unique<ObjectData>();
+  data->_source_location = std::make_unique<giopler::source_location>(source_location);
+
+  std::shared_ptr<Record> record_begin =
+      get_event_record(source_location, EventCategory::Profile, Event::ObjectBegin, data->_begin_id);
+  record_begin->insert_or_assign("other_id"s, data->_end_id.get_string());
+  sink::g_sink_manager.write_record(record_begin);
+  return data.release();
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void Object::end(ObjectData* const data)
+{
+  const std::unique_ptr<ObjectData> data_owner{data};
+  std::shared_ptr<Record> record_end =
+      get_event_record(*(data->_source_location), EventCategory::Profile, Event::ObjectEnd, data->_end_id);
+  record_end->insert_or_assign("other_id"s, data->_begin_id.get_string());
+  sink::g_sink_manager.write_record(record_end);
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+#endif // GIOPLER_CORE_DEFINITIONS
+
 // -----------------------------------------------------------------------------
 #endif // defined GIOPLER_PROFILE_HPP
@@ -17,6 +17,7 @@
 #endif
 
 #include <cassert>
+#include <charconv>
 #include <chrono>
 #include <filesystem>
 #include <fstream>
@@ -33,6 +34,8 @@ using namespace std::literals;
 #include "giopler/config.hpp"
 #include "giopler/utility.hpp"
 #include "giopler/platform.hpp"
+#include "giopler/arena.hpp"
+#include "giopler/json_escape.hpp"
 
 // -----------------------------------------------------------------------------
 namespace giopler {
@@ -84,7 +87,17 @@ enum class Event {
                   FunctionBegin,
                   FunctionEnd,
                   ObjectBegin,
-                  ObjectEnd
+                  ObjectEnd,
+                  Memory,
+                  ParallelRegion,
+                  Watchdog,
+                  PhaseBegin,
+                  PhaseEnd,
+                  Trigger,
+                  ThreadSummary,
+                  Span,
+                  SpanSummary,
+                  AllocationSummary
 };
 
 // -----------------------------------------------------------------------------
@@ -114,6 +127,16 @@ constexpr std::string_view get_event_name(const Event event) {
     case Event::FunctionEnd:    return "FunctionEnd"sv;
     case Event::ObjectBegin:    return "ObjectBegin"sv;
     case Event::ObjectEnd:      return "ObjectEnd"sv;
+    case Event::Memory:         return "Memory"sv;
+    case Event::ParallelRegion: return "ParallelRegion"sv;
+    case Event::Watchdog:       return "Watchdog"sv;
+    case Event::PhaseBegin:     return "PhaseBegin"sv;
+    case Event::PhaseEnd:       return "PhaseEnd"sv;
+    case Event::Trigger:        return "Trigger"sv;
+    case Event::ThreadSummary:  return "ThreadSummary"sv;
+    case Event::Span:           return "Span"sv;
+    case Event::SpanSummary:    return "SpanSummary"sv;
+    case Event::AllocationSummary: return "AllocationSummary"sv;
   }
   return "Unknown"sv;
 }
@@ -143,9 +166,11 @@ class RecordValue;
 // -----------------------------------------------------------------------------
 /// Data being sent to a sink for processing.
 // Important: Record objects should NOT be modified after they are shared.
-using Record          = std::unordered_map<std::string, RecordValue>;
+// The memory is allocated from the record arena of the thread that creates them.
+using Record          = std::unordered_map<std::string, RecordValue, std::hash<std::string>, std::equal_to<std::string>,
+                                           ArenaAllocator<std::pair<const std::string, RecordValue>>>;
 using RecordInitList  = std::initializer_list<Record::value_type>;
-using Array           = std::vector<RecordValue>;
+using Array           = std::vector<RecordValue, ArenaAllocator<RecordValue>>;
 
 // -----------------------------------------------------------------------------
 /// replacement for std::variant; eventually might become a wrapper
@@ -248,13 +273,18 @@ class RecordValue
   RecordValue(std::string_view string_value)   // NOLINT(google-explicit-constructor)
   : _record_value_type(Type::String), _string_value(string_value) { }
 
-  RecordValue(std::string string_value)   // NOLINT(google-explicit-constructor)
-  : _record_value_type(Type::String), _string_value(std::move(string_value)) { }
+  RecordValue(const std::string& string_value)   // NOLINT(google-explicit-constructor)
+  : _record_value_type(Type::String), _string_value(string_value.data(), string_value.size()) { }
 
   RecordValue(const char* string_value)   // NOLINT(google-explicit-constructor)
   : _record_value_type(Type::String), _string_value(string_value) { }
 
   [[nodiscard]] std::string get_string() const {
+    assert(_record_value_type == Type::String);
+    return std::string(_string_value.data(), _string_value.size());
+  }
+
+  [[nodiscard]] std::string_view get_string_view() const {
     assert(_record_value_type == Type::String);
     return _string_value;
   }
@@ -313,196 +343,123 @@ class RecordValue
   bool _boolean_value{};
   int64_t _integer_value{};
   double _real_value{};
-  std::string _string_value{};
+  ArenaString _string_value{};
   TimestampSystem _timestamp_value{};
   std::shared_ptr<giopler::Record> _record_value;
   std::shared_ptr<giopler::Array>  _array_value;
 };
 
 // -----------------------------------------------------------------------------
-void record_value_to_json(const RecordValue& value, std::stringstream& buffer)
+/// append the number to the buffer in its shortest form
+// same output as gformat("{}", number), but without allocating a temporary string
+template<typename T>
+void number_to_json(const T number, std::string& buffer)
 {
-    switch (value.get_type()) {
-      case RecordValue::Type::Boolean: {
-        buffer << gformat("{}", value.get_boolean());
-        break;
-      }
-
-      case RecordValue::Type::Integer: {
-        buffer << gformat("{}", value.get_integer());
-        break;
-      }
-
-      case RecordValue::Type::Real: {
-        buffer << gformat("{}", value.get_real());
-        break;
-      }
-
-      case RecordValue::Type::String: {
-        buffer << gformat("\"{}\"", value.get_string());
-        break;
-      }
-
-      case RecordValue::Type::Timestamp: {
-        buffer << gformat("\"{}\"", format_timestamp(value.get_timestamp()));
-        break;
-      }
-
-      case RecordValue::Type::Record: {
-        buffer.put('{');
-        bool first_field = true;
-
-        for (const auto& [rec_field, rec_value] : *(value.get_record())) {
-          if (first_field) {
-            first_field = false;
-          } else {
-            buffer.put(',');
-          }
-
-          buffer << gformat("\"{}\":", rec_field);
-          record_value_to_json(rec_value, buffer);
-        }
-
-        buffer << "}\n";
-        break;
-      }
-
-      case RecordValue::Type::Array: {
-        buffer.put('[');
-        bool first_field = true;
-
-        for (const auto& array_value : *(value.get_array())) {
-          if (first_field) {
-            first_field = false;
-          } else {
-            buffer.put(',');
-          }
-
-          record_value_to_json(array_value, buffer);
-        }
-
-        buffer << "]\n";
-        break;
-      }
-
-      case RecordValue::Type::Empty: {
-        buffer << "null";
-        break;
-      }
-    }
+  char digits[32];
+  const std::to_chars_result result = std::to_chars(std::begin(digits), std::end(digits), number);
+  assert(result.ec == std::errc{});
+  buffer.append(digits, result.ptr);
 }
 
+// -----------------------------------------------------------------------------
+/// append the JSON representation of the value to the buffer
+// the buffer is reused by the sink, so this avoids allocating intermediate strings
+void record_value_to_json(const RecordValue& value, std::string& buffer);
+
 // -----------------------------------------------------------------------------
 /// convert the record value to a string
 // does not support nested Array or Record values
-std::string record_value_to_string(const RecordValue& value) {
-  switch (value.get_type()) {
-    case RecordValue::Type::Boolean: {
-      return gformat("\"{}\"", value.get_boolean());
-    }
-
-    case RecordValue::Type::Integer: {
-      return gformat("\"{}\"", value.get_integer());
-    }
-
-    case RecordValue::Type::Real: {
-      return gformat("\"{}\"", value.get_real());
-    }
-
-    case RecordValue::Type::String: {
-      return gformat("\"{}\"", value.get_string());
-    }
-
-    case RecordValue::Type::Timestamp: {   // not sure if this is needed
-      return gformat("\"{}\"", format_timestamp(value.get_timestamp()));
-    }
-
-    case RecordValue::Type::Record: {
-      assert(false);
-    }
-
-    case RecordValue::Type::Array: {
-      assert(false);
-    }
-
-    case RecordValue::Type::Empty: {
-      return "\"null\"";
-    }
-
-    default: {
-      assert(false);
-      return ""s;
-    }
-  }
-}
+std::string record_value_to_string(const RecordValue& value);
 
 // -----------------------------------------------------------------------------
-/// convert a Record to a JSON string
-std::string record_to_json(std::shared_ptr<Record> record)
-{
-    std::stringstream buffer;
-    record_value_to_json(RecordValue(record), buffer);
-    return buffer.str();
-}
+/// append a Record to the buffer as a JSON object
+void record_to_json(const std::shared_ptr<Record>& record, std::string& buffer);
 
 // -----------------------------------------------------------------------------
 /// returns the unique UUID for the program run
-UUID get_run_id() {
-  static const UUID run_id{UUID{}};
-  return run_id;
-}
+UUID get_run_id();
 
 // -----------------------------------------------------------------------------
 /// returns a value that increments once per call per thread
 // useful as a fine-grained sequencing value for events within a thread
 // timestamp values do not always have enough accuracy
-int64_t get_thread_sequence() {
-  static thread_local int64_t sequence = 0;
-  return sequence++;
+inline int64_t get_thread_sequence() {
+  return g_thread_control._sequence++;
 }
 
 // -----------------------------------------------------------------------------
 }   // namespace giopler
 
 
+// -----------------------------------------------------------------------------
+namespace giopler::dev {
+bool is_sampled_id(std::string_view id);   // see sampling.hpp
+double get_sample_rate();                  // see sampling.hpp
+class Span;
+Span* begin_span(std::string_view id, const giopler::source_location& source_location);   // see profile.hpp
+void end_span(Span* span);                                                                 // see profile.hpp
+}   // namespace giopler::dev
+
 // -----------------------------------------------------------------------------
 namespace giopler::prod {
 
+// -----------------------------------------------------------------------------
+/// what an Id scope does besides setting the id value
+// Span: in Prof mode, the profiled functions called in the scope are summarized by call site
+// in one Span event, instead of sending their own events, and the spans are totaled per class
+// in SpanSummary events (see dev::SpanClasses); in the other modes it is the same as Tag
+enum class IdScope {Tag, Span};
+
 // -----------------------------------------------------------------------------
 /// set a thread-local id value
 // assign a unique value to it
 // examples: "cust.12345", "frame.3232"
 // inspired by the HTML 'id' attribute
+// the outermost Id of a call tree makes the sampling decision for the whole tree (see Sampler)
+// giopler::prod::Id request_id{gformat("req.{}", request_number), giopler::prod::IdScope::Span};
 class Id final
 {
  public:
-  explicit Id(std::string_view id_value) {
+  explicit Id(std::string_view id_value, [[maybe_unused]] const IdScope id_scope = IdScope::Tag,
+              [[maybe_unused]] const giopler::source_location& source_location = giopler::source_location::current()) {
     if constexpr (g_build_mode == BuildMode::Dev  || g_build_mode == BuildMode::Test ||
                   g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Prod) {
+      ThreadControlBlock& thread_control = g_thread_control;
       _data = std::make_unique<ObjectData>();
-      _data->_parent_id = _current_id;
-      _data->_id_value  = id_value;
-      _current_id       = this;
+      _data->_parent_id               = thread_control._current_id;
+      _data->_id_value                = id_value;
+      _data->_is_sampling_root        = (thread_control._sampling == ThreadControlBlock::Sampling::Undecided);
+      thread_control._current_id      = this;
+      if (_data->_is_sampling_root) {
+        thread_control._sampling = dev::is_sampled_id(id_value) ?
+            ThreadControlBlock::Sampling::Keep : ThreadControlBlock::Sampling::Drop;
+      }
+      if constexpr (g_build_mode == BuildMode::Prof) {
+        if (id_scope == IdScope::Span)   _data->_span = dev::begin_span(id_value, source_location);
+      }
     }
   }
 
   ~Id() {
     if constexpr (g_build_mode == BuildMode::Dev  || g_build_mode == BuildMode::Test ||
                   g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Prod) {
-      _current_id = _data->_parent_id;
+      if (_data->_span)   dev::end_span(_data->_span);   // while the id and sampling decision still apply
+      g_thread_control._current_id = _data->_parent_id;
+      if (_data->_is_sampling_root)   g_thread_control._sampling = ThreadControlBlock::Sampling::Undecided;
     }
   }
 
   static std::string get_id() {
-    return _current_id ? _current_id->_data->_id_value : "";
+    const Id* current_id = g_thread_control._current_id;
+    return current_id ? current_id->_data->_id_value : "";
   }
 
  private:
-  static inline thread_local Id* _current_id = nullptr;
-
   struct ObjectData {
     Id* _parent_id;
     std::string _id_value;
+    bool _is_sampling_root;
+    dev::Span* _span = nullptr;   // owned, see dev::begin_span
   };
 
   // use a data object to help minimize impact when not enabled
@@ -521,26 +478,25 @@ class Class final
     if constexpr (g_build_mode == BuildMode::Dev  || g_build_mode == BuildMode::Test ||
                   g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Prod) {
       _data = std::make_unique<ObjectData>();
-      _data->_parent_class  = _current_class;
-      _data->_class_value   = class_value;
-      _current_class        = this;
+      _data->_parent_class            = g_thread_control._current_class;
+      _data->_class_value             = class_value;
+      g_thread_control._current_class = this;
     }
   }
 
   ~Class() {
     if constexpr (g_build_mode == BuildMode::Dev  || g_build_mode == BuildMode::Test ||
                   g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Prod) {
-      _current_class = _data->_parent_class;
+      g_thread_control._current_class = _data->_parent_class;
     }
   }
 
   static std::string get_class() {
-    return _current_class ? _current_class->_data->_class_value : "";
+    const Class* current_class = g_thread_control._current_class;
+    return current_class ? current_class->_data->_class_value : "";
   }
 
  private:
-  static inline thread_local Class* _current_class = nullptr;
-
   struct ObjectData {
     Class* _parent_class;
     std::string _class_value;
@@ -562,10 +518,10 @@ class Attributes final
 {
 public:
   explicit Attributes(const RecordInitList& attribute_init)
-  : _parent_attributes{_attributes},
-    _data{_attributes ? _attributes->_data : std::make_shared<Record>()}
+  : _parent_attributes{g_thread_control._attributes},
+    _data{_parent_attributes ? make_arena_shared<Record>(*_parent_attributes->_data) : make_arena_shared<Record>()}
   {
-    _attributes = this;
+    g_thread_control._attributes = this;
 
     for (const auto& [key, value] : attribute_init) {
       (*_data)[key] = record_value_to_string(value);
@@ -573,15 +529,15 @@ public:
   }
 
   ~Attributes() {
-    _attributes = _parent_attributes;
+    g_thread_control._attributes = _parent_attributes;
   }
 
   static std::shared_ptr<giopler::Record> get_attributes_record() {
-    return _attributes ? _attributes->_data : std::make_shared<Record>();
+    const Attributes* attributes = g_thread_control._attributes;
+    return attributes ? attributes->_data : make_arena_shared<Record>();
   }
 
 private:
-  static inline thread_local Attributes* _attributes = nullptr;
   Attributes* _parent_attributes;
   std::shared_ptr<giopler::Record> _data;
 };
@@ -594,9 +550,167 @@ namespace giopler {
 
 // -----------------------------------------------------------------------------
 /// read program-wide variables
-// these values are constant per program run
-std::shared_ptr<Record> get_program_record() {
-  return std::make_shared<Record>(Record{
+// these values are constant per program run, so they are only collected once
+std::shared_ptr<Record> get_program_record();
+
+// -----------------------------------------------------------------------------
+namespace dev {
+std::string_view get_counter_set();   // see counter.hpp
+}   // namespace dev
+
+// -----------------------------------------------------------------------------
+/// create an event record with the fields shared by every event
+// the event generator adds or replaces the optional fields
+// the buckets are allocated once, with room for the fields the events add (up to about 20),
+// so the records are not rehashed while they are filled in
+std::shared_ptr<Record> get_event_record(const source_location& source_location,
+                                         const EventCategory event_category,
+                                         const Event event,
+                                         const UUID& event_id);
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+namespace giopler {
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE void record_value_to_json(const RecordValue& value, std::string& buffer)
+{
+    switch (value.get_type()) {
+      case RecordValue::Type::Boolean: {
+        buffer.append(value.get_boolean() ? "true"sv : "false"sv);
+        break;
+      }
+
+      case RecordValue::Type::Integer: {
+        number_to_json(value.get_integer(), buffer);
+        break;
+      }
+
+      case RecordValue::Type::Real: {
+        number_to_json(value.get_real(), buffer);
+        break;
+      }
+
+      case RecordValue::Type::String: {
+        append_json_string(buffer, value.get_string_view());
+        break;
+      }
+
+      case RecordValue::Type::Timestamp: {
+        buffer.push_back('"');
+        buffer.append(format_timestamp(value.get_timestamp()));
+        buffer.push_back('"');
+        break;
+      }
+
+      case RecordValue::Type::Record: {
+        buffer.push_back('{');
+        bool first_field = true;
+
+        for (const auto& [rec_field, rec_value] : *(value.get_record())) {
+          if (first_field) {
+            first_field = false;
+          } else {
+            buffer.push_back(',');
+          }
+
+          append_json_string(buffer, rec_field);
+          buffer.push_back(':');
+          record_value_to_json(rec_value, buffer);
+        }
+
+        buffer.append("}\n"sv);
+        break;
+      }
+
+      case RecordValue::Type::Array: {
+        buffer.push_back('[');
+        bool first_field = true;
+
+        for (const auto& array_value : *(value.get_array())) {
+          if (first_field) {
+            first_field = false;
+          } else {
+            buffer.push_back(',');
+          }
+
+          record_value_to_json(array_value, buffer);
+        }
+
+        buffer.append("]\n"sv);
+        break;
+      }
+
+      case RecordValue::Type::Empty: {
+        buffer.append("null"sv);
+        break;
+      }
+    }
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE std::string record_value_to_string(const RecordValue& value) {
+  switch (value.get_type()) {
+    case RecordValue::Type::Boolean: {
+      return gformat("\"{}\"", value.get_boolean());
+    }
+
+    case RecordValue::Type::Integer: {
+      return gformat("\"{}\"", value.get_integer());
+    }
+
+    case RecordValue::Type::Real: {
+      return gformat("\"{}\"", value.get_real());
+    }
+
+    case RecordValue::Type::String: {
+      std::string json;
+      append_json_string(json, value.get_string_view());
+      return json;
+    }
+
+    case RecordValue::Type::Timestamp: {   // not sure if this is needed
+      return gformat("\"{}\"", format_timestamp(value.get_timestamp()));
+    }
+
+    case RecordValue::Type::Record: {
+      assert(false);
+    }
+
+    case RecordValue::Type::Array: {
+      assert(false);
+    }
+
+    case RecordValue::Type::Empty: {
+      return "\"null\"";
+    }
+
+    default: {
+      assert(false);
+      return ""s;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE void record_to_json(const std::shared_ptr<Record>& record, std::string& buffer)
+{
+    record_value_to_json(RecordValue(record), buffer);
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE UUID get_run_id() {
+  static const UUID run_id{UUID{}};
+  return run_id;
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE std::shared_ptr<Record> get_program_record() {
+  static const std::shared_ptr<Record> program_record = make_arena_shared<Record>(Record{
       {"start"s,            start_system_time},
       {"pgm"s,              get_program_name()},
       {"build"s,            get_build_mode_name()},
@@ -612,17 +726,22 @@ std::shared_ptr<Record> get_program_record() {
       {"phys_mem"s,         get_physical_memory()},
       {"conf_cpu"s,         get_conf_cpu_cores()},
       {"avail_cpu"s,        get_available_cpu_cores()},
-      {"proc_id"s,          get_process_id()}
+      {"proc_id"s,          get_process_id()},
+      {"counters"s,         dev::get_counter_set()},  // which counters the profile records have
+      {"sample_rate"s,      dev::get_sample_rate()}   // fraction of the call trees sent
   });
+  return program_record;
 }
 
 // -----------------------------------------------------------------------------
-std::shared_ptr<Record> get_event_record(const source_location& source_location,
-                                         const EventCategory event_category,
-                                         const Event event,
-                                         const UUID& event_id)
+GIOPLER_CORE_INLINE std::shared_ptr<Record> get_event_record(const source_location& source_location,
+                                                             const EventCategory event_category,
+                                                             const Event event,
+                                                             const UUID& event_id)
 {
-  return std::make_shared<Record>(Record{
+  const PhaseInfo* const phase = g_current_phase.load(std::memory_order_acquire);
+  constexpr std::size_t event_record_buckets = 48;
+  std::shared_ptr<Record> record = make_arena_shared<Record>(RecordInitList{
       {"run_id"s,             get_run_id().get_string()},
       {"event_id"s,           event_id.get_string()},
 
@@ -649,6 +768,7 @@ std::shared_ptr<Record> get_event_record(const source_location& source_location,
 
       {"clss"s,               giopler::prod::Class::get_class()},
       {"id"s,                 giopler::prod::Id::get_id()},
+      {"phase"s,              phase ? std::string_view{phase->_name} : ""sv},
 
       // These are all optional. They are set by the event generator if needed using insert_or_assign().
       {"other_id"s,           UUID::get_nil().get_string()},
@@ -656,11 +776,16 @@ std::shared_ptr<Record> get_event_record(const source_location& source_location,
       {"wrkld"s,              0},
       {"is_leaf"s,            false},
       {"status"s,             "Skipped"}
-  });
+  }, event_record_buckets);
+
+  // only present inside a warm-up phase, so aggregations can exclude these events
+  if (phase && phase->_is_warmup)   record->insert({{"warmup"s, true}});
+  return record;
 }
 
 // -----------------------------------------------------------------------------
 }   // namespace giopler
+#endif // GIOPLER_CORE_DEFINITIONS
 
 // -----------------------------------------------------------------------------
 /// hash function for RecordValue
@@ -674,7 +799,7 @@ struct std::hash<giopler::RecordValue> {
       record_value._boolean_value,
       record_value._integer_value,
       record_value._real_value,
-      record_value._string_value,
+      std::string_view(record_value._string_value),
       record_value._timestamp_value,
       record_value._record_value,
       record_value._array_value);
@@ -0,0 +1,236 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_SAMPLING_HPP
+#define GIOPLER_SAMPLING_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "giopler/config.hpp"
+#include "giopler/control.hpp"
+#include "giopler/record.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+/// stable 64-bit hash of an id, the same in every process and platform
+// FNV-1a, followed by the splitmix64 finalizer to spread the bits
+constexpr std::uint64_t get_sampling_hash(const std::string_view id) {
+  std::uint64_t hash = 0xcbf2'9ce4'8422'2325ULL;
+  for (const char c : id) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x0000'0100'0000'01b3ULL;
+  }
+  hash ^= hash >> 30;   hash *= 0xbf58'476d'1ce4'e5b9ULL;
+  hash ^= hash >> 27;   hash *= 0x94d0'49bb'1331'11ebULL;
+  hash ^= hash >> 31;
+  return hash;
+}
+
+// -----------------------------------------------------------------------------
+/// head-based sampling of whole call trees
+// this is a private class for library internal use only
+// the decision is made once, at the root of a call tree: the outermost prod::Id scope
+// or the outermost Function of the thread, and is kept in ThreadControlBlock::_sampling
+// every nested Function, Id, ParallelRegion, and trace event inherits it, so a call tree
+// is either complete or not sent at all; log messages and contract events are always sent
+// a root Id is kept if the hash of its value is below the sample rate, so the same id is
+// kept or dropped in every thread and process that use the same rate;
+// this is how the decision is propagated to the work done for a request elsewhere
+// a root Function without an Id is kept at random, with the same probability
+// the keep rules always keep the call trees with a given id, or a given attribute value
+// GIOPLER_SAMPLE_RATE is the fraction of call trees to keep (default 1, everything)
+// GIOPLER_SAMPLE_KEEP is a list of rules: "id=cust.12345,id=debug.*,tenant=acme"
+class Sampler final
+{
+ public:
+  explicit Sampler() {
+    const char* rate = std::getenv("GIOPLER_SAMPLE_RATE");
+    if (rate)   set_rate(std::atof(rate));
+
+    const char* rules = std::getenv("GIOPLER_SAMPLE_KEEP");
+    std::string_view rules_view{rules ? rules : ""};
+    while (!rules_view.empty()) {
+      const std::size_t end    = std::min(rules_view.find(','), rules_view.size());
+      const std::string_view rule = rules_view.substr(0, end);
+      const std::size_t equals = rule.find('=');
+      if (equals != std::string_view::npos && equals > 0) {
+        add_rule(rule.substr(0, equals), rule.substr(equals+1));
+      }
+      rules_view.remove_prefix(std::min(end+1, rules_view.size()));
+    }
+  }
+
+  /// fraction of the call trees to keep, from 0 to 1
+  void set_rate(const double rate) {
+    _rate.store(rate, std::memory_order_relaxed);
+    _threshold.store(rate >= 1 ? UINT64_MAX :
+                     rate <= 0 ? 0 : static_cast<std::uint64_t>(rate * 18'446'744'073'709'551'616.0),
+                     std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] double get_rate() const {
+    return _rate.load(std::memory_order_relaxed);
+  }
+
+  /// always keep the call trees with this id (key "id") or attribute value
+  // a value ending with '*' matches any value starting with the text before it
+  void add_rule(const std::string_view key, const std::string_view value) {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    const bool is_prefix = value.ends_with('*');
+    _rules.push_back(Rule{std::string{key}, std::string{is_prefix ? value.substr(0, value.size()-1) : value}, is_prefix});
+    _has_rules.store(true, std::memory_order_release);
+  }
+
+  /// decide whether to keep the call tree of a root Id
+  GIOPLER_OUTLINE bool is_kept(std::string_view id);
+
+  /// decide whether to keep the call tree of a root Function, outside any Id
+  GIOPLER_OUTLINE bool is_kept();
+
+ private:
+  struct Rule {
+    std::string _key;
+    std::string _value;
+    bool _is_prefix;
+
+    [[nodiscard]] bool matches(const std::string_view value) const {
+      return _is_prefix ? value.starts_with(_value) : value == _value;
+    }
+  };
+
+  std::atomic<double> _rate{1};
+  std::atomic<std::uint64_t> _threshold{UINT64_MAX};   // keep hashes below this; UINT64_MAX=all
+  std::atomic<std::uint64_t> _random_state{static_cast<std::uint64_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count())};
+  std::atomic<bool> _has_rules{false};
+  std::mutex _mutex;   // protects the rules
+  std::vector<Rule> _rules;
+
+  /// true if a keep rule matches the id, or the attributes of the thread
+  GIOPLER_COLD bool is_rule_match(const std::string_view* id);
+};
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY the single instance is in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+GIOPLER_CORE_INLINE Sampler g_sampler;
+#else
+extern Sampler g_sampler;
+#endif
+
+// -----------------------------------------------------------------------------
+/// keep this fraction (0-1) of the call trees, decided at the root of each tree
+inline void set_sample_rate([[maybe_unused]] const double rate) {
+  if constexpr (g_build_mode != BuildMode::Off) {
+    g_sampler.set_rate(rate);
+  }
+}
+
+// -----------------------------------------------------------------------------
+/// always keep the call trees with this id (key "id") or attribute value
+// giopler::dev::always_sample("id", "cust.12345");
+// giopler::dev::always_sample("tenant", "acme");
+inline void always_sample([[maybe_unused]] const std::string_view key, [[maybe_unused]] const std::string_view value) {
+  if constexpr (g_build_mode != BuildMode::Off) {
+    g_sampler.add_rule(key, value);
+  }
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+bool Sampler::is_kept(const std::string_view id)
+{
+  const std::uint64_t threshold = _threshold.load(std::memory_order_relaxed);
+  if (threshold == UINT64_MAX)   return true;
+  if (_has_rules.load(std::memory_order_acquire) && is_rule_match(&id))   return true;
+  return get_sampling_hash(id) < threshold;
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+bool Sampler::is_kept()
+{
+  const std::uint64_t threshold = _threshold.load(std::memory_order_relaxed);
+  if (threshold == UINT64_MAX)   return true;
+  if (_has_rules.load(std::memory_order_acquire) && is_rule_match(nullptr))   return true;
+
+  // splitmix64 sequence
+  std::uint64_t random = _random_state.fetch_add(0x9e37'79b9'7f4a'7c15ULL, std::memory_order_relaxed);
+  random = (random ^ (random >> 30)) * 0xbf58'476d'1ce4'e5b9ULL;
+  random = (random ^ (random >> 27)) * 0x94d0'49bb'1331'11ebULL;
+  return (random ^ (random >> 31)) < threshold;
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+bool Sampler::is_rule_match(const std::string_view* const id)
+{
+  // attribute values are stored as JSON strings
+  const std::shared_ptr<Record> attributes = prod::Attributes::get_attributes_record();
+  const std::lock_guard<std::mutex> lock{_mutex};
+  for (const Rule& rule : _rules) {
+    if (rule._key == "id") {
+      if (id && rule.matches(*id))   return true;
+      continue;
+    }
+
+    const auto attribute = attributes->find(rule._key);
+    if (attribute != attributes->end() && attribute->second.get_type() == RecordValue::Type::String) {
+      const std::string attribute_value = attribute->second.get_string();
+      std::string_view value{attribute_value};
+      if (value.size() >= 2 && value.starts_with('"') && value.ends_with('"')) {
+        value = value.substr(1, value.size()-2);
+      }
+      if (rule.matches(value))   return true;
+    }
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE double get_sample_rate()
+{
+  return g_sampler.get_rate();
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE bool is_sampled_id(const std::string_view id)
+{
+  return g_sampler.is_kept(id);
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+#endif // GIOPLER_CORE_DEFINITIONS
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_SAMPLING_HPP
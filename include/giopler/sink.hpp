@@ -27,8 +27,10 @@
 #include <forward_list>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <ostream>
 #include <sstream>
+#include <stop_token>
 #include <string>
 #include <string_view>
 #include <thread>
@@ -40,6 +42,8 @@ using namespace std::chrono_literals;
 #include "giopler/config.hpp"
 #include "giopler/utility.hpp"
 #include "giopler/record.hpp"
+#include "giopler/file_sink.hpp"
+#include "giopler/batch.hpp"
 
 // -----------------------------------------------------------------------------
 // the C++ standard library is not guaranteed to be thread safe
@@ -69,7 +73,10 @@ class SinkManager final {
   {
     _quiet = std::getenv("GIOPLER_QUIET");   // convert pointer to boolean
 
-    if (!std::getenv("GIOPLER_TOKEN")) {
+    const char* record_path = std::getenv("GIOPLER_RECORD");
+    if (record_path) {
+      _file_sink = std::make_unique<File>(record_path);
+    } else if (!std::getenv("GIOPLER_TOKEN")) {
       throw std::runtime_error{"GIOPLER_TOKEN not defined"};
     }
 
@@ -77,60 +84,75 @@ class SinkManager final {
     ERR_print_errors_fp(stderr);
     assert(openssl_status == 1);
 
-    _processes.reserve(_process_count);
-    for (int process = 0; process < _process_count; ++process) {
-      _processes.emplace_back(_process_function);
-    }
+    _processes.reserve(_process_count);   // the process threads are started when there are events to send
   }
 
   /// Waits for all sinks to finish processing data before exiting.
   ~SinkManager() {
     {
       const std::lock_guard<std::mutex> lock{_deque_mutex};
+      _is_stopping = true;   // no more process threads are started
       const std::size_t records_count = _deque_records.size();
       if (records_count && !_quiet)
-        std::cout << gformat("Giopler: sending remaining {} event{} to Giopler system\n", records_count, (records_count > 1) ? "s" : "");
+        std::cout << gformat("Giopler: sending remaining {} event{} to {}\n",
+                             records_count, (records_count > 1) ? "s" : "", get_destination_name());
     }
 
     for (auto&& process : _processes) {
-      process.request_stop();
+      process.request_stop();   // wakes up the process thread
     }
-    _cond_var.notify_all();
     for (auto&& process : _processes) {
       process.join();
     }
     assert(_deque_records.empty());   // all process threads should have exited by now
+
+    const LatencyBuckets& latencies = _batch_controller.get_latencies();
+    if (latencies.get_count() && !_quiet)
+      std::cout << gformat("Giopler: delivered {} event{} with a latency of {:.1f} ms p50, {:.1f} ms p99 (target {:.0f} ms)\n",
+                           latencies.get_count(), (latencies.get_count() > 1) ? "s" : "",
+                           latencies.get_percentile(0.50) * 1000, latencies.get_percentile(0.99) * 1000,
+                           _batch_controller.get_latency_target() * 1000);
   }
 
   /// Write the record to the sink.
   // Sink objects run in their own thread.
-  // using default of std::launch::async|std::launch::deferred
-  // Gcc appears to try async first, which is what we want.
+  // a parked process thread is only notified for the first record of a batch, and a lingering one
+  // when the batch is full; another thread is only started when every running one is busy and
+  // the backlog is large
   static void write_record(std::shared_ptr<Record> record) {
+    const TimestampSteady now = now_steady();
+    bool is_process_idle, is_batch_full;
     {
       const std::lock_guard<std::mutex> lock{_deque_mutex};
-      _deque_records.emplace_back(record);   // shared_ptr is thread safe
+      const bool is_first = _deque_records.empty();
+      _deque_records.emplace_back(QueuedRecord{std::move(record), now});   // shared_ptr is thread safe
+      if (_idle_processes == 0 && _processes.size() < _process_count && !_is_stopping &&
+          (_processes.empty() || is_backlogged())) [[unlikely]] {
+        start_process();
+      }
+      is_process_idle = (_idle_processes > 0 && is_first && !_is_lingering);
+      is_batch_full   = (_is_lingering && _batch_controller.is_batch_full(_deque_records.size()));
     }
 
-    _cond_var.notify_one();   // will wake up one of the sleeping threads, if any
+    if (is_process_idle)       _cond_var.notify_one();   // will wake up one of the parked threads
+    else if (is_batch_full)    _cond_var.notify_all();   // the lingering thread sends the batch now
   }
 
   /// write uncommitted changes to the underlying output sequences
+  // waits until the queued events and the batches being sent are done, without lingering
   // we wait no more than thirty seconds for the events to be sent
   static void flush() {
-    std::size_t events_count;
-    int waits_count = 0;
+    std::unique_lock<std::mutex> lock{_deque_mutex};
+    ++_flush_requests;
+    _cond_var.notify_all();
+    _drained_cond_var.wait_for(lock, 30s, [] { return _deque_records.empty() && _batches_in_flight == 0; });
+    --_flush_requests;
+  }
 
-    do {
-      {
-        const std::lock_guard<std::mutex> lock{_deque_mutex};
-        events_count = _deque_records.size();
-      }
-      if (events_count) {
-        std::this_thread::sleep_for(1s);    // one second
-        waits_count++;
-      }
-    } while (events_count && waits_count < 30);   // thirty seconds
+  /// the achieved delivery latency and the current batching
+  static std::shared_ptr<Record> get_metrics() {
+    const std::lock_guard<std::mutex> lock{_deque_mutex};
+    return _batch_controller.get_metrics();
   }
 
  private:
@@ -139,69 +161,128 @@ class SinkManager final {
   // This leads to lower overall throughput, not higher.
   // Keeping max_records_size small is better for user feedback.
   // Increasing it will not result in significantly higher throughput.
-  static constexpr int _process_count = 4;                                // processes to send events to the server
+  // The batches are usually smaller than max_records_size, see BatchController.
+  static constexpr std::size_t _process_count = 4;                        // processes to send events to the server
   static constexpr std::size_t max_records_size = 4*1024*1024;            // JSON bytes before gzip compression
+  static constexpr std::size_t _start_backlog = 1024;                     // queued records to start another process
+
+  struct QueuedRecord {
+    std::shared_ptr<Record> _record;
+    TimestampSteady _time;            // when it was written, for the delivery latency
+  };
 
-  static inline std::deque<std::shared_ptr<Record>> _deque_records;
+  // the process threads park on _cond_var, without a timeout, until there are records to send or
+  // the program exits, so an idle program has no wake-ups; all of these are guarded by _deque_mutex
+  static inline std::deque<QueuedRecord> _deque_records;
   static inline std::mutex _deque_mutex;
-  static inline std::mutex _cond_var_mutex;
-  static inline std::condition_variable _cond_var;
+  static inline std::condition_variable_any _cond_var;        // records to send, or stop requested
+  static inline std::condition_variable _drained_cond_var;    // nothing queued or being sent, for flush
+  static inline std::size_t _idle_processes = 0;
+  static inline std::size_t _batches_in_flight = 0;
+  static inline std::size_t _flush_requests = 0;
+  static inline bool _is_lingering = false;                   // a process thread is waiting for a batch to fill
+  static inline bool _is_stopping = false;
+  static inline BatchController _batch_controller{max_records_size};
+  static inline std::vector<std::jthread> _processes;
   static inline bool _quiet = false;
-  std::vector<std::jthread> _processes;
+  static inline std::unique_ptr<File> _file_sink;   // GIOPLER_RECORD, otherwise send to the server
+
+  static std::string_view get_destination_name() {
+    return _file_sink ? "recording file"sv : "Giopler system"sv;
+  }
+
+  /// the queued records would take a busy process thread too long, called with _deque_mutex held
+  static bool is_backlogged() {
+    return _deque_records.size() >= _start_backlog || _batch_controller.is_batch_full(_deque_records.size());
+  }
+
+  /// send the queued records now, called with _deque_mutex held
+  static bool is_batch_ready() {
+    return _flush_requests || _batch_controller.is_batch_full(_deque_records.size());
+  }
 
-  // will take on average half a second to exit once requested
+  /// start another process thread, called with _deque_mutex held
+  GIOPLER_COLD static void start_process() {
+    _processes.emplace_back(_process_function);
+  }
+
+  // exits once requested, after sending the records still queued
+  // the batch buffer is allocated once per process thread and reused for every batch
+  // GIOPLER_HUGE_PAGES asks for it to be backed by transparent huge pages
+  // only one thread lingers at a time; the others stay parked until it has taken its batch
   constexpr static auto _process_function = [](std::stop_token stop_token) -> void {
-    Rest sink;
-    std::size_t records_left = 0;
-    bool is_stop_requested = false;
-
-    do {   // loop waiting for data to send or for the program to signal it is done
-      {
-        std::unique_lock<std::mutex> lock{_cond_var_mutex};
-        _cond_var.wait_for(lock, 1s);   // wait for new records to process or one second
+    std::optional<Rest> rest_sink;
+    if (!_file_sink)   rest_sink.emplace();
+    std::string records;
+    records.reserve(max_records_size + 2048);   // 2048=a record should be smaller than this
+    if (std::getenv("GIOPLER_HUGE_PAGES"))   advise_huge_pages(records.data(), records.capacity());
+    std::vector<TimestampSteady> record_times;   // of the batch being sent
+
+    std::unique_lock<std::mutex> lock{_deque_mutex};
+    while (true) {   // loop waiting for data to send or for the program to signal it is done
+      ++_idle_processes;
+      const bool has_records = _cond_var.wait(lock, stop_token, [] { return !_deque_records.empty() && !_is_lingering; });
+      --_idle_processes;
+      if (!has_records)   break;   // stop requested, and nothing left to send
+
+      // wait for more records, until the batch is full or the first record has used its share of the target
+      const std::chrono::steady_clock::duration linger = _batch_controller.get_linger();
+      if (linger.count() > 0 && !is_batch_ready() && !stop_token.stop_requested()) {
+        _is_lingering = true;
+        _cond_var.wait_until(lock, stop_token, _deque_records.front()._time + linger, [] { return is_batch_ready(); });
+        _is_lingering = false;
       }
 
-      std::string records = "[";
-      records.reserve(max_records_size + 2048);   // 2048=a record should be smaller than this
-      int records_count = 0;
-      bool first = true;
-
-      {
-        const std::lock_guard<std::mutex> lock{_deque_mutex};
-        while (!_deque_records.empty()) {
-          if (first) {
-            first = false;
-          } else {
-            records.append(",");
-          }
-          records.append(record_to_json(_deque_records.front()));
-          _deque_records.pop_front();
-          records_count++;
-          if (records.length() > max_records_size) {
-            break;
-          }
+      records.assign(1, '[');   // keeps the capacity
+      record_times.clear();
+      const std::size_t batch_bytes = _batch_controller.get_batch_bytes();
+      while (!_deque_records.empty()) {
+        if (!record_times.empty())   records.push_back(',');
+        record_to_json(_deque_records.front()._record, records);
+        record_times.push_back(_deque_records.front()._time);
+        _deque_records.pop_front();
+        if (records.length() > batch_bytes) {
+          break;
         }
-        records.append("]");
       }
-      if (records_count) {
-        const TimestampSteady start_time = now_steady();
-        sink.write_records(records);
-        const double time_secs = timestamp_diff(start_time, now_steady());
-        if (!_quiet)
-          std::cout << gformat("Giopler: sent {} event{} to Giopler system ({:.2f} events/second)\n",
-                               records_count, (records_count > 1) ? "s" : "", records_count/time_secs);
-      }
-      {
-        is_stop_requested = stop_token.stop_requested();   // need to read this before getting records count
-        const std::lock_guard<std::mutex> lock{_deque_mutex};
-        records_left = _deque_records.size();
+      records.append("]");
+      const std::size_t records_count = record_times.size();
+      _batch_controller.add_batch(records_count, now_steady());
+      if (!_deque_records.empty() && _idle_processes)   _cond_var.notify_one();   // for the rest of the records
+      ++_batches_in_flight;
+      lock.unlock();
+
+      const TimestampSteady start_time = now_steady();
+      if (_file_sink) {
+        _file_sink->write_records(records);
+      } else {
+        rest_sink->write_records(records);
       }
-    } while (records_left || !is_stop_requested);   // hang around in case we get more work to do in future
+      const TimestampSteady end_time = now_steady();
+      const double time_secs = timestamp_diff(start_time, end_time);
+      if (!_quiet)
+        std::cout << gformat("Giopler: sent {} event{} to {} ({:.2f} events/second)\n",
+                             records_count, (records_count > 1) ? "s" : "", get_destination_name(), records_count/time_secs);
+
+      LatencyBuckets latencies;
+      for (const TimestampSteady record_time : record_times)   latencies.add(timestamp_diff(record_time, end_time));
+
+      lock.lock();
+      _batch_controller.add_send(records_count, records.length(), time_secs);
+      _batch_controller.add_latencies(latencies);
+      --_batches_in_flight;
+      if (_deque_records.empty() && _batches_in_flight == 0)   _drained_cond_var.notify_all();
+    }
   };
 };
 
 // -----------------------------------------------------------------------------
-static inline SinkManager g_sink_manager{};
+// with GIOPLER_CORE_LIBRARY the single instance is in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+GIOPLER_CORE_INLINE SinkManager g_sink_manager{};
+#else
+extern SinkManager g_sink_manager;
+#endif
 
 // -----------------------------------------------------------------------------
 }   // namespace giopler::sink
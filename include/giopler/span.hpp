@@ -0,0 +1,363 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_SPAN_HPP
+#define GIOPLER_SPAN_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "giopler/config.hpp"
+#include "giopler/counter.hpp"
+#include "giopler/record.hpp"
+#include "giopler/utility.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+/// the self time and counters of the functions of a span, by call site
+// this is a private class for library internal use only
+// a span usually calls few sites, so they are kept in a vector and found by a linear search;
+// the line is compared first, and the names only when it matches
+class SpanSites final
+{
+ public:
+  /// add the prof_self record of one call
+  void add(const giopler::source_location& source_location, const Record& self, const std::int64_t calls = 1) {
+    Site& site = find(source_location);
+    site._calls += calls;
+    add_number_record(site._self, self);
+  }
+
+  void merge(const SpanSites& other) {
+    for (const Site& site : other._sites) {
+      add(site._source_location, site._self, site._calls);
+    }
+  }
+
+  void clear() {
+    _sites.clear();
+  }
+
+  /// the sites with the most self time, largest first
+  // each element: func, file, line, calls, and prof_self; the rest are added to other_dur
+  std::shared_ptr<giopler::Array> get_top_sites(const std::size_t count, double& other_dur) const {
+    std::vector<std::size_t> order(_sites.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](const std::size_t left, const std::size_t right) {
+      return get_dur(_sites[left]) > get_dur(_sites[right]);
+    });
+
+    std::shared_ptr<giopler::Array> sites = make_arena_shared<giopler::Array>();
+    other_dur = 0;
+    for (std::size_t rank = 0; rank < order.size(); ++rank) {
+      const Site& site = _sites[order[rank]];
+      if (rank >= count) {
+        other_dur += get_dur(site);
+        continue;
+      }
+      std::shared_ptr<Record> record = make_arena_shared<Record>();
+      record->insert({
+          {"func"s,       site._source_location.function_name()},
+          {"file"s,       site._source_location.file_name()},
+          {"line"s,       site._source_location.line()},
+          {"calls"s,      site._calls},
+          {"prof_self"s,  make_arena_shared<Record>(site._self)}
+      });
+      sites->push_back(record);
+    }
+    return sites;
+  }
+
+ private:
+  struct Site {
+    giopler::source_location _source_location;
+    std::int64_t _calls = 0;
+    Record _self;
+  };
+  std::vector<Site> _sites;
+
+  Site& find(const giopler::source_location& source_location) {
+    for (Site& site : _sites) {
+      if (site._source_location.line() == source_location.line() &&
+          std::strcmp(site._source_location.function_name(), source_location.function_name()) == 0 &&
+          std::strcmp(site._source_location.file_name(), source_location.file_name()) == 0) {
+        return site;
+      }
+    }
+    return _sites.emplace_back(Site{source_location});
+  }
+
+  static double get_dur(const Site& site) {
+    const auto dur = site._self.find("dur");
+    return (dur != site._self.end() && dur->second.get_type() == RecordValue::Type::Real) ? dur->second.get_real() : 0.0;
+  }
+};
+
+// -----------------------------------------------------------------------------
+/// a prod::Id scope that is summarized as one Span event (Prof)
+// this is a private class for library internal use only
+// the profiled functions called in the span add their self time and counters to it by call site,
+// instead of sending their own events; when it ends, the span adds its totals to its class
+// a span within another span also adds its sites to the enclosing span when it ends
+class Span final
+{
+ public:
+  explicit Span(const std::string_view id, const giopler::source_location& source_location)
+  : _id{id}, _source_location{source_location}, _start_time{now_steady()},
+    _counters_start{read_event_counters()}
+  {
+    ThreadControlBlock& thread_control = g_thread_control;
+    _parent_span         = thread_control._span;
+    thread_control._span = this;
+  }
+
+  ~Span() {
+    g_thread_control._span = _parent_span;
+  }
+
+  /// add the self time and counters of a function that ended
+  void add_site(const giopler::source_location& source_location, const Record& self) {
+    _sites.add(source_location, self);
+  }
+
+  /// write the Span event (if the call tree is sampled) and add the span to its class
+  GIOPLER_OUTLINE void end();
+
+ private:
+  std::string _id;
+  giopler::source_location _source_location;
+  TimestampSteady _start_time;
+  Record _counters_start;
+  Span* _parent_span;
+  SpanSites _sites;
+};
+
+// -----------------------------------------------------------------------------
+/// the totals of the spans with the same class
+// this is a private class for library internal use only
+// guarded by the mutex of SpanClasses
+class SpanClass final
+{
+ public:
+  explicit SpanClass(const std::string_view name, const giopler::source_location& source_location)
+  : _name{name}, _source_location{source_location}
+  { }
+
+ private:
+  friend class SpanClasses;
+  std::string _name;
+  giopler::source_location _source_location;   // of the first span
+  std::int64_t _spans = 0;
+  double _duration_max = 0;
+  std::vector<double> _durations;   // of the spans not yet reported, for the percentiles
+  Record _counters;
+  SpanSites _sites;
+};
+
+// -----------------------------------------------------------------------------
+/// the classes of the spans
+// this is a private class for library internal use only
+// the class of a span is the current prod::Class, or else the prefix of its id up to the last '.'
+// ("req.1234" is in class "req"); a SpanSummary event is written every GIOPLER_SPAN_SUMMARY spans
+// of a class (default 1000), and at program end for the spans not yet reported
+// GIOPLER_SPAN_SITES is the number of sites listed in each event (default 10)
+// GIOPLER_SPAN_EVENTS=1 also sends the events of the functions called in the spans
+class SpanClasses final
+{
+ public:
+  explicit SpanClasses() {
+    const char* spans = std::getenv("GIOPLER_SPAN_SUMMARY");
+    if (spans && std::atoll(spans) > 0)   _summary_spans = std::atoll(spans);
+    const char* sites = std::getenv("GIOPLER_SPAN_SITES");
+    if (sites && std::atoll(sites) > 0)   _top_sites = static_cast<std::size_t>(std::atoll(sites));
+    const char* events = std::getenv("GIOPLER_SPAN_EVENTS");
+    _is_function_events = events && std::string_view{events} == "1";
+  }
+
+  /// true if the functions called in a span also send their events
+  [[nodiscard]] bool is_function_events() const {
+    return _is_function_events;
+  }
+
+  [[nodiscard]] std::size_t get_top_sites() const {
+    return _top_sites;
+  }
+
+  /// add a span that ended to the totals of its class
+  GIOPLER_OUTLINE void add_span(std::string_view id, const giopler::source_location& source_location,
+                                double duration, const Record& counters, const SpanSites& sites);
+
+  /// write the summaries of the spans not yet reported
+  GIOPLER_COLD void write_summaries();
+
+ private:
+  std::mutex _mutex;
+  std::deque<SpanClass> _classes;   // stable addresses
+  std::int64_t _summary_spans = 1000;
+  std::size_t _top_sites = 10;
+  bool _is_function_events = false;
+
+  SpanClass& intern(std::string_view name, const giopler::source_location& source_location);
+
+  /// the SpanSummary event, and reset the totals; called with the mutex held
+  std::shared_ptr<Record> get_summary_record(SpanClass& span_class);
+};
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY the single instance is in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+GIOPLER_CORE_INLINE SpanClasses g_span_classes;
+#else
+extern SpanClasses g_span_classes;
+#endif
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void Span::end()
+{
+  const double duration = timestamp_diff(_start_time, now_steady());
+  Record counters{read_event_counters()};
+  subtract_number_record(counters, _counters_start);
+  counters.insert_or_assign("dur"s, duration);
+
+  if (g_thread_control._sampling == ThreadControlBlock::Sampling::Keep) {
+    std::shared_ptr<Record> record_span =
+        get_event_record(_source_location, EventCategory::Profile, Event::Span, UUID());
+    double other_dur = 0;
+    record_span->insert_or_assign("msg"s, std::string_view{_id});
+    record_span->insert({
+        {"dur"s,        duration},
+        {"prof_tot"s,   make_arena_shared<Record>(counters)},
+        {"sites"s,      _sites.get_top_sites(g_span_classes.get_top_sites(), other_dur)}
+    });
+    record_span->insert({{"other_dur"s, other_dur}});
+    sink::g_sink_manager.write_record(record_span);
+  }
+
+  if (_parent_span)   _parent_span->_sites.merge(_sites);
+  g_span_classes.add_span(_id, _source_location, duration, counters, _sites);
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void SpanClasses::add_span(const std::string_view id, const giopler::source_location& source_location,
+                           const double duration, const Record& counters, const SpanSites& sites)
+{
+  const std::string class_value = prod::Class::get_class();
+  const std::string_view name = !class_value.empty() ? std::string_view{class_value} :
+                                id.substr(0, std::min(id.rfind('.'), id.size()));
+
+  std::shared_ptr<Record> record_summary;
+  {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    SpanClass& span_class = intern(name, source_location);
+    span_class._spans++;
+    span_class._duration_max = std::max(span_class._duration_max, duration);
+    span_class._durations.push_back(duration);
+    add_number_record(span_class._counters, counters);
+    span_class._sites.merge(sites);
+    if (span_class._spans >= _summary_spans)   record_summary = get_summary_record(span_class);
+  }
+  if (record_summary)   sink::g_sink_manager.write_record(record_summary);
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void SpanClasses::write_summaries()
+{
+  std::vector<std::shared_ptr<Record>> records_summary;
+  {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    for (SpanClass& span_class : _classes) {
+      if (span_class._spans)   records_summary.push_back(get_summary_record(span_class));
+    }
+  }
+  for (const std::shared_ptr<Record>& record_summary : records_summary) {
+    sink::g_sink_manager.write_record(record_summary);
+  }
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+SpanClass& SpanClasses::intern(const std::string_view name, const giopler::source_location& source_location)
+{
+  for (SpanClass& span_class : _classes) {
+    if (span_class._name == name)   return span_class;
+  }
+  return _classes.emplace_back(name, source_location);
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+std::shared_ptr<Record> SpanClasses::get_summary_record(SpanClass& span_class)
+{
+  std::vector<double>& durations = span_class._durations;
+  std::sort(durations.begin(), durations.end());
+  auto get_percentile = [&durations](const double percentile) {   // nearest rank
+    const auto rank = static_cast<std::size_t>(percentile * static_cast<double>(durations.size()-1) + 0.5);
+    return durations[rank];
+  };
+  const double duration = std::accumulate(durations.begin(), durations.end(), 0.0);
+
+  std::shared_ptr<Record> record_summary =
+      get_event_record(span_class._source_location, EventCategory::Profile, Event::SpanSummary, UUID());
+  double other_dur = 0;
+  record_summary->insert_or_assign("msg"s, std::string_view{span_class._name});
+  record_summary->insert({
+      {"spans"s,      span_class._spans},
+      {"dur"s,        duration},
+      {"dur_avg"s,    duration / static_cast<double>(durations.size())},
+      {"dur_p50"s,    get_percentile(0.50)},
+      {"dur_p90"s,    get_percentile(0.90)},
+      {"dur_p99"s,    get_percentile(0.99)},
+      {"dur_max"s,    span_class._duration_max},
+      {"prof_tot"s,   make_arena_shared<Record>(span_class._counters)},
+      {"sites"s,      span_class._sites.get_top_sites(_top_sites, other_dur)}
+  });
+  record_summary->insert({{"other_dur"s, other_dur}});
+
+  span_class._spans        = 0;
+  span_class._duration_max = 0;
+  span_class._durations.clear();
+  span_class._counters     = Record{};
+  span_class._sites.clear();
+  return record_summary;
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+#endif // GIOPLER_CORE_DEFINITIONS
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_SPAN_HPP
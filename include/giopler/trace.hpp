@@ -21,6 +21,21 @@
 
 #include "giopler/config.hpp"
 #include "giopler/utility.hpp"
+#include "giopler/sink.hpp"
+#include "giopler/probe.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler
+{
+
+// -----------------------------------------------------------------------------
+/// write a Trace event
+// this is a private function for library internal use only
+GIOPLER_OUTLINE
+void write_trace_event(const source_location& source_location, Event event, std::string_view message);
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler
 
 // -----------------------------------------------------------------------------
 namespace giopler::dev
@@ -29,14 +44,11 @@ namespace giopler::dev
 // -----------------------------------------------------------------------------
 /// log executing code on a certain line in the program
 // used for debugging purposes
-void line([[maybe_unused]] const std::string_view message = ""sv,
-          [[maybe_unused]] const source_location& source_location = source_location::current())
+inline void line([[maybe_unused]] const std::string_view message = ""sv,
+                 [[maybe_unused]] const source_location& source_location = source_location::current())
 {
   if constexpr (g_build_mode == BuildMode::Dev) {
-    std::shared_ptr<Record> record_trace =
-        get_event_record(source_location, EventCategory::Trace, Event::Line, UUID());
-    record_trace->insert_or_assign("msg"s, message);
-    sink::g_sink_manager.write_record(record_trace);
+    write_trace_event(source_location, Event::Line, message);
   }
 }
 
@@ -47,10 +59,7 @@ void line([[maybe_unused]] StringFunction auto message_function,
           [[maybe_unused]] const source_location& source_location = source_location::current())
 {
   if constexpr (g_build_mode == BuildMode::Dev) {
-    std::shared_ptr<Record> record_trace =
-        get_event_record(source_location, EventCategory::Trace, Event::Line, UUID());
-    record_trace->insert_or_assign("msg"s, message_function());
-    sink::g_sink_manager.write_record(record_trace);
+    write_trace_event(source_location, Event::Line, std::string{message_function()});
   }
 }
 
@@ -107,31 +116,49 @@ namespace giopler::prod
 
 // -----------------------------------------------------------------------------
 /// documents
-void branch([[maybe_unused]] const std::string_view message = ""sv,
-            [[maybe_unused]] const giopler::source_location& source_location = giopler::source_location::current())
+GIOPLER_SITE_INLINE void branch([[maybe_unused]] const std::string_view message = ""sv,
+                   [[maybe_unused]] const giopler::source_location& source_location = giopler::source_location::current())
 {
   if constexpr (g_build_mode != BuildMode::Off) {
-    std::shared_ptr<Record> record_trace =
-        get_event_record(source_location, EventCategory::Trace, Event::Branch, UUID());
-    record_trace->insert_or_assign("msg"s, message);
-    sink::g_sink_manager.write_record(record_trace);
+    GIOPLER_PROBE_SITE(site, "branch", EventCategory::Trace, Event::Branch, source_location);
+    if (dev::is_probe_enabled(site, source_location))   write_trace_event(source_location, Event::Branch, message);
   }
 }
 
 // -----------------------------------------------------------------------------
-void branch([[maybe_unused]] StringFunction auto message_function,
+GIOPLER_SITE_INLINE void branch([[maybe_unused]] StringFunction auto message_function,
             [[maybe_unused]] const giopler::source_location& source_location = giopler::source_location::current())
 {
   if constexpr (g_build_mode != BuildMode::Off) {
-    std::shared_ptr<Record> record_trace =
-        get_event_record(source_location, EventCategory::Trace, Event::Branch, UUID());
-    record_trace->insert_or_assign("msg"s, message_function());
-    sink::g_sink_manager.write_record(record_trace);
+    GIOPLER_PROBE_SITE(site, "branch", EventCategory::Trace, Event::Branch, source_location);
+    if (dev::is_probe_enabled(site, source_location)) {
+      write_trace_event(source_location, Event::Branch, std::string{message_function()});
+    }
   }
 }
 
 // -----------------------------------------------------------------------------
 }   // namespace giopler::prod
 
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+namespace giopler {
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void write_trace_event(const source_location& source_location, const Event event, const std::string_view message)
+{
+  if (g_thread_control._sampling == ThreadControlBlock::Sampling::Drop)   return;   // see Sampler
+  std::shared_ptr<Record> record_trace =
+      get_event_record(source_location, EventCategory::Trace, event, UUID());
+  record_trace->insert_or_assign("msg"s, message);
+  sink::g_sink_manager.write_record(record_trace);
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler
+#endif // GIOPLER_CORE_DEFINITIONS
+
 // -----------------------------------------------------------------------------
 #endif // defined GIOPLER_TRACE_HPP
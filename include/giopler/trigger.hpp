@@ -0,0 +1,399 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_TRIGGER_HPP
+#define GIOPLER_TRIGGER_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "giopler/config.hpp"
+#include "giopler/counter.hpp"
+#include "giopler/record.hpp"
+#include "giopler/sink.hpp"
+#include "giopler/utility.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+/// open hardware counters for the calling thread and every thread it creates afterwards
+// they are inherited by the new threads, so the totals cover most of the process
+// does nothing if the counters are not available, or are already open
+extern void open_process_hardware_counters();
+
+// -----------------------------------------------------------------------------
+/// read the process-wide hardware counters, with the same key names as the Perf counter set
+// "hw_cpu_cycl", "hw_instr", "hw_cache_ref", "hw_cache_miss"; empty if they are not open
+extern Record read_process_hardware_counters();
+
+// -----------------------------------------------------------------------------
+/// the most recent detailed events, kept in memory instead of being sent
+// this is a private class for library internal use only
+// when it is full the oldest events are dropped
+class FlightRecorder final
+{
+ public:
+  explicit FlightRecorder(const std::size_t capacity)
+  : _capacity{capacity} { }
+
+  void push(std::shared_ptr<Record> record) {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    if (_records.size() >= _capacity) {
+      _records.pop_front();
+      _dropped++;
+    }
+    _records.emplace_back(std::move(record));
+  }
+
+  /// remove and return all the events, oldest first, and the count dropped since the last call
+  std::pair<std::deque<std::shared_ptr<Record>>, std::uint64_t> take() {
+    const std::lock_guard<std::mutex> lock{_mutex};
+    return {std::exchange(_records, {}), std::exchange(_dropped, 0)};
+  }
+
+ private:
+  const std::size_t _capacity;
+  std::mutex _mutex;
+  std::deque<std::shared_ptr<Record>> _records;
+  std::uint64_t _dropped = 0;
+};
+
+// -----------------------------------------------------------------------------
+/// switches on detailed capture for a bounded time window when a counter rule fires
+// this is a private class for library internal use only
+// a low-rate sampler thread reads the process-wide counters and evaluates the rules;
+// a rule fires when it becomes true, and fires again only after it has been false
+// while there are rules and no window is open, the Function events are kept in a
+// flight recorder instead of being sent; when a rule fires, a Trigger event is written
+// with the rule, the metric history before the trigger, and the flight recorder contents,
+// and the Function events are sent until the window closes
+// the metrics are rates over the sampling interval:
+//   cpu_util (busy cores), cntxt_swtch_rate, cntxt_swtch_inv_rate, pg_fault_rate, pg_fault_maj_rate,
+//   llc_miss_rate (cache misses per second), llc_miss_ratio (misses per reference), ipc (instructions per cycle)
+// the last three use hardware counters, opened when the first rule using them is added;
+// they count the adding thread and the threads it creates afterwards
+// GIOPLER_TRIGGER is a list of rules: "llc_miss_ratio>0.3,cntxt_swtch_rate>20000,ipc<0.5"
+// GIOPLER_TRIGGER_WINDOW is the capture window in milliseconds (default 1000)
+// GIOPLER_TRIGGER_INTERVAL is the sampling interval in milliseconds (default 100)
+// GIOPLER_FLIGHT_RECORDS is the number of events kept in the flight recorder (default 10000)
+class CaptureTrigger final
+{
+ public:
+  explicit CaptureTrigger([[maybe_unused]] giopler::source_location source_location = giopler::source_location::current())
+  {
+    if constexpr (_is_enabled) {
+      _source_location_file = source_location.file_name();
+      const char* rules = std::getenv("GIOPLER_TRIGGER");
+      std::string_view rules_view{rules ? rules : ""};
+      while (!rules_view.empty()) {
+        const std::size_t end = std::min(rules_view.find(','), rules_view.size());
+        add_rule(rules_view.substr(0, end));
+        rules_view.remove_prefix(std::min(end+1, rules_view.size()));
+      }
+    }
+  }
+
+  ~CaptureTrigger() {
+    if (_data) {
+      _data->_process.request_stop();
+      _data->_process.join();
+    }
+  }
+
+  /// true if the Function events are sent now, false if they go to the flight recorder
+  [[nodiscard]] bool is_live() const {
+    return !_is_armed.load(std::memory_order_relaxed) || _is_capturing.load(std::memory_order_relaxed);
+  }
+
+  /// send the record, or keep it in the flight recorder
+  // is_live is taken when the Function begins, so both of its events go to the same place
+  void write_record(std::shared_ptr<Record> record, const bool is_live) {
+    if (is_live) {
+      sink::g_sink_manager.write_record(std::move(record));
+    } else {
+      _data->_flight_recorder.push(std::move(record));
+    }
+  }
+
+  /// add a rule like "cntxt_swtch_rate>20000" or "ipc<0.5"
+  // starts the sampler thread if it is not running yet; returns false if the rule is not valid
+  bool add_rule(std::string_view rule_text);
+
+ private:
+  static constexpr bool _is_enabled =
+      (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench);
+  static constexpr std::size_t _history_size = 50;   // metric samples reported before the trigger
+
+  struct Rule {
+    std::string _text;
+    std::string _metric;
+    bool _is_greater;
+    double _threshold;
+    bool _was_true = false;
+  };
+
+  struct TriggerData {
+    explicit TriggerData(const char* file_name)
+    : _source_location(file_name, "<trigger>", 0),
+      _flight_recorder{get_env_count("GIOPLER_FLIGHT_RECORDS", 10'000)},
+      _window{std::chrono::milliseconds(get_env_count("GIOPLER_TRIGGER_WINDOW", 1000))},
+      _interval{std::chrono::milliseconds(std::max<std::size_t>(1, get_env_count("GIOPLER_TRIGGER_INTERVAL", 100)))}
+    { }
+
+    giopler::source_location _source_location;
+    FlightRecorder _flight_recorder;
+    const std::chrono::milliseconds _window;
+    const std::chrono::milliseconds _interval;
+    std::mutex _mutex;   // protects the rules, never taken by the instrumented threads
+    std::condition_variable_any _cond_var;
+    std::vector<Rule> _rules;
+    std::deque<std::pair<TimestampSteady, Record>> _history;   // metrics, oldest first
+    std::jthread _process;
+  };
+
+  const char* _source_location_file = "";
+  std::atomic<bool> _is_armed{false};       // there are rules
+  std::atomic<bool> _is_capturing{false};   // a window is open
+  std::mutex _start_mutex;
+  // use a data object to help minimize impact when not enabled
+  std::unique_ptr<TriggerData> _data;
+
+  static std::size_t get_env_count(const char* name, const std::size_t default_value) {
+    const char* value = std::getenv(name);
+    return value ? static_cast<std::size_t>(std::atoll(value)) : default_value;
+  }
+
+  static bool is_hardware_metric(const std::string_view metric) {
+    return metric == "llc_miss_rate" || metric == "llc_miss_ratio" || metric == "ipc";
+  }
+
+  static bool is_metric(const std::string_view metric) {
+    return is_hardware_metric(metric) || metric == "cpu_util" ||
+           metric == "cntxt_swtch_rate" || metric == "cntxt_swtch_inv_rate" ||
+           metric == "pg_fault_rate"    || metric == "pg_fault_maj_rate";
+  }
+
+  /// process-wide counters, and the time they were read
+  static Record read_sample() {
+    const TimestampSteady now = now_steady();
+    Record sample{read_process_counters()};
+    sample.merge(read_process_hardware_counters());
+    sample.insert({{"dur"s, to_seconds(now)}});
+    return sample;
+  }
+
+  /// the metrics over the interval between two samples
+  GIOPLER_OUTLINE static Record get_metrics(const Record& previous, const Record& current);
+
+  /// open the capture window: write the Trigger event, then send the flight recorder contents
+  GIOPLER_OUTLINE void fire(const Rule& rule, double value);
+
+  static void _process_function(std::stop_token stop_token, CaptureTrigger* trigger);
+};
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY the single instance is in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+GIOPLER_CORE_INLINE CaptureTrigger g_capture_trigger;
+#else
+extern CaptureTrigger g_capture_trigger;
+#endif
+
+// -----------------------------------------------------------------------------
+/// capture the Function events for a time window when the rule fires, like "cntxt_swtch_rate>20000"
+// until a rule fires, the Function events are kept in a flight recorder instead of being sent
+// returns false if the rule is not valid
+// giopler::dev::add_capture_trigger("llc_miss_ratio>0.3");
+inline bool add_capture_trigger([[maybe_unused]] const std::string_view rule)
+{
+  if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Prof || g_build_mode == BuildMode::Bench) {
+    return g_capture_trigger.add_rule(rule);
+  } else {
+    return false;
+  }
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+bool CaptureTrigger::add_rule(const std::string_view rule_text)
+{
+  if constexpr (!_is_enabled) {
+    return false;
+  } else {
+    const std::size_t op = rule_text.find_first_of("<>");
+    const std::string_view metric = (op == std::string_view::npos) ? rule_text : rule_text.substr(0, op);
+    if (op == std::string_view::npos || !is_metric(metric)) {
+      std::cerr << "WARNING: CaptureTrigger: rule '" << rule_text << "' is not valid (it will be ignored)" << std::endl;
+      return false;
+    }
+    Rule rule{std::string{rule_text}, std::string{metric}, rule_text[op] == '>',
+              std::atof(std::string{rule_text.substr(op+1)}.c_str())};
+    if (is_hardware_metric(metric))   open_process_hardware_counters();
+
+    const std::lock_guard<std::mutex> lock{_start_mutex};
+    if (!_data)   _data = std::make_unique<TriggerData>(_source_location_file);
+    {
+      const std::lock_guard<std::mutex> data_lock{_data->_mutex};
+      _data->_rules.push_back(std::move(rule));
+    }
+    _is_armed.store(true, std::memory_order_release);
+    if (!_data->_process.joinable()) {
+      _data->_process = std::jthread(_process_function, this);
+    }
+    return true;
+  }
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+Record CaptureTrigger::get_metrics(const Record& previous, const Record& current)
+{
+  Record delta{current};
+  subtract_number_record(delta, previous);
+  const auto get = [&delta](const std::string& key) -> double {
+    const auto found = delta.find(key);
+    if (found == delta.end())   return 0;
+    return found->second.get_type() == RecordValue::Type::Real ?
+           found->second.get_real() : static_cast<double>(found->second.get_integer());
+  };
+  const double seconds  = get("dur"s);
+  const auto per_second = [seconds](const double value) { return seconds > 0 ? value / seconds : 0.0; };
+
+  Record metrics{
+    {"cpu_util"s,             per_second(get("sw_task_clck"s))},
+    {"cntxt_swtch_rate"s,     per_second(get("sw_cntxt_swtch"s))},
+    {"cntxt_swtch_inv_rate"s, per_second(get("sw_cntxt_swtch_inv"s))},
+    {"pg_fault_rate"s,        per_second(get("sw_pg_fault"s))},
+    {"pg_fault_maj_rate"s,    per_second(get("sw_pg_fault_maj"s))}
+  };
+  if (delta.contains("hw_cache_miss"s)) {
+    const double references = get("hw_cache_ref"s);
+    const double cycles     = get("hw_cpu_cycl"s);
+    metrics.insert({
+      {"llc_miss_rate"s,      per_second(get("hw_cache_miss"s))},
+      {"llc_miss_ratio"s,     references > 0 ? get("hw_cache_miss"s) / references : 0.0},
+      {"ipc"s,                cycles > 0 ? get("hw_instr"s) / cycles : 0.0}
+    });
+  }
+  return metrics;
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void CaptureTrigger::fire(const Rule& rule, const double value)
+{
+  // new Function events are sent from now on; the ones already in the recorder follow the Trigger event
+  _is_capturing.store(true, std::memory_order_relaxed);
+  auto [flight_records, dropped] = _data->_flight_recorder.take();
+
+  const TimestampSteady now = now_steady();
+  std::shared_ptr<giopler::Array> history{make_arena_shared<giopler::Array>()};
+  for (const auto& [time, metrics] : _data->_history) {
+    std::shared_ptr<Record> sample = make_arena_shared<Record>(metrics);
+    sample->insert({{"age"s, timestamp_diff(time, now)}});   // seconds before the trigger
+    history->emplace_back(sample);
+  }
+
+  std::shared_ptr<Record> record =
+      get_event_record(_data->_source_location, EventCategory::Profile, Event::Trigger, UUID());
+  record->insert_or_assign("msg"s, rule._text);
+  record->insert({
+      {"metric"s,      std::string_view{rule._metric}},
+      {"value"s,       value},
+      {"threshold"s,   rule._threshold},
+      {"window"s,      std::chrono::duration<double>(_data->_window).count()},
+      {"flight"s,      static_cast<std::uint64_t>(flight_records.size())},
+      {"flight_drop"s, dropped},
+      {"history"s,     history}
+  });
+  sink::g_sink_manager.write_record(record);
+  for (std::shared_ptr<Record>& flight_record : flight_records) {
+    sink::g_sink_manager.write_record(std::move(flight_record));
+  }
+}
+
+// -----------------------------------------------------------------------------
+GIOPLER_CORE_INLINE
+void CaptureTrigger::_process_function(std::stop_token stop_token, CaptureTrigger* const trigger)
+{
+  TriggerData& data = *(trigger->_data);
+  Record previous = read_sample();
+  TimestampSteady window_end{};
+
+  std::unique_lock<std::mutex> lock{data._mutex};
+  while (!stop_token.stop_requested()) {
+    data._cond_var.wait_for(lock, stop_token, data._interval, [] { return false; });
+    if (stop_token.stop_requested())   break;
+
+    Record current = read_sample();
+    Record metrics = get_metrics(previous, current);
+    previous = std::move(current);
+
+    const TimestampSteady now = now_steady();
+    if (trigger->_is_capturing.load(std::memory_order_relaxed) && now >= window_end) {
+      trigger->_is_capturing.store(false, std::memory_order_relaxed);
+    }
+
+    for (Rule& rule : data._rules) {
+      const auto found = metrics.find(rule._metric);
+      if (found == metrics.end())   continue;   // hardware counters not available
+      const double value = found->second.get_real();
+      const bool is_true = rule._is_greater ? (value > rule._threshold) : (value < rule._threshold);
+      if (is_true && !rule._was_true && !trigger->_is_capturing.load(std::memory_order_relaxed)) {
+        trigger->fire(rule, value);
+        window_end = now + data._window;
+      }
+      rule._was_true = is_true;
+    }
+
+    data._history.emplace_back(now, std::move(metrics));
+    if (data._history.size() > _history_size)   data._history.pop_front();
+  }
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+#endif // GIOPLER_CORE_DEFINITIONS
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if defined(GIOPLER_PLATFORM_LINUX) && GIOPLER_CORE_DEFINITIONS
+#include "giopler/linux/trigger.hpp"
+#endif
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_TRIGGER_HPP
@@ -16,6 +16,7 @@
 #error Support for C++20 or newer is required to use this library.
 #endif
 
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <filesystem>
@@ -37,6 +38,7 @@ using namespace std::literals;
 #include "giopler/config.hpp"
 #include "giopler/platform.hpp"
 #include "giopler/pcg.hpp"
+#include "giopler/control.hpp"
 
 // -----------------------------------------------------------------------------
 /// String formatting function
@@ -93,7 +95,7 @@ make_shared_init_list(std::initializer_list<typename Container::value_type> il)
 
 // -----------------------------------------------------------------------------
 /// Use the environment to resolve the location of the home directory.
-std::filesystem::path get_home_path() {
+inline std::filesystem::path get_home_path() {
   if (std::getenv("HOME")) {
     return std::getenv("HOME");
   } else if (std::getenv("HOMEDRIVE") && std::getenv("HOMEPATH")) {
@@ -107,7 +109,7 @@ std::filesystem::path get_home_path() {
 
 // -----------------------------------------------------------------------------
 /// Resolve macros, canonicalize, and create directory.
-std::filesystem::path resolve_directory(const std::string_view directory) {
+inline std::filesystem::path resolve_directory(const std::string_view directory) {
   std::filesystem::path directory_path;
   std::string_view rest;
   if (directory.starts_with("<temp>")) {
@@ -133,7 +135,7 @@ std::filesystem::path resolve_directory(const std::string_view directory) {
 
 // -----------------------------------------------------------------------------
 /// Create file path for sink destination.
-std::filesystem::path create_filename(const std::string_view extension = "txt") {
+inline std::filesystem::path create_filename(const std::string_view extension = "txt") {
   std::random_device random_device;
   std::independent_bits_engine<std::default_random_engine, 32, std::uint_least32_t>
     generator{random_device()};
@@ -155,7 +157,7 @@ std::filesystem::path create_filename(const std::string_view extension = "txt")
 // Directory patterns:
 //   <temp>, <current>, <home>   - optionally follow these with other directories
 //   <cout>, <clog>, <cerr>      - these specify the entire path
-std::unique_ptr<std::ostream>
+inline std::unique_ptr<std::ostream>
 get_output_filepath(const std::string_view directory = "<temp>"sv, const std::string_view extension = "txt"sv)
 {
   if (directory == "<cerr>") {
@@ -184,19 +186,19 @@ using TimestampSteady = std::chrono::steady_clock::time_point;
 
 // -----------------------------------------------------------------------------
 /// returns the current timestamp
-TimestampSystem now_system() {
+inline TimestampSystem now_system() {
   return std::chrono::system_clock::now();
 }
 
 // -----------------------------------------------------------------------------
 /// returns the current timestamp
-TimestampSteady now_steady() {
+inline TimestampSteady now_steady() {
   return std::chrono::steady_clock::now();
 }
 
 // -----------------------------------------------------------------------------
-static inline const TimestampSystem start_system_time = std::chrono::system_clock::now();
-static inline const TimestampSteady start_steady_time = std::chrono::steady_clock::now();
+inline const TimestampSystem start_system_time = std::chrono::system_clock::now();
+inline const TimestampSteady start_steady_time = std::chrono::steady_clock::now();
 
 // -----------------------------------------------------------------------------
 /// convert the given Timestamp into nanoseconds
@@ -238,7 +240,7 @@ constexpr double timestamp_diff(const TimestampSteady start, const TimestampStea
 
 // -----------------------------------------------------------------------------
 /// returns seconds since the program started running
-double get_time_delta() {
+inline double get_time_delta() {
   return timestamp_diff(start_steady_time, now_steady());
 }
 
@@ -251,7 +253,7 @@ double get_time_delta() {
 // https://en.cppreference.com/w/cpp/chrono/utc_clock/formatter
 // Note: C++20 utc_clock is not quite implemented yet for gcc.
 // Parameter example: const auto start = std::chrono::system_clock::now();
-std::string format_timestamp(const TimestampSystem ts)
+inline std::string format_timestamp(const TimestampSystem ts)
 {
   // support for %Ez was merged into libfmt on December 10, 2022
   // https://github.com/fmtlib/fmt/issues/3220
@@ -318,7 +320,7 @@ public:
 // -----------------------------------------------------------------------------
 /// convert a source_location into a string
 // useful when creating the message when throwing an exception
-std::string format_source_location(const source_location &location)
+inline std::string format_source_location(const source_location &location)
 {
     std::string message =
       gformat("{}({}): {}",
@@ -328,6 +330,28 @@ std::string format_source_location(const source_location &location)
     return message;
 }
 
+// -----------------------------------------------------------------------------
+/// a random seed for the process, read once from std::random_device
+inline std::uint64_t get_process_seed()
+{
+  static const std::uint64_t seed = [] {
+    std::random_device random_device;
+    return (static_cast<std::uint64_t>(random_device()) << 32) | random_device();
+  }();
+  return seed;
+}
+
+// -----------------------------------------------------------------------------
+/// a seeded random generator for the calling thread, without any system calls after the first
+// the seed mixes the process seed with the thread id, and the stream is a process-wide
+// thread number, so a thread that reuses the id of an exited thread still gets a new sequence
+inline pcg get_thread_generator()
+{
+  constinit static std::atomic<std::uint64_t> thread_number{0};
+  return pcg::from_seed(get_process_seed() ^ (get_thread_id() * 0x9e3779b97f4a7c15ULL),
+                        thread_number.fetch_add(1, std::memory_order_relaxed));
+}
+
 // -----------------------------------------------------------------------------
 /// make UUID type safe
 class UUID
@@ -360,9 +384,14 @@ class UUID
       static const char hex_char[] =
         {'0', '1',  '2',  '3',  '4',  '5', '6',  '7',
          '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
-      static thread_local pcg                               gen;
-      static thread_local std::uniform_int_distribution<> hex_digit(0, 15);
-      static thread_local std::uniform_int_distribution<>   variant(8, 11);
+      ThreadControlBlock& thread_control = g_thread_control;
+      if (!thread_control._uuid_seeded) [[unlikely]] {
+        thread_control._uuid_generator = get_thread_generator();
+        thread_control._uuid_seeded    = true;
+      }
+      pcg& gen = thread_control._uuid_generator;
+      auto hex_digit = [](pcg& generator) { return generator() & 0xf; };         // 0-15, exactly uniform
+      auto variant   = [](pcg& generator) { return 8 + (generator() & 0x3); };   // 8-11
 
       std::string result;
       result.reserve(UUID_LEN);
@@ -395,16 +424,29 @@ class UUID
 namespace prod {
 
 // -----------------------------------------------------------------------------
-std::string uuid() {
+inline std::string uuid() {
   return UUID().get_string();
 }
 
 // -----------------------------------------------------------------------------
 }   // namespace prod
 
+// -----------------------------------------------------------------------------
+/// 64-bit FNV-1a hash
+// unlike std::hash, the value is the same across compilers, platforms, and program runs
+// http://www.isthe.com/chongo/tech/comp/fnv/index.html
+constexpr std::uint64_t hash_fnv1a(std::string_view value) {
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const char character : value) {
+    hash ^= static_cast<std::uint8_t>(character);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
 // -----------------------------------------------------------------------------
 /// helper to create a string hash from a string
-std::string hash_string(std::string_view id) {
+inline std::string hash_string(std::string_view id) {
   std::hash<std::string_view> hash;
   return std::to_string(hash(id));
 }
@@ -0,0 +1,305 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_WATCHDOG_HPP
+#define GIOPLER_WATCHDOG_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "giopler/config.hpp"
+#include "giopler/record.hpp"
+#include "giopler/sink.hpp"
+#include "giopler/frame.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler::dev {
+
+// -----------------------------------------------------------------------------
+/// native call stack of another thread in this process, one line per frame, innermost first
+// empty if it could not be captured
+extern std::vector<std::string> get_thread_backtrace(std::uint64_t thread_id);
+
+// -----------------------------------------------------------------------------
+/// reports the functions that have been running for longer than their deadline
+// this is a private class for library internal use only
+// the watchdog thread periodically copies the published call stack of every thread
+// (see PublishedFrames), and writes a Watchdog event, while the function is still running,
+// for the innermost frame of each thread that is past its deadline
+// each running frame is reported once; the event has the Giopler call stack with the time
+// spent in every frame, and the native backtrace of the thread
+// the monitored threads never wait for the watchdog, except to register when they start or exit
+// GIOPLER_WATCHDOG sets the deadline in milliseconds for all functions
+// GIOPLER_WATCHDOG_SITES sets the deadline for functions with names containing the given text
+//   "parse=200,Server::handle=1000"
+// the deadlines can also be set with set_watchdog_deadline()
+class Watchdog final
+{
+ public:
+  explicit Watchdog([[maybe_unused]] giopler::source_location source_location = giopler::source_location::current())
+  {
+    if constexpr (_is_enabled) {
+      _source_location_file = source_location.file_name();
+      const char* deadline = std::getenv("GIOPLER_WATCHDOG");
+      if (deadline)   set_deadline(""sv, std::chrono::milliseconds(std::atoll(deadline)));
+
+      const char* sites = std::getenv("GIOPLER_WATCHDOG_SITES");
+      std::string_view sites_view{sites ? sites : ""};
+      while (!sites_view.empty()) {
+        const std::size_t end    = std::min(sites_view.find(','), sites_view.size());
+        const std::string_view site = sites_view.substr(0, end);
+        const std::size_t equals = site.rfind('=');
+        if (equals != std::string_view::npos && equals > 0) {
+          set_deadline(site.substr(0, equals),
+                       std::chrono::milliseconds(std::atoll(std::string{site.substr(equals+1)}.c_str())));
+        }
+        sites_view.remove_prefix(std::min(end+1, sites_view.size()));
+      }
+    }
+  }
+
+  ~Watchdog() {
+    if (_data) {
+      _data->_process.request_stop();
+      _data->_process.join();
+    }
+  }
+
+  /// set the deadline for the functions whose names contain the given text
+  // an empty name sets the deadline for all functions; zero removes the deadline
+  // the most specific (longest) matching name wins
+  // starts the watchdog thread if it is not running yet
+  void set_deadline(const std::string_view function_name, const std::chrono::milliseconds deadline) {
+    if constexpr (_is_enabled) {
+      const std::lock_guard<std::mutex> lock{_start_mutex};
+      if (!_data) {
+        if (deadline.count() <= 0)   return;
+        _data = std::make_unique<WatchdogData>(_source_location_file);
+      }
+
+      {
+        const std::lock_guard<std::mutex> data_lock{_data->_mutex};
+        const auto deadline_ns = static_cast<std::uint64_t>(std::chrono::nanoseconds(deadline).count());
+        std::erase_if(_data->_deadlines, [&](const auto& site) { return site.first == function_name; });
+        if (deadline.count() > 0)   _data->_deadlines.emplace_back(std::string{function_name}, deadline_ns);
+        _data->_deadline_cache.clear();
+      }
+
+      if (!_data->_process.joinable()) {
+        _data->_process = std::jthread(_process_function, _data.get());
+      }
+    }
+  }
+
+ private:
+  static constexpr bool _is_enabled = (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Prof);
+  static constexpr std::chrono::milliseconds _min_interval{10};
+  static constexpr std::chrono::milliseconds _max_interval{1000};
+  static constexpr int _snapshot_attempts = 3;
+
+  struct WatchdogData {
+    explicit WatchdogData(const char* file_name)
+    : _source_location(file_name, "<watchdog>", 0) { }
+
+    giopler::source_location _source_location;
+    std::mutex _mutex;   // protects the deadlines, never taken by the monitored threads
+    std::condition_variable_any _cond_var;
+    std::vector<std::pair<std::string, std::uint64_t>> _deadlines;    // function name text, nanoseconds
+    std::unordered_map<const char*, std::uint64_t> _deadline_cache;   // function name, nanoseconds (0=none)
+    std::set<std::tuple<std::uint64_t, std::uint32_t, std::uint64_t>> _reported;   // thread, frame, start
+    std::jthread _process;
+  };
+
+  /// a frame past its deadline
+  struct OverdueFrame {
+    PublishedFrames::Snapshot _snapshot;
+    std::uint32_t _frame;        // index into the snapshot
+    std::uint64_t _deadline_ns;
+  };
+
+  const char* _source_location_file = "";
+  std::mutex _start_mutex;
+  // use a data object to help minimize impact when not enabled
+  std::unique_ptr<WatchdogData> _data;
+
+  /// deadline for the function, using the most specific matching name
+  static std::uint64_t get_deadline(WatchdogData& data, const char* function_name) {
+    const auto found = data._deadline_cache.find(function_name);
+    if (found != data._deadline_cache.end())   return found->second;
+
+    std::size_t match_length = 0;
+    std::uint64_t deadline_ns = 0;
+    const std::string_view function_view{function_name ? function_name : ""};
+    for (const auto& [name, site_deadline_ns] : data._deadlines) {
+      if ((name.empty() || function_view.find(name) != std::string_view::npos) &&
+          (deadline_ns == 0 || name.size() > match_length)) {
+        match_length = name.size();
+        deadline_ns  = site_deadline_ns;
+      }
+    }
+    data._deadline_cache.emplace(function_name, deadline_ns);
+    return deadline_ns;
+  }
+
+  /// check the deadlines four times during the shortest deadline
+  static std::chrono::milliseconds get_interval(const WatchdogData& data) {
+    std::uint64_t shortest_ns = UINT64_MAX;
+    for (const auto& site : data._deadlines)   shortest_ns = std::min(shortest_ns, site.second);
+    const auto interval = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::nanoseconds(shortest_ns / 4));
+    return std::clamp(interval, _min_interval, _max_interval);
+  }
+
+  /// the innermost frame of every thread that is past its deadline
+  // frame 0 is the thread itself, and never has a deadline
+  // the threads whose stacks kept changing while being copied are added to busy_threads
+  static std::vector<OverdueFrame> get_overdue_frames(WatchdogData& data, std::set<std::uint64_t>& busy_threads) {
+    std::vector<OverdueFrame> overdue_frames;
+    auto snapshot = std::make_unique<PublishedFrames::Snapshot>();
+    const auto now_ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count());
+
+    g_frame_registry.for_each([&](const PublishedFrames& frames) {
+      int attempt = 0;
+      while (!frames.get_snapshot(*snapshot)) {
+        if (++attempt == _snapshot_attempts) {
+          busy_threads.insert(frames.get_thread_id());
+          return;
+        }
+      }
+      for (std::uint32_t frame = snapshot->_depth; frame-- > 1; ) {
+        const std::uint64_t deadline_ns = get_deadline(data, snapshot->_functions[frame]);
+        if (deadline_ns && now_ns - std::min(now_ns, snapshot->_start_ns[frame]) > deadline_ns) {
+          overdue_frames.push_back(OverdueFrame{*snapshot, frame, deadline_ns});
+          break;
+        }
+      }
+    });
+    return overdue_frames;
+  }
+
+  static void write_overdue_frame(const WatchdogData& data, const OverdueFrame& overdue_frame,
+                                  std::vector<std::string> backtrace_lines) {
+    const PublishedFrames::Snapshot& snapshot = overdue_frame._snapshot;
+    const auto now_ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count());
+    const char* function_name = snapshot._functions[overdue_frame._frame];
+    const double elapsed = ns_to_sec(now_ns - std::min(now_ns, snapshot._start_ns[overdue_frame._frame]));
+
+    // [0]=thread, [depth-1]=innermost function, like the FunctionEnd event
+    std::shared_ptr<giopler::Array> functions{make_arena_shared<giopler::Array>()};
+    std::shared_ptr<giopler::Array> frame_times{make_arena_shared<giopler::Array>()};
+    for (std::uint32_t frame = 0; frame < snapshot._depth; ++frame) {
+      functions->emplace_back(snapshot._functions[frame] ? snapshot._functions[frame] : "");
+      frame_times->emplace_back(ns_to_sec(now_ns - std::min(now_ns, snapshot._start_ns[frame])));
+    }
+
+    std::shared_ptr<giopler::Array> backtrace{make_arena_shared<giopler::Array>()};
+    for (std::string& line : backtrace_lines)   backtrace->emplace_back(std::move(line));
+
+    const giopler::source_location source_location{data._source_location.file_name(),
+                                                   function_name ? function_name : "<watchdog>", 0};
+    std::shared_ptr<Record> record =
+        get_event_record(source_location, EventCategory::Profile, Event::Watchdog, UUID());
+    record->insert_or_assign("msg"s, gformat("running for {:.3f} s, deadline {:.3f} s",
+                                             elapsed, ns_to_sec(overdue_frame._deadline_ns)));
+    record->insert_or_assign("stuck_thrd"s, snapshot._thread_id);
+    record->insert_or_assign("depth"s,      overdue_frame._frame);
+    record->insert_or_assign("elapsed"s,    elapsed);
+    record->insert_or_assign("deadline"s,   ns_to_sec(overdue_frame._deadline_ns));
+    record->insert({{"funcs"s, functions}});
+    record->insert({{"frame_secs"s, frame_times}});
+    record->insert({{"backtrace"s, backtrace}});
+    sink::g_sink_manager.write_record(record);
+  }
+
+  /// the stacks are copied while holding the registry lock, but the backtraces and events are done after
+  static void _process_function(std::stop_token stop_token, WatchdogData* data) {
+    const char* backtrace_option = std::getenv("GIOPLER_WATCHDOG_BACKTRACE");
+    const bool is_backtrace = !backtrace_option || std::string_view{backtrace_option} != "0";
+
+    std::unique_lock<std::mutex> lock{data->_mutex};
+    while (!stop_token.stop_requested()) {
+      data->_cond_var.wait_for(lock, stop_token, get_interval(*data), [] { return false; });
+      if (stop_token.stop_requested())   break;
+
+      // keep the reported frames of busy threads, we do not know if they are done
+      std::set<std::uint64_t> busy_threads;
+      const std::vector<OverdueFrame> overdue_frames = get_overdue_frames(*data, busy_threads);
+      decltype(data->_reported) reported;
+      for (const auto& key : data->_reported) {
+        if (busy_threads.contains(std::get<0>(key)))   reported.insert(key);
+      }
+
+      for (const OverdueFrame& overdue_frame : overdue_frames) {
+        const auto key = std::make_tuple(overdue_frame._snapshot._thread_id, overdue_frame._frame,
+                                         overdue_frame._snapshot._start_ns[overdue_frame._frame]);
+        reported.insert(key);
+        if (data->_reported.contains(key))   continue;
+
+        lock.unlock();
+        write_overdue_frame(*data, overdue_frame,
+            is_backtrace ? get_thread_backtrace(overdue_frame._snapshot._thread_id) : std::vector<std::string>{});
+        lock.lock();
+      }
+      data->_reported = std::move(reported);   // forget the frames that are done
+    }
+  }
+};
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY the single instance is in the compiled library
+#if GIOPLER_CORE_DEFINITIONS
+GIOPLER_CORE_INLINE Watchdog g_watchdog;
+#else
+extern Watchdog g_watchdog;
+#endif
+
+// -----------------------------------------------------------------------------
+/// report the functions whose names contain the given text when they run for longer than the deadline
+// an empty name sets the deadline for all functions; zero removes the deadline
+// giopler::dev::set_watchdog_deadline("handle_request", 500ms);
+inline void set_watchdog_deadline([[maybe_unused]] const std::string_view function_name,
+                                  [[maybe_unused]] const std::chrono::milliseconds deadline)
+{
+  if constexpr (g_build_mode == BuildMode::Dev || g_build_mode == BuildMode::Prof) {
+    g_watchdog.set_deadline(function_name, deadline);
+  }
+}
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::dev
+
+// -----------------------------------------------------------------------------
+// with GIOPLER_CORE_LIBRARY these are defined in the compiled library
+#if defined(GIOPLER_PLATFORM_LINUX) && GIOPLER_CORE_DEFINITIONS
+#include "giopler/linux/watchdog.hpp"
+#endif
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_WATCHDOG_HPP
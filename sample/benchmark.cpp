@@ -280,6 +280,14 @@ int main()
   std::default_random_engine random_engine{random_device()};
   std::uniform_int_distribution<> int_distribution(0, 1024*1024*1024);
 
+  {   // fill the caches and the branch predictors; not reported in Bench mode
+    giopler::prod::Phase phase{"warm-up", giopler::prod::PhaseKind::WarmUp};
+    std::vector<int> values(1024);
+    for (auto&& x : values) x = int_distribution(random_engine);
+    auto res = funnelsort(values.begin(), values.end());
+  }
+
+  giopler::prod::Phase phase{"measure"};
   for (int loop = 0; loop < 1; ++loop) {
     for (int elements = 64; elements <= 1024; elements += 64) {    // 64 - 1024
       std::vector<int> values(elements);
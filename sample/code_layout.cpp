@@ -0,0 +1,158 @@
+// Copyright (c) 2023 Giopler
+// This code is licensed under the permissive MIT License (MIT).
+// SPDX-License-Identifier: MIT-Modern-Variant
+// https://fedoraproject.org/wiki/Licensing:MIT#Modern_Variants
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute this
+// software and its documentation for any purpose, provided that the
+// above copyright notice and the following two paragraphs appear in
+// all copies of this software.
+//
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+// DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+// ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+// IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+// ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+// PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+
+// A program whose hot code is spread thinly through its cold code,
+// to measure the effect of a function order from giopler_order.
+// There are 512 small hot functions, each followed by four large functions that never run,
+// so in the default layout every hot function is on its own page of code.
+// The hot functions call each other in 64 chains of eight.
+//
+// code_layout [iterations]
+// With CODE_LAYOUT_PROFILE=1 the hot functions are profiled, to record the run for giopler_order.
+// Without it the program only times the calls, and prints the best of five runs.
+
+#ifndef CODE_LAYOUT_PROFILE
+#define CODE_LAYOUT_PROFILE 0
+#endif
+
+#if CODE_LAYOUT_PROFILE
+#include "giopler/giopler.hpp"
+#define CODE_LAYOUT_FUNCTION giopler::dev::Function function
+#else
+#define CODE_LAYOUT_FUNCTION
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using HotFunction = unsigned (*)(unsigned);
+
+constexpr int g_hot_count   = 512;
+constexpr int g_chain_count = 64;
+
+// not const, so the calls stay indirect calls that the compiler cannot inline
+extern HotFunction g_hot[g_hot_count];
+extern HotFunction g_cold[g_hot_count*4];
+
+// -----------------------------------------------------------------------------
+// a large function that never runs, padded by the assembler to keep the build fast
+#define CODE_LAYOUT_COLD(NAME, SEED)                                          \
+  __attribute__((noinline)) unsigned NAME(unsigned x)                         \
+  {                                                                           \
+    asm volatile(".rept 1536\n nop\n .endr");                                 \
+    return x*(SEED);                                                          \
+  }
+
+// a small function that does a little work and calls the next one of its chain
+#define CODE_LAYOUT_GROUP(A, B, C)                                            \
+  __attribute__((noinline)) unsigned hot_##A##B##C(unsigned x)                \
+  {                                                                           \
+    CODE_LAYOUT_FUNCTION;                                                     \
+    constexpr int index = (A*64 + B*8 + C);                                   \
+    x = x*2654435761u + index;                                                \
+    if constexpr (index + g_chain_count < g_hot_count)   x = g_hot[index + g_chain_count](x);   \
+    return x ^ (x >> 13);                                                     \
+  }                                                                           \
+  CODE_LAYOUT_COLD(cold_##A##B##C##_0, (A*64 + B*8 + C)*4 + 3)                \
+  CODE_LAYOUT_COLD(cold_##A##B##C##_1, (A*64 + B*8 + C)*4 + 5)                \
+  CODE_LAYOUT_COLD(cold_##A##B##C##_2, (A*64 + B*8 + C)*4 + 7)                \
+  CODE_LAYOUT_COLD(cold_##A##B##C##_3, (A*64 + B*8 + C)*4 + 9)
+
+#define CODE_LAYOUT_GROUPS(A, B)                                              \
+  CODE_LAYOUT_GROUP(A, B, 0) CODE_LAYOUT_GROUP(A, B, 1)                       \
+  CODE_LAYOUT_GROUP(A, B, 2) CODE_LAYOUT_GROUP(A, B, 3)                       \
+  CODE_LAYOUT_GROUP(A, B, 4) CODE_LAYOUT_GROUP(A, B, 5)                       \
+  CODE_LAYOUT_GROUP(A, B, 6) CODE_LAYOUT_GROUP(A, B, 7)
+
+#define CODE_LAYOUT_ALL(MACRO, A)                                             \
+  MACRO(A, 0) MACRO(A, 1) MACRO(A, 2) MACRO(A, 3)                             \
+  MACRO(A, 4) MACRO(A, 5) MACRO(A, 6) MACRO(A, 7)
+
+CODE_LAYOUT_ALL(CODE_LAYOUT_GROUPS, 0)
+CODE_LAYOUT_ALL(CODE_LAYOUT_GROUPS, 1)
+CODE_LAYOUT_ALL(CODE_LAYOUT_GROUPS, 2)
+CODE_LAYOUT_ALL(CODE_LAYOUT_GROUPS, 3)
+CODE_LAYOUT_ALL(CODE_LAYOUT_GROUPS, 4)
+CODE_LAYOUT_ALL(CODE_LAYOUT_GROUPS, 5)
+CODE_LAYOUT_ALL(CODE_LAYOUT_GROUPS, 6)
+CODE_LAYOUT_ALL(CODE_LAYOUT_GROUPS, 7)
+
+// -----------------------------------------------------------------------------
+#define CODE_LAYOUT_HOT_ENTRIES(A, B)                                         \
+  hot_##A##B##0, hot_##A##B##1, hot_##A##B##2, hot_##A##B##3,                 \
+  hot_##A##B##4, hot_##A##B##5, hot_##A##B##6, hot_##A##B##7,
+
+#define CODE_LAYOUT_COLD_ENTRIES(A, B, C)                                     \
+  cold_##A##B##C##_0, cold_##A##B##C##_1, cold_##A##B##C##_2, cold_##A##B##C##_3,
+
+#define CODE_LAYOUT_COLD_GROUPS(A, B)                                         \
+  CODE_LAYOUT_COLD_ENTRIES(A, B, 0) CODE_LAYOUT_COLD_ENTRIES(A, B, 1)         \
+  CODE_LAYOUT_COLD_ENTRIES(A, B, 2) CODE_LAYOUT_COLD_ENTRIES(A, B, 3)         \
+  CODE_LAYOUT_COLD_ENTRIES(A, B, 4) CODE_LAYOUT_COLD_ENTRIES(A, B, 5)         \
+  CODE_LAYOUT_COLD_ENTRIES(A, B, 6) CODE_LAYOUT_COLD_ENTRIES(A, B, 7)
+
+HotFunction g_hot[g_hot_count] = {
+  CODE_LAYOUT_ALL(CODE_LAYOUT_HOT_ENTRIES, 0) CODE_LAYOUT_ALL(CODE_LAYOUT_HOT_ENTRIES, 1)
+  CODE_LAYOUT_ALL(CODE_LAYOUT_HOT_ENTRIES, 2) CODE_LAYOUT_ALL(CODE_LAYOUT_HOT_ENTRIES, 3)
+  CODE_LAYOUT_ALL(CODE_LAYOUT_HOT_ENTRIES, 4) CODE_LAYOUT_ALL(CODE_LAYOUT_HOT_ENTRIES, 5)
+  CODE_LAYOUT_ALL(CODE_LAYOUT_HOT_ENTRIES, 6) CODE_LAYOUT_ALL(CODE_LAYOUT_HOT_ENTRIES, 7)
+};
+
+HotFunction g_cold[g_hot_count*4] = {
+  CODE_LAYOUT_ALL(CODE_LAYOUT_COLD_GROUPS, 0) CODE_LAYOUT_ALL(CODE_LAYOUT_COLD_GROUPS, 1)
+  CODE_LAYOUT_ALL(CODE_LAYOUT_COLD_GROUPS, 2) CODE_LAYOUT_ALL(CODE_LAYOUT_COLD_GROUPS, 3)
+  CODE_LAYOUT_ALL(CODE_LAYOUT_COLD_GROUPS, 4) CODE_LAYOUT_ALL(CODE_LAYOUT_COLD_GROUPS, 5)
+  CODE_LAYOUT_ALL(CODE_LAYOUT_COLD_GROUPS, 6) CODE_LAYOUT_ALL(CODE_LAYOUT_COLD_GROUPS, 7)
+};
+
+// -----------------------------------------------------------------------------
+/// call every chain, the given number of times
+unsigned run_chains(unsigned x, const long iterations)
+{
+  CODE_LAYOUT_FUNCTION;
+  for (long iteration = 0; iteration < iterations; ++iteration) {
+    for (int chain = 0; chain < g_chain_count; ++chain)   x = g_hot[chain](x);
+  }
+  return x;
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  const long iterations = (argc > 1) ? std::atol(argv[1]) : (CODE_LAYOUT_PROFILE ? 20 : 20000);
+  unsigned x = static_cast<unsigned>(argc);
+  if (argc > 2)   x = g_cold[x % (g_hot_count*4)](x);   // keep the cold functions
+
+  double best_secs = 1e9;
+  for (int run = 0; run < (CODE_LAYOUT_PROFILE ? 1 : 5); ++run) {
+    const auto start_time = std::chrono::steady_clock::now();
+    x = run_chains(x, iterations);
+    best_secs = std::min(best_secs, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+  }
+
+  std::printf("%ld iterations, %.2f ns per hot call (%u)\n",
+              iterations, best_secs * 1e9 / (static_cast<double>(iterations) * g_hot_count), x);
+  return EXIT_SUCCESS;
+}
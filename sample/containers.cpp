@@ -0,0 +1,85 @@
+// Copyright (c) 2023 Giopler
+// This code is licensed under the permissive MIT License (MIT).
+// SPDX-License-Identifier: MIT-Modern-Variant
+// https://fedoraproject.org/wiki/Licensing:MIT#Modern_Variants
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute this
+// software and its documentation for any purpose, provided that the
+// above copyright notice and the following two paragraphs appear in
+// all copies of this software.
+//
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+// DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+// ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+// IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+// ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+// PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+
+
+// Containers that grow one element at a time, profiled with giopler::profiling_allocator.
+// The AllocationSummary event of each tag shows how often its containers were reallocated,
+// how many bytes were copied, and which functions did it; the FunctionEnd events have the same
+// counts as the usr_alloc, usr_alloc_bytes, usr_realloc, and usr_copy_bytes counters.
+// The "reserved" containers hold the same elements, but are sized first.
+
+#include "giopler/giopler.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+struct GrownTag    { static constexpr std::string_view name = "grown"; };
+struct ReservedTag { static constexpr std::string_view name = "reserved"; };
+
+template<typename Tag>
+using Vector = std::vector<std::uint64_t, giopler::profiling_allocator<std::uint64_t, Tag>>;
+
+template<typename Tag>
+using Map = std::unordered_map<std::uint64_t, std::uint64_t, std::hash<std::uint64_t>, std::equal_to<>,
+                               giopler::profiling_allocator<std::pair<const std::uint64_t, std::uint64_t>, Tag>>;
+
+constexpr std::size_t g_elements = 100000;
+
+// -----------------------------------------------------------------------------
+std::uint64_t fill_grown()
+{
+  giopler::dev::Function function;
+  Vector<GrownTag> values;
+  Map<GrownTag> squares;
+  for (std::uint64_t value = 0; value < g_elements; ++value) {
+    values.push_back(value);
+    squares.emplace(value, value*value);
+  }
+  return values.back() + squares.size();
+}
+
+// -----------------------------------------------------------------------------
+std::uint64_t fill_reserved()
+{
+  giopler::dev::Function function;
+  Vector<ReservedTag> values;
+  Map<ReservedTag> squares;
+  values.reserve(g_elements);
+  squares.reserve(g_elements);
+  for (std::uint64_t value = 0; value < g_elements; ++value) {
+    values.push_back(value);
+    squares.emplace(value, value*value);
+  }
+  return values.back() + squares.size();
+}
+
+// -----------------------------------------------------------------------------
+int main()
+{
+  giopler::dev::Function function;
+  const std::uint64_t total = fill_grown() + fill_reserved();
+  return (total == 2*(g_elements-1 + g_elements)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
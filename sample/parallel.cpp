@@ -0,0 +1,83 @@
+// Copyright (c) 2023 Giopler
+// This code is licensed under the permissive MIT License (MIT).
+// SPDX-License-Identifier: MIT-Modern-Variant
+// https://fedoraproject.org/wiki/Licensing:MIT#Modern_Variants
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute this
+// software and its documentation for any purpose, provided that the
+// above copyright notice and the following two paragraphs appear in
+// all copies of this software.
+//
+// IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+// DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+// ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+// IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+// BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+// ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+// PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+
+#include "giopler/giopler.hpp"
+#include <cstdlib>
+#include <thread>
+#include "giopler/giopler.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <execution>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+double work(const int iterations)
+{
+  double sum = 0;
+  for (int i = 1; i <= iterations; ++i) {
+    sum += std::sqrt(static_cast<double>(i));
+  }
+  return sum;
+}
+
+// -----------------------------------------------------------------------------
+/// threads started by hand, with more work given to the later ones
+// the ParallelRegion event reports the last thread as the straggler
+void unbalanced(const int thread_count)
+{
+  giopler::dev::Function function;
+  giopler::dev::ParallelRegion region{"unbalanced"};
+  std::vector<std::jthread> threads;
+  std::vector<double> results(thread_count);
+
+  for (int instance = 0; instance < thread_count; ++instance) {
+    threads.emplace_back([&region, &results, instance]() {
+      giopler::dev::ParallelRegion::Participant participant{region};
+      results[instance] = work(1'000'000 * (instance+1));
+    });
+  }
+  threads.clear();   // join before the region ends
+}
+
+// -----------------------------------------------------------------------------
+/// the same kind of work, run by the parallel standard algorithms
+void balanced(const int size)
+{
+  giopler::dev::Function function;
+  std::vector<int> values(size, 1'000);
+  giopler::dev::par::for_each(std::execution::par, values.begin(), values.end(),
+                              [](int& value) { value = static_cast<int>(work(value)); });
+  const double total = giopler::dev::par::transform_reduce(std::execution::par, values.begin(), values.end(),
+                              0.0, std::plus<>(), [](const int value) { return work(value % 10'000); });
+  giopler::prod::message(giopler::gformat("total {}", total));
+}
+
+// -----------------------------------------------------------------------------
+int main()
+{
+  unbalanced(4);
+  balanced(100'000);
+  return EXIT_SUCCESS;
+}
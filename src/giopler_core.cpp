@@ -0,0 +1,17 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+// The compiled core of the library (the giopler_core CMake target).
+// Code linked with it is compiled with GIOPLER_CORE_LIBRARY, so the headers only keep the fast paths inline,
+// and the record building, serialization, and error handling code is compiled once, here.
+// Must be compiled with the same build mode as the rest of the program.
+
+#define GIOPLER_CORE_IMPLEMENTATION 1
+#include "giopler/giopler.hpp"
@@ -0,0 +1,296 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+// Measures the batch compression codecs of the event sink on recorded batches.
+// Every top-level array of a recording (GIOPLER_RECORD) is one batch, exactly as the sink sends it,
+// so the sizes and the mix of events are those of the program that was recorded.
+//
+// usage: giopler_codec [options] <recording>...
+//   --codecs <list>       codecs to measure, comma separated (default: all available)
+//   --levels <list>       compression levels, comma separated (default: 0, the default of each codec)
+//   --repeat <count>      times every batch is compressed and decompressed (default: 5)
+//   --dict <file>         also measure zstd with this dictionary
+//   --train <file>        train a zstd dictionary on the batches of the first recording, write it to the file,
+//                         and measure it on the batches of the other recordings (or the same one, if there is one)
+//   --dict-size <bytes>   size of the trained dictionary (default: 16384)
+//
+// Example, with the recordings of two runs of a sample program:
+//   GIOPLER_RECORD=run1.json ./threads; GIOPLER_RECORD=run2.json ./threads
+//   giopler_codec --levels 1,3,6 --train threads.dict run1.json run2.json
+//   GIOPLER_CODEC=zstd GIOPLER_CODEC_DICT=threads.dict ./threads
+//
+// The speeds are of the uncompressed JSON, on one thread.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "giopler/codec.hpp"
+#include "giopler/utility.hpp"
+
+#if defined(GIOPLER_HAVE_ZSTD)
+#include <zdict.h>
+#endif
+
+using namespace std::literals;
+using giopler::gformat;
+using giopler::sink::Codec;
+using giopler::sink::CodecOptions;
+using giopler::sink::Compressor;
+using giopler::sink::Decompressor;
+
+// -----------------------------------------------------------------------------
+struct Options {
+  std::vector<Codec> codecs;
+  std::vector<int> levels{0};
+  int repeat = 5;
+  std::string dict_path;
+  std::string train_path;
+  std::size_t dict_size = 16*1024;
+  std::vector<std::string> recordings;
+};
+
+// -----------------------------------------------------------------------------
+using Batches = std::vector<std::string>;
+
+/// the batches of a recording, as the sink sent them
+// each batch is a JSON array followed by a newline; the nested objects and arrays
+// also end with a newline, so the batches are found by their nesting depth
+Batches read_batches(const std::string& path)
+{
+  std::ifstream input{path, std::ios::binary};
+  if (!input)   throw std::runtime_error{gformat("could not open '{}'", path)};
+  const std::string recording{std::istreambuf_iterator<char>{input}, std::istreambuf_iterator<char>{}};
+
+  Batches batches;
+  std::size_t batch_start = 0;
+  int depth = 0;
+  bool is_string = false, is_escape = false;
+  for (std::size_t index = 0; index < recording.size(); ++index) {
+    const char ch = recording[index];
+    if (is_string) {
+      if (is_escape)         is_escape = false;
+      else if (ch == '\\')   is_escape = true;
+      else if (ch == '"')    is_string = false;
+      continue;
+    }
+
+    switch (ch) {
+      case '"':   is_string = true; break;
+      case '[':
+      case '{':   if (depth++ == 0)   batch_start = index; break;
+      case ']':
+      case '}':
+        if (--depth == 0)   batches.emplace_back(recording, batch_start, index+1 - batch_start);
+        if (depth < 0)      throw std::runtime_error{gformat("'{}' is not a recording", path)};
+        break;
+      default:    break;
+    }
+  }
+  return batches;
+}
+
+// -----------------------------------------------------------------------------
+/// a zstd dictionary trained on the batches
+std::string train_dictionary(const Batches& batches, const std::size_t dict_size)
+{
+#if defined(GIOPLER_HAVE_ZSTD)
+  std::string samples;
+  std::vector<std::size_t> sample_sizes;
+  for (const std::string& batch : batches) {
+    samples.append(batch);
+    sample_sizes.push_back(batch.size());
+  }
+
+  std::string dictionary(dict_size, '\0');
+  const std::size_t size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), samples.data(),
+                                                 sample_sizes.data(), static_cast<unsigned>(sample_sizes.size()));
+  if (ZDICT_isError(size)) {
+    throw std::runtime_error{gformat("could not train the dictionary: {}", ZDICT_getErrorName(size))};
+  }
+  dictionary.resize(size);
+  return dictionary;
+#else
+  (void)batches; (void)dict_size;
+  throw std::runtime_error{"training a dictionary needs zstd"};
+#endif
+}
+
+// -----------------------------------------------------------------------------
+/// compress and decompress every batch, and print one line of results
+void measure(const Batches& batches, const CodecOptions& codec_options, const int repeat)
+{
+  Compressor compressor{codec_options};
+  Decompressor decompressor{codec_options._dictionary};
+  std::vector<std::uint8_t> compressed;
+  std::string decompressed;
+  std::uint64_t json_bytes = 0, compressed_bytes = 0;
+  std::chrono::steady_clock::duration compress_time{}, decompress_time{};
+
+  for (int pass = 0; pass < repeat; ++pass) {
+    for (const std::string& batch : batches) {
+      const auto start_time = std::chrono::steady_clock::now();
+      compressor.compress(batch, compressed);
+      const auto compressed_time = std::chrono::steady_clock::now();
+      const std::string_view compressed_view{reinterpret_cast<const char*>(compressed.data()), compressed.size()};
+      const bool is_valid = decompressor.decompress(codec_options._codec, compressed_view, decompressed);
+      const auto end_time = std::chrono::steady_clock::now();
+
+      if (!is_valid || decompressed != batch) {
+        throw std::runtime_error{gformat("{} did not restore a batch", giopler::sink::get_codec_name(codec_options._codec))};
+      }
+      json_bytes       += batch.size();
+      compressed_bytes += compressed.size();
+      compress_time    += compressed_time - start_time;
+      decompress_time  += end_time - compressed_time;
+    }
+  }
+
+  const double compress_secs   = std::chrono::duration<double>(compress_time).count();
+  const double decompress_secs = std::chrono::duration<double>(decompress_time).count();
+  const double batch_count     = static_cast<double>(batches.size()) * repeat;
+  std::cout << gformat("{:<10} {:>5} {:>12.0f} {:>8.2f}x {:>12.1f} {:>12.1f} {:>12.1f}\n",
+                       gformat("{}{}", giopler::sink::get_codec_name(codec_options._codec),
+                               codec_options._dictionary.empty() ? "" : "+dict"),
+                       codec_options._level,
+                       static_cast<double>(compressed_bytes) / batch_count,
+                       compressed_bytes ? static_cast<double>(json_bytes) / compressed_bytes : 0,
+                       compress_secs > 0 ? json_bytes / compress_secs / 1e6 : 0,
+                       decompress_secs > 0 ? json_bytes / decompress_secs / 1e6 : 0,
+                       compress_secs * 1e6 / batch_count);
+}
+
+// -----------------------------------------------------------------------------
+[[noreturn]] void usage()
+{
+  std::cerr << "usage: giopler_codec [--codecs <list>] [--levels <list>] [--repeat <count>] [--dict <file>]\n"
+               "                     [--train <file>] [--dict-size <bytes>] <recording>...\n";
+  std::exit(EXIT_FAILURE);
+}
+
+// -----------------------------------------------------------------------------
+Options parse_options(int argc, char** argv)
+{
+  Options options;
+
+  for (int arg = 1; arg < argc; ++arg) {
+    const std::string_view option = argv[arg];
+    auto next_value = [&]() -> std::string {
+      if (arg+1 >= argc)   usage();
+      return argv[++arg];
+    };
+    auto split = [](std::string_view list) {
+      std::vector<std::string> items;
+      while (!list.empty()) {
+        const std::size_t end = std::min(list.find(','), list.size());
+        items.emplace_back(list.substr(0, end));
+        list.remove_prefix(std::min(end+1, list.size()));
+      }
+      return items;
+    };
+
+    if (option == "--codecs") {
+      for (const std::string& name : split(next_value())) {
+        const std::optional<Codec> codec = giopler::sink::find_codec(name);
+        if (!codec)   usage();
+        if (!giopler::sink::is_codec_available(*codec)) {
+          std::cerr << gformat("giopler_codec: {} was not found when this tool was built\n", name);
+          continue;
+        }
+        options.codecs.push_back(*codec);
+      }
+    } else if (option == "--levels") {
+      options.levels.clear();
+      for (const std::string& level : split(next_value()))   options.levels.push_back(std::stoi(level));
+    }
+    else if (option == "--repeat")      options.repeat = std::stoi(next_value());
+    else if (option == "--dict")        options.dict_path = next_value();
+    else if (option == "--train")       options.train_path = next_value();
+    else if (option == "--dict-size")   options.dict_size = std::stoul(next_value());
+    else if (option.starts_with("--"))  usage();
+    else options.recordings.emplace_back(option);
+  }
+
+  if (options.codecs.empty()) {
+    for (const Codec codec : giopler::sink::g_codecs) {
+      if (giopler::sink::is_codec_available(codec))   options.codecs.push_back(codec);
+    }
+  }
+  if (options.recordings.empty() || options.levels.empty() || options.repeat < 1)   usage();
+  return options;
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  const Options options = parse_options(argc, argv);
+
+  try {
+    std::string dictionary;
+    if (!options.dict_path.empty()) {
+      dictionary = CodecOptions::read_dictionary(options.dict_path.c_str());
+      if (dictionary.empty())   return EXIT_FAILURE;
+    }
+
+    // with a trained dictionary, measure on batches it has not seen, when there are any
+    Batches batches;
+    std::size_t first_measured = 0;
+    for (const std::string& recording : options.recordings) {
+      Batches recording_batches = read_batches(recording);
+      if (!options.train_path.empty() && batches.empty() && options.recordings.size() > 1) {
+        first_measured = recording_batches.size();
+      }
+      std::move(recording_batches.begin(), recording_batches.end(), std::back_inserter(batches));
+    }
+    if (batches.empty())   throw std::runtime_error{"the recordings have no batches"};
+
+    if (!options.train_path.empty()) {
+      const Batches training{batches.begin(), batches.begin() + static_cast<std::ptrdiff_t>(
+          first_measured ? first_measured : batches.size())};
+      dictionary = train_dictionary(training, options.dict_size);
+      std::ofstream output{options.train_path, std::ios::binary};
+      output.write(dictionary.data(), static_cast<std::streamsize>(dictionary.size()));
+      if (!output)   throw std::runtime_error{gformat("could not write '{}'", options.train_path)};
+      std::cout << gformat("giopler_codec: trained a {} byte dictionary on {} batches, written to '{}'\n",
+                           dictionary.size(), training.size(), options.train_path);
+      batches.erase(batches.begin(), batches.begin() + static_cast<std::ptrdiff_t>(first_measured));
+    }
+
+    std::uint64_t json_bytes = 0;
+    for (const std::string& batch : batches)   json_bytes += batch.size();
+    std::cout << gformat("giopler_codec: {} batches, {:.0f} bytes of JSON per batch, {} passes\n\n",
+                         batches.size(), static_cast<double>(json_bytes) / batches.size(), options.repeat);
+    std::cout << gformat("{:<10} {:>5} {:>12} {:>9} {:>12} {:>12} {:>12}\n",
+                         "codec", "level", "bytes/batch", "ratio", "comp MB/s", "decomp MB/s", "us/batch");
+
+    for (const Codec codec : options.codecs) {
+      for (const int level : options.levels) {
+        measure(batches, CodecOptions{codec, level, {}}, options.repeat);
+        if (codec == Codec::Zstd && !dictionary.empty()) {
+          measure(batches, CodecOptions{codec, level, dictionary}, options.repeat);
+        }
+      }
+    }
+  } catch (const std::exception& exception) {
+    std::cerr << "giopler_codec: " << exception.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
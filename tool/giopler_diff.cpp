@@ -0,0 +1,374 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+// Compares two recorded runs, for example before and after a change.
+// Record each run by setting GIOPLER_RECORD=<file> while it runs.
+//
+// usage: giopler_diff [options] <before-recording> <after-recording>
+//   --metric <name>   counter to compare (default: dur), or "all" for every counter
+//   --total           compare the inclusive counters (prof_tot) instead of the exclusive ones (prof_self)
+//   --min-t <value>   smallest Welch t statistic reported as significant (default: 3)
+//   --top <count>     rows printed per table (default: 30)
+//   --raw             do not normalize the counters by the function workload
+//   --folded <file>   write a differential flame graph input file
+//   --phase <name>    only compare the functions that ended inside this prod::Phase
+//   --warmup          include the functions that ended inside warm-up phases (excluded by default)
+//
+// Call paths are matched by their function names, so line number changes do not break the match.
+// Each function exit is one sample of its call path. Counters are divided by the workload,
+// when the function reported one, so runs doing different amounts of work can be compared.
+// The change for each call path is tested using Welch's t statistic on the per-call values,
+// so call paths that just have noisy timings are filtered out.
+//
+// The folded file has one "<path> <before> <after>" line per call path,
+// which is the input format for: flamegraph.pl < file > diff.svg
+// The after values are rescaled to the before amount of work, so the colors
+// show the change in cost per call (or per unit of work), not the change in the amount of work.
+//
+// The recordings are streamed; memory use depends on the number of call paths, not on the run length.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "giopler/utility.hpp"
+#include "json.hpp"
+
+using namespace std::literals;
+using giopler::gformat;
+using giopler::tool::JsonValue;
+using giopler::tool::JsonReader;
+
+// -----------------------------------------------------------------------------
+/// running mean and variance (Welford's algorithm)
+struct Statistics {
+  double count = 0;
+  double mean  = 0;
+  double m2    = 0;
+  double sum   = 0;   // not normalized
+
+  void add(const double value, const double raw_value) {
+    count++;
+    const double delta = value - mean;
+    mean += delta / count;
+    m2   += delta * (value - mean);
+    sum  += raw_value;
+  }
+
+  [[nodiscard]] double variance() const {
+    return (count > 1) ? m2 / (count - 1) : 0;
+  }
+};
+
+// -----------------------------------------------------------------------------
+/// one call path in one run
+struct PathNode {
+  std::string site;         // file:line of the innermost function
+  double calls    = 0;
+  double workload = 0;
+  std::map<std::string, Statistics, std::less<>> metrics;
+};
+
+using Profile = std::map<std::string, PathNode, std::less<>>;
+
+// -----------------------------------------------------------------------------
+/// statistics for the metric in the call path, or nullptr if there are none
+const Statistics* find_statistics(const PathNode* node, std::string_view metric)
+{
+  if (!node)   return nullptr;
+  const auto iter = node->metrics.find(metric);
+  return (iter == node->metrics.end()) ? nullptr : &iter->second;
+}
+
+// -----------------------------------------------------------------------------
+struct Options {
+  std::string metric = "dur";
+  std::string counters_field = "prof_self";
+  double min_t = 3;
+  std::size_t top = 30;
+  bool normalize = true;
+  std::string folded_path;
+  std::string phase;            // empty=all phases
+  bool include_warmup = false;
+  std::string before_path;
+  std::string after_path;
+};
+
+// -----------------------------------------------------------------------------
+/// read a recording, aggregating the FunctionEnd events by call path
+Profile read_profile(const std::string& path, const Options& options)
+{
+  std::ifstream input{path, std::ios::binary};
+  if (!input) {
+    throw std::runtime_error{gformat("could not open '{}'", path)};
+  }
+
+  Profile profile;
+  JsonReader reader{input};
+  std::string call_path;
+
+  reader.for_each_record([&](const JsonValue& record) {
+    if (record.get_string("event") != "FunctionEnd")   return;
+    if (!options.phase.empty() && record.get_string("phase") != options.phase)   return;
+    if (!options.include_warmup) {
+      const JsonValue* warmup = record.find("warmup");
+      if (warmup && warmup->get_boolean())   return;
+    }
+    const JsonValue* functions = record.find("funcs");
+    if (!functions || !functions->is_array())   return;
+
+    call_path.clear();
+    for (const JsonValue& function : functions->get_array()) {
+      if (!call_path.empty())   call_path.push_back(';');
+      call_path.append(function.get_string());
+    }
+
+    auto node_iter = profile.find(call_path);
+    if (node_iter == profile.end()) {
+      node_iter = profile.emplace(call_path, PathNode{}).first;
+      node_iter->second.site = gformat("{}:{}", record.get_string("file"), record.get_number("line"));
+    }
+    PathNode& node = node_iter->second;
+
+    const double workload = record.get_number("wrkld");
+    const double divisor  = (options.normalize && workload > 0) ? workload : 1;
+    node.calls++;
+    node.workload += workload;
+
+    const JsonValue* counters = record.find(options.counters_field);
+    if (counters && counters->is_object()) {
+      for (const auto& [name, value] : counters->get_object()) {
+        if (value.is_number()) {
+          node.metrics[name].add(value.get_number() / divisor, value.get_number());
+        }
+      }
+    }
+  });
+
+  return profile;
+}
+
+// -----------------------------------------------------------------------------
+/// comparison of one metric for one call path
+struct PathDiff {
+  std::string_view path;
+  std::string_view site;
+  double calls_before = 0;
+  double calls_after  = 0;
+  double mean_before  = 0;
+  double mean_after   = 0;
+  double t_statistic  = 0;
+  double impact       = 0;   // change in the after run total
+};
+
+// -----------------------------------------------------------------------------
+/// Welch's t statistic for the difference of two means
+// infinity if both runs are exact, zero if there is not enough data
+double welch_t(const Statistics& before, const Statistics& after)
+{
+  if (before.count < 2 || after.count < 2)   return 0;
+  const double standard_error = std::sqrt(before.variance()/before.count + after.variance()/after.count);
+  const double difference     = after.mean - before.mean;
+  if (standard_error == 0) {
+    return (difference == 0) ? 0 : std::copysign(std::numeric_limits<double>::infinity(), difference);
+  }
+  return difference / standard_error;
+}
+
+// -----------------------------------------------------------------------------
+std::vector<PathDiff> compare_metric(const Profile& before, const Profile& after,
+                                     const std::string& metric, const Options& options)
+{
+  static const Statistics empty_statistics;
+  std::vector<PathDiff> diffs;
+
+  auto add_diff = [&](const std::string& path, const PathNode* node_before, const PathNode* node_after) {
+    const Statistics* stats_before = find_statistics(node_before, metric);
+    const Statistics* stats_after  = find_statistics(node_after, metric);
+    if (!stats_before && !stats_after)   return;
+    if (!stats_before)   stats_before = &empty_statistics;
+    if (!stats_after)    stats_after  = &empty_statistics;
+
+    PathDiff diff;
+    diff.path         = path;
+    diff.site         = node_after ? node_after->site : node_before->site;
+    diff.calls_before = node_before ? node_before->calls : 0;
+    diff.calls_after  = node_after  ? node_after->calls  : 0;
+    diff.mean_before  = stats_before->mean;
+    diff.mean_after   = stats_after->mean;
+
+    const bool is_new_or_gone = (stats_before->count == 0 || stats_after->count == 0);
+    diff.t_statistic  = is_new_or_gone ? std::numeric_limits<double>::infinity() : welch_t(*stats_before, *stats_after);
+    if (std::abs(diff.t_statistic) < options.min_t)   return;
+
+    diff.impact = stats_after->sum - stats_before->sum;
+    if (!is_new_or_gone) {   // compare the same amount of work
+      const double volume = node_after->workload > 0 && options.normalize ? node_after->workload : stats_after->count;
+      diff.impact = (stats_after->mean - stats_before->mean) * volume;
+    }
+    diffs.push_back(diff);
+  };
+
+  for (const auto& [path, node_before] : before) {
+    const auto node_after = after.find(path);
+    add_diff(path, &node_before, (node_after == after.end()) ? nullptr : &node_after->second);
+  }
+  for (const auto& [path, node_after] : after) {
+    if (!before.contains(path))   add_diff(path, nullptr, &node_after);
+  }
+
+  std::sort(diffs.begin(), diffs.end(), [](const PathDiff& a, const PathDiff& b) {
+    return std::abs(a.impact) > std::abs(b.impact);
+  });
+  return diffs;
+}
+
+// -----------------------------------------------------------------------------
+void print_table(const std::vector<PathDiff>& diffs, const std::string& metric, const Options& options)
+{
+  std::cout << gformat("\n{} ({}{}), {} significant call path{}\n",
+                           metric, options.counters_field, options.normalize ? ", per unit of workload" : "",
+                           diffs.size(), (diffs.size() == 1) ? "" : "s");
+  std::cout << gformat("{:>12} {:>12} {:>12} {:>8} {:>8} {:>9} {:>9}  {}\n",
+                           "impact", "before", "after", "change", "t", "calls-bef", "calls-aft", "call path (site)");
+
+  for (std::size_t row = 0; row < std::min(diffs.size(), options.top); ++row) {
+    const PathDiff& diff = diffs[row];
+    const std::string change = (diff.calls_before == 0) ? "new"s :
+                               (diff.calls_after  == 0) ? "gone"s :
+                               (diff.mean_before  == 0) ? "-"s :
+                               gformat("{:+.1f}%", 100 * (diff.mean_after - diff.mean_before) / diff.mean_before);
+    std::cout << gformat("{:>12.4g} {:>12.4g} {:>12.4g} {:>8} {:>8.3g} {:>9} {:>9}  {} ({})\n",
+                             diff.impact, diff.mean_before, diff.mean_after, change, diff.t_statistic,
+                             diff.calls_before, diff.calls_after, diff.path, diff.site);
+  }
+}
+
+// -----------------------------------------------------------------------------
+/// differential folded stacks for flamegraph.pl
+// flame graph counts must be integers, so durations are written in microseconds
+void write_folded(const Profile& before, const Profile& after, const Options& options)
+{
+  std::ofstream output{options.folded_path};
+  if (!output) {
+    throw std::runtime_error{gformat("could not create '{}'", options.folded_path)};
+  }
+
+  const double scale = (options.metric == "dur") ? 1e6 : 1;
+  auto get_counts = [&](const PathNode* node_before, const PathNode* node_after) {
+    const Statistics* stats_before = find_statistics(node_before, options.metric);
+    const Statistics* stats_after  = find_statistics(node_after, options.metric);
+
+    const double count_before = stats_before ? stats_before->sum : 0;
+    double count_after        = stats_after  ? stats_after->sum  : 0;
+    if (stats_before && stats_after) {   // after cost at the before amount of work
+      const bool by_workload = options.normalize && node_before->workload > 0 && node_after->workload > 0;
+      count_after = stats_after->mean * (by_workload ? node_before->workload : stats_before->count);
+    }
+    return std::pair{std::llround(count_before * scale), std::llround(count_after * scale)};
+  };
+
+  for (const auto& [path, node_before] : before) {
+    const auto node_after = after.find(path);
+    const auto [count_before, count_after] =
+        get_counts(&node_before, (node_after == after.end()) ? nullptr : &node_after->second);
+    output << gformat("{} {} {}\n", path, count_before, count_after);
+  }
+  for (const auto& [path, node_after] : after) {
+    if (before.contains(path))   continue;
+    const auto [count_before, count_after] = get_counts(nullptr, &node_after);
+    output << gformat("{} {} {}\n", path, count_before, count_after);
+  }
+}
+
+// -----------------------------------------------------------------------------
+[[noreturn]] void usage()
+{
+  std::cerr << "usage: giopler_diff [--metric <name>|all] [--total] [--min-t <value>] [--top <count>]\n"
+               "                    [--raw] [--folded <file>] [--phase <name>] [--warmup]\n"
+               "                    <before-recording> <after-recording>\n";
+  std::exit(EXIT_FAILURE);
+}
+
+// -----------------------------------------------------------------------------
+Options parse_options(int argc, char** argv)
+{
+  Options options;
+  std::vector<std::string> paths;
+
+  for (int arg = 1; arg < argc; ++arg) {
+    const std::string_view option = argv[arg];
+    auto next_value = [&]() -> std::string {
+      if (arg+1 >= argc)   usage();
+      return argv[++arg];
+    };
+
+    if      (option == "--metric")   options.metric = next_value();
+    else if (option == "--total")    options.counters_field = "prof_tot";
+    else if (option == "--min-t")    options.min_t = std::stod(next_value());
+    else if (option == "--top")      options.top = std::stoul(next_value());
+    else if (option == "--raw")      options.normalize = false;
+    else if (option == "--folded")   options.folded_path = next_value();
+    else if (option == "--phase")    options.phase = next_value();
+    else if (option == "--warmup")   options.include_warmup = true;
+    else if (option.starts_with("-"))   usage();
+    else paths.emplace_back(option);
+  }
+
+  if (paths.size() != 2)   usage();
+  if (!options.folded_path.empty() && options.metric == "all")   usage();
+  options.before_path = paths[0];
+  options.after_path  = paths[1];
+  return options;
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  const Options options = parse_options(argc, argv);
+
+  try {
+    const Profile before = read_profile(options.before_path, options);
+    const Profile after  = read_profile(options.after_path, options);
+
+    std::set<std::string> metrics;
+    if (options.metric == "all") {
+      for (const Profile* profile : {&before, &after}) {
+        for (const auto& [path, node] : *profile) {
+          for (const auto& [metric, statistics] : node.metrics)   metrics.insert(metric);
+        }
+      }
+    } else {
+      metrics.insert(options.metric);
+    }
+
+    std::cout << gformat("before: {} call paths, after: {} call paths\n", before.size(), after.size());
+    for (const std::string& metric : metrics) {
+      print_table(compare_metric(before, after, metric, options), metric, options);
+    }
+
+    if (!options.folded_path.empty()) {
+      write_folded(before, after, options);
+    }
+  } catch (const std::exception& exception) {
+    std::cerr << "giopler_diff: " << exception.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,666 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+// Local stand-in for the Giopler ingest server, for testing and benchmarking the event sink.
+// It accepts the same POST /api/v1/post_event requests as the real server,
+// decompresses and validates every batch, and counts the events.
+//
+// usage: giopler_ingest [options]
+//   --port <port>         port to listen on, on 127.0.0.1 (default: 3000)
+//   --tls                 use TLS with a self-signed certificate created at startup
+//   --cert <file>         write the certificate to this file (default: giopler_ingest.pem)
+//   --latency <ms>        delay every response by this many milliseconds
+//   --jitter <ms>         add a random delay of up to this many milliseconds
+//   --error-rate <ratio>  fraction of the batches rejected with an error status (default: 0)
+//   --error-status <code> HTTP status of the rejected batches (default: 503)
+//   --events <count>      exit after receiving this many events
+//   --duration <seconds>  exit after this many seconds
+//   --interval <seconds>  seconds between progress lines (default: 1, 0=none)
+//   --codecs <list>       accepted Content-Encoding values, comma separated (default: all available)
+//   --dict <file>         zstd dictionary the clients use (GIOPLER_CODEC_DICT)
+//
+// Plaintext: GIOPLER_LOCAL=1 GIOPLER_TOKEN=test ./my_program
+// TLS:       GIOPLER_SERVER_HOST=127.0.0.1 GIOPLER_SERVER_PORT=3000 GIOPLER_CA_FILE=giopler_ingest.pem ...
+//
+// Events with a "load_ts" field (nanoseconds since the epoch, added by giopler_load)
+// are also used to measure the latency from the creation of the event to its arrival.
+// A batch with a Content-Encoding that is not accepted gets 415 and the list of accepted codecs,
+// so the client changes to one of them.
+// The server stops on SIGINT or SIGTERM and prints a summary.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include "giopler/codec.hpp"
+#include "giopler/utility.hpp"
+#include "histogram.hpp"
+#include "json.hpp"
+
+using namespace std::literals;
+using giopler::gformat;
+using giopler::sink::Codec;
+using giopler::sink::Decompressor;
+using giopler::tool::JsonValue;
+using giopler::tool::JsonReader;
+using giopler::tool::LatencyHistogram;
+
+// -----------------------------------------------------------------------------
+struct Options {
+  std::uint16_t port = 3000;
+  bool tls = false;
+  std::string cert_path = "giopler_ingest.pem";
+  double latency_ms = 0;
+  double jitter_ms  = 0;
+  double error_rate = 0;
+  int error_status  = 503;
+  std::uint64_t max_events = 0;
+  double duration_secs = 0;
+  double interval_secs = 1;
+  std::vector<Codec> codecs;   // accepted, in order of preference
+  std::string dictionary;      // zstd dictionary contents
+};
+
+// -----------------------------------------------------------------------------
+/// totals for the whole run, or for one progress interval
+struct Counts {
+  std::uint64_t batches      = 0;
+  std::uint64_t events       = 0;
+  std::uint64_t body_bytes   = 0;   // compressed
+  std::uint64_t json_bytes   = 0;
+  std::uint64_t rejected     = 0;   // error status injected
+  std::uint64_t invalid      = 0;   // malformed requests or payloads
+
+  void add(const Counts& other) {
+    batches    += other.batches;
+    events     += other.events;
+    body_bytes += other.body_bytes;
+    json_bytes += other.json_bytes;
+    rejected   += other.rejected;
+    invalid    += other.invalid;
+  }
+};
+
+// -----------------------------------------------------------------------------
+/// state shared by all the connections
+struct Server {
+  Options options;
+  SSL_CTX* ssl_ctx = nullptr;
+  std::atomic<bool> stopping = false;
+  std::atomic<std::uint64_t> total_events = 0;
+
+  std::mutex mutex;                      // protects the fields below
+  Counts counts;
+  Counts interval_counts;
+  std::map<std::string, std::uint64_t, std::less<>> event_counts;
+  LatencyHistogram delivery_latency;     // event creation to arrival, in microseconds
+  LatencyHistogram processing_time;      // decompress and parse one batch, in microseconds
+  std::chrono::steady_clock::time_point first_batch_time;
+  std::chrono::steady_clock::time_point last_batch_time;
+  std::vector<int> sockets;              // open connections, shut down on exit
+  std::map<std::string, std::uint64_t, std::less<>> codec_counts;   // batches by Content-Encoding
+};
+
+// -----------------------------------------------------------------------------
+/// thread serving one connection
+struct Worker {
+  std::atomic<bool> done = false;
+  std::jthread thread;
+};
+
+std::atomic<bool> g_signaled = false;
+
+// -----------------------------------------------------------------------------
+/// self-signed certificate for 127.0.0.1 and localhost
+// the client trusts it through GIOPLER_CA_FILE
+void create_certificate(Server& server)
+{
+  EVP_PKEY* key = EVP_EC_gen("P-256");
+  X509* cert    = X509_new();
+  if (!key || !cert)   throw std::runtime_error{"could not create the TLS key"};
+
+  X509_set_version(cert, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), static_cast<long>(std::random_device{}() & 0x7fffffff));
+  X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 30L*24*3600);
+  X509_set_pubkey(cert, key);
+
+  X509_NAME* name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("giopler_ingest"), -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+
+  X509V3_CTX v3_ctx;
+  X509V3_set_ctx_nodb(&v3_ctx);
+  X509V3_set_ctx(&v3_ctx, cert, cert, nullptr, nullptr, 0);
+  for (const auto& [nid, value] : {std::pair{NID_basic_constraints, "critical,CA:TRUE"},
+                                   std::pair{NID_subject_alt_name,  "IP:127.0.0.1,DNS:localhost"}}) {
+    X509_EXTENSION* extension = X509V3_EXT_conf_nid(nullptr, &v3_ctx, nid, value);
+    if (!extension)   throw std::runtime_error{"could not create the certificate extensions"};
+    X509_add_ext(cert, extension, -1);
+    X509_EXTENSION_free(extension);
+  }
+
+  if (!X509_sign(cert, key, EVP_sha256()))   throw std::runtime_error{"could not sign the certificate"};
+
+  FILE* cert_file = std::fopen(server.options.cert_path.c_str(), "w");
+  if (!cert_file)   throw std::runtime_error{gformat("could not create '{}'", server.options.cert_path)};
+  PEM_write_X509(cert_file, cert);
+  std::fclose(cert_file);
+
+  server.ssl_ctx = SSL_CTX_new(TLS_server_method());
+  if (!server.ssl_ctx || SSL_CTX_use_certificate(server.ssl_ctx, cert) != 1 ||
+      SSL_CTX_use_PrivateKey(server.ssl_ctx, key) != 1) {
+    ERR_print_errors_fp(stderr);
+    throw std::runtime_error{"could not set up TLS"};
+  }
+
+  X509_free(cert);
+  EVP_PKEY_free(key);
+}
+
+// -----------------------------------------------------------------------------
+/// one client connection, plaintext or TLS
+class Connection final
+{
+ public:
+  Connection(const int socket, SSL_CTX* ssl_ctx)
+  : _socket{socket}
+  {
+    if (ssl_ctx) {
+      _ssl = SSL_new(ssl_ctx);
+      SSL_set_fd(_ssl, _socket);
+    }
+  }
+
+  ~Connection() {
+    if (_ssl) {
+      SSL_shutdown(_ssl);
+      SSL_free(_ssl);
+    }
+  }
+
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+
+  bool handshake() {
+    return !_ssl || SSL_accept(_ssl) == 1;
+  }
+
+  /// append the bytes received to the buffer; false on end of stream or error
+  bool read(std::string& buffer) {
+    char data[64*1024];
+    const long bytes = _ssl ? SSL_read(_ssl, data, sizeof(data)) : ::read(_socket, data, sizeof(data));
+    if (bytes <= 0)   return false;
+    buffer.append(data, static_cast<std::size_t>(bytes));
+    return true;
+  }
+
+  /// the response is written in a single call, because the client reads it with a single call
+  bool write(std::string_view data) {
+    const long bytes = _ssl ? SSL_write(_ssl, data.data(), static_cast<int>(data.size()))
+                            : ::write(_socket, data.data(), data.size());
+    return bytes == static_cast<long>(data.size());
+  }
+
+ private:
+  int _socket;
+  SSL* _ssl = nullptr;
+};
+
+// -----------------------------------------------------------------------------
+/// parsed request headers
+struct Request {
+  std::string method;
+  std::string path;
+  std::string authorization;
+  std::string content_encoding = "gzip";   // the clients before the codecs were added did not send it
+  std::size_t content_length = 0;
+  bool keep_alive = true;
+};
+
+// -----------------------------------------------------------------------------
+std::string to_lower(std::string_view text)
+{
+  std::string lower{text};
+  std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char ch) { return std::tolower(ch); });
+  return lower;
+}
+
+// -----------------------------------------------------------------------------
+Request parse_request(std::string_view headers)
+{
+  Request request;
+  std::size_t line_end = headers.find("\r\n");
+  const std::string_view request_line = headers.substr(0, line_end);
+  const std::size_t method_end = request_line.find(' ');
+  const std::size_t path_end   = request_line.find(' ', method_end+1);
+  if (method_end != std::string_view::npos && path_end != std::string_view::npos) {
+    request.method = request_line.substr(0, method_end);
+    request.path   = request_line.substr(method_end+1, path_end-method_end-1);
+  }
+
+  while (line_end != std::string_view::npos && line_end+2 < headers.size()) {
+    const std::size_t line_start = line_end+2;
+    line_end = headers.find("\r\n", line_start);
+    const std::string_view line = headers.substr(line_start, line_end-line_start);
+    const std::size_t colon = line.find(':');
+    if (colon == std::string_view::npos)   continue;
+    const std::string name = to_lower(line.substr(0, colon));
+    std::string_view value = line.substr(colon+1);
+    while (!value.empty() && value.front() == ' ')   value.remove_prefix(1);
+
+    if      (name == "content-length")   request.content_length = std::stoul(std::string{value});
+    else if (name == "authorization")    request.authorization = value;
+    else if (name == "content-encoding") request.content_encoding = to_lower(value);
+    else if (name == "connection")       request.keep_alive = (to_lower(value) != "close");
+  }
+
+  return request;
+}
+
+// -----------------------------------------------------------------------------
+/// the accepted codec named by the Content-Encoding of the request, if any
+std::optional<Codec> find_accepted_codec(const Server& server, std::string_view content_encoding)
+{
+  const std::optional<Codec> codec = giopler::sink::find_codec(content_encoding);
+  if (codec && std::ranges::find(server.options.codecs, *codec) != server.options.codecs.end())   return codec;
+  return std::nullopt;
+}
+
+// -----------------------------------------------------------------------------
+/// decompress and check one batch of events; false if it is malformed
+// every event must be an object with the common event fields
+bool process_batch(Server& server, Decompressor& decompressor, const Codec codec,
+                   std::string_view body, std::string& json, Counts& counts)
+{
+  if (!decompressor.decompress(codec, body, json))   return false;
+
+  const std::uint64_t now_ns = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+  std::map<std::string, std::uint64_t, std::less<>> event_counts;
+  LatencyHistogram delivery_latency;
+  std::uint64_t events = 0;
+
+  try {
+    std::istringstream input{json};
+    JsonReader reader{input};
+    bool is_valid = true;
+    reader.for_each_record([&](const JsonValue& record) {
+      const std::string_view event = record.get_string("event");
+      if (!record.is_object() || event.empty() || record.get_string("run_id").empty()) {
+        is_valid = false;
+        return;
+      }
+      event_counts[std::string{event}]++;
+      events++;
+
+      const double load_ts = record.get_number("load_ts");
+      if (load_ts > 0) {
+        const auto created_ns = static_cast<std::uint64_t>(load_ts);
+        delivery_latency.add(now_ns > created_ns ? (now_ns - created_ns) / 1000 : 0);
+      }
+    });
+    if (!is_valid || events == 0)   return false;
+  } catch (const std::exception&) {
+    return false;
+  }
+
+  counts.batches++;
+  counts.events     += events;
+  counts.body_bytes += body.size();
+  counts.json_bytes += json.size();
+
+  const std::lock_guard<std::mutex> lock{server.mutex};
+  for (const auto& [event, count] : event_counts)   server.event_counts[event] += count;
+  server.delivery_latency.merge(delivery_latency);
+  server.codec_counts[std::string{giopler::sink::get_codec_name(codec)}]++;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+/// a 415 response lists the accepted codecs (RFC 7694)
+std::string get_response(const int status, const bool keep_alive, std::string_view accepted_codecs)
+{
+  std::string_view reason = "Error"sv;
+  switch (status) {
+    case 201: reason = "Created"sv; break;
+    case 400: reason = "Bad Request"sv; break;
+    case 401: reason = "Unauthorized"sv; break;
+    case 404: reason = "Not Found"sv; break;
+    case 415: reason = "Unsupported Media Type"sv; break;
+    case 429: reason = "Too Many Requests"sv; break;
+    case 500: reason = "Internal Server Error"sv; break;
+    case 503: reason = "Service Unavailable"sv; break;
+    default: break;
+  }
+
+  const std::string accept_encoding = (status == 415) ? gformat("Accept-Encoding: {}\r\n", accepted_codecs) : "";
+  return gformat("HTTP/1.1 {} {}\r\n"
+                 "Content-Type: application/json\r\n"
+                 "Content-Length: 2\r\n"
+                 "{}"
+                 "Connection: {}\r\n\r\n{{}}",
+                 status, reason, accept_encoding, keep_alive ? "keep-alive" : "close");
+}
+
+// -----------------------------------------------------------------------------
+/// serve the requests of one connection until the client closes it
+void serve_requests(Server& server, const int socket)
+{
+  Connection connection{socket, server.ssl_ctx};
+  if (!connection.handshake()) {
+    ERR_print_errors_fp(stderr);
+    return;
+  }
+
+  std::mt19937_64 random{std::random_device{}()};
+  std::uniform_real_distribution<double> uniform{0, 1};
+  std::string buffer;
+  std::string json;
+  Decompressor decompressor{server.options.dictionary};
+  std::string accepted_codecs;
+  for (const Codec codec : server.options.codecs) {
+    if (!accepted_codecs.empty())   accepted_codecs.append(", ");
+    accepted_codecs.append(giopler::sink::get_codec_name(codec));
+  }
+
+  while (!server.stopping) {
+    // read the headers
+    std::size_t headers_end;
+    while ((headers_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+      if (!connection.read(buffer))   return;
+    }
+    const Request request = parse_request(std::string_view{buffer}.substr(0, headers_end));
+    const std::size_t body_start = headers_end + 4;
+
+    // read the body
+    while (buffer.size() < body_start + request.content_length) {
+      if (!connection.read(buffer))   return;
+    }
+    const std::string_view body = std::string_view{buffer}.substr(body_start, request.content_length);
+
+    const auto start_time = std::chrono::steady_clock::now();
+    const std::optional<Codec> codec = find_accepted_codec(server, request.content_encoding);
+    Counts counts;
+    int status = 201;
+    if (request.method != "POST" || request.path != "/api/v1/post_event") {
+      status = 404;
+      counts.invalid++;
+    } else if (!request.authorization.starts_with("Bearer ") || request.authorization.size() <= 7) {
+      status = 401;
+      counts.invalid++;
+    } else if (server.options.error_rate > 0 && uniform(random) < server.options.error_rate) {
+      status = server.options.error_status;
+      counts.rejected++;
+    } else if (!codec) {
+      status = 415;
+      counts.invalid++;
+    } else if (!process_batch(server, decompressor, *codec, body, json, counts)) {
+      status = 400;
+      counts.invalid++;
+    }
+    const auto end_time = std::chrono::steady_clock::now();
+
+    {
+      const std::lock_guard<std::mutex> lock{server.mutex};
+      if (server.counts.batches == 0 && counts.batches)   server.first_batch_time = start_time;
+      if (counts.batches)   server.last_batch_time = end_time;
+      server.counts.add(counts);
+      server.interval_counts.add(counts);
+      server.processing_time.add(static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count()));
+    }
+    server.total_events += counts.events;
+
+    const double delay_ms = server.options.latency_ms + server.options.jitter_ms * uniform(random);
+    if (delay_ms > 0)   std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(delay_ms));
+
+    if (!connection.write(get_response(status, request.keep_alive, accepted_codecs)) || !request.keep_alive)   return;
+    buffer.erase(0, body_start + request.content_length);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void serve_connection(Server& server, const int socket, Worker& worker)
+{
+  serve_requests(server, socket);
+  {
+    const std::lock_guard<std::mutex> lock{server.mutex};
+    std::erase(server.sockets, socket);
+  }
+  close(socket);
+  worker.done = true;
+}
+
+// -----------------------------------------------------------------------------
+int open_listener(const std::uint16_t port)
+{
+  const int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener < 0)   throw std::runtime_error{gformat("socket: {}", std::strerror(errno))};
+
+  const int reuse = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in address{};
+  address.sin_family      = AF_INET;
+  address.sin_port        = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listener, 64) < 0) {
+    throw std::runtime_error{gformat("could not listen on port {}: {}", port, std::strerror(errno))};
+  }
+  return listener;
+}
+
+// -----------------------------------------------------------------------------
+void print_progress(Server& server, const double interval_secs)
+{
+  Counts counts;
+  {
+    const std::lock_guard<std::mutex> lock{server.mutex};
+    counts = server.interval_counts;
+    server.interval_counts = Counts{};
+  }
+  if (!counts.batches && !counts.rejected && !counts.invalid)   return;
+
+  std::cout << gformat("giopler_ingest: {:.0f} events/s  {:.1f} batches/s  {:.2f} MB/s compressed  {:.2f} MB/s JSON"
+                       "  rejected {}  invalid {}\n",
+                       counts.events / interval_secs, counts.batches / interval_secs,
+                       counts.body_bytes / interval_secs / 1e6, counts.json_bytes / interval_secs / 1e6,
+                       counts.rejected, counts.invalid);
+}
+
+// -----------------------------------------------------------------------------
+void print_summary(Server& server)
+{
+  const std::lock_guard<std::mutex> lock{server.mutex};
+  const Counts& counts = server.counts;
+  const double secs = std::chrono::duration<double>(server.last_batch_time - server.first_batch_time).count();
+
+  std::cout << gformat("\ngiopler_ingest: {} events in {} batches over {:.3f} seconds\n",
+                       counts.events, counts.batches, secs);
+  if (secs > 0) {
+    std::cout << gformat("  throughput       {:.0f} events/s  {:.2f} MB/s compressed  {:.2f} MB/s JSON\n",
+                         counts.events / secs, counts.body_bytes / secs / 1e6, counts.json_bytes / secs / 1e6);
+  }
+  if (counts.batches) {
+    std::cout << gformat("  batch size       {:.0f} events  {:.0f} bytes compressed  {:.0f} bytes JSON ({:.1f}x)\n",
+                         static_cast<double>(counts.events) / counts.batches,
+                         static_cast<double>(counts.body_bytes) / counts.batches,
+                         static_cast<double>(counts.json_bytes) / counts.batches,
+                         counts.body_bytes ? static_cast<double>(counts.json_bytes) / counts.body_bytes : 0);
+  }
+  std::cout << gformat("  rejected         {} batches (injected errors)\n", counts.rejected);
+  std::cout << gformat("  invalid          {} requests\n", counts.invalid);
+  if (server.processing_time.get_count()) {
+    std::cout << gformat("  processing (us)  {}\n", server.processing_time.format());
+  }
+  if (server.delivery_latency.get_count()) {
+    std::cout << gformat("  delivery (ms)    {}\n", server.delivery_latency.format(1000));
+  }
+  for (const auto& [codec, count] : server.codec_counts) {
+    std::cout << gformat("  codec {:<10} {} batches\n", codec, count);
+  }
+  for (const auto& [event, count] : server.event_counts) {
+    std::cout << gformat("  {:<16} {}\n", event, count);
+  }
+}
+
+// -----------------------------------------------------------------------------
+[[noreturn]] void usage()
+{
+  std::cerr << "usage: giopler_ingest [--port <port>] [--tls] [--cert <file>] [--latency <ms>] [--jitter <ms>]\n"
+               "                      [--error-rate <ratio>] [--error-status <code>] [--events <count>]\n"
+               "                      [--duration <seconds>] [--interval <seconds>] [--codecs <list>] [--dict <file>]\n";
+  std::exit(EXIT_FAILURE);
+}
+
+// -----------------------------------------------------------------------------
+/// "gzip,zstd"; the codecs that were not compiled in are ignored
+std::vector<Codec> parse_codecs(std::string_view list)
+{
+  std::vector<Codec> codecs;
+  while (!list.empty()) {
+    const std::size_t end = std::min(list.find(','), list.size());
+    const std::optional<Codec> codec = giopler::sink::find_codec(list.substr(0, end));
+    if (!codec)   usage();
+    if (giopler::sink::is_codec_available(*codec))   codecs.push_back(*codec);
+    list.remove_prefix(std::min(end+1, list.size()));
+  }
+  if (codecs.empty())   usage();
+  return codecs;
+}
+
+// -----------------------------------------------------------------------------
+Options parse_options(int argc, char** argv)
+{
+  Options options;
+
+  for (int arg = 1; arg < argc; ++arg) {
+    const std::string_view option = argv[arg];
+    auto next_value = [&]() -> std::string {
+      if (arg+1 >= argc)   usage();
+      return argv[++arg];
+    };
+
+    if      (option == "--port")           options.port = static_cast<std::uint16_t>(std::stoul(next_value()));
+    else if (option == "--tls")            options.tls = true;
+    else if (option == "--cert")           options.cert_path = next_value();
+    else if (option == "--latency")        options.latency_ms = std::stod(next_value());
+    else if (option == "--jitter")         options.jitter_ms = std::stod(next_value());
+    else if (option == "--error-rate")     options.error_rate = std::stod(next_value());
+    else if (option == "--error-status")   options.error_status = std::stoi(next_value());
+    else if (option == "--events")         options.max_events = std::stoull(next_value());
+    else if (option == "--duration")       options.duration_secs = std::stod(next_value());
+    else if (option == "--interval")       options.interval_secs = std::stod(next_value());
+    else if (option == "--codecs")         options.codecs = parse_codecs(next_value());
+    else if (option == "--dict")           options.dictionary = giopler::sink::CodecOptions::read_dictionary(next_value().c_str());
+    else usage();
+  }
+
+  if (options.codecs.empty()) {
+    for (const Codec codec : giopler::sink::g_codecs) {
+      if (giopler::sink::is_codec_available(codec))   options.codecs.push_back(codec);
+    }
+  }
+
+  return options;
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  Server server;
+  server.options = parse_options(argc, argv);
+  std::signal(SIGINT,  [](int) { g_signaled = true; });
+  std::signal(SIGTERM, [](int) { g_signaled = true; });
+  std::signal(SIGPIPE, SIG_IGN);   // clients may disconnect at any time
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  try {
+    if (server.options.tls)   create_certificate(server);
+    const int listener = open_listener(server.options.port);
+    std::cout << gformat("giopler_ingest: listening on 127.0.0.1:{} ({}{})\n", server.options.port,
+                         server.options.tls ? "TLS, certificate in " : "plaintext",
+                         server.options.tls ? server.options.cert_path : "");
+
+    const auto start_time = std::chrono::steady_clock::now();
+    auto progress_time    = start_time;
+    while (!g_signaled) {
+      pollfd poll_fd{listener, POLLIN, 0};
+      if (poll(&poll_fd, 1, 100) > 0) {
+        const int socket = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (socket >= 0) {
+          const int no_delay = 1;
+          setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+          {
+            const std::lock_guard<std::mutex> lock{server.mutex};
+            server.sockets.push_back(socket);
+          }
+          Worker& worker = *workers.emplace_back(std::make_unique<Worker>());
+          worker.thread  = std::jthread{serve_connection, std::ref(server), socket, std::ref(worker)};
+        }
+      }
+      std::erase_if(workers, [](const auto& worker) { return worker->done.load(); });   // joins the threads
+
+      const auto now = std::chrono::steady_clock::now();
+      if (server.options.interval_secs > 0 && now - progress_time >= std::chrono::duration<double>(server.options.interval_secs)) {
+        print_progress(server, std::chrono::duration<double>(now - progress_time).count());
+        progress_time = now;
+      }
+      if (server.options.max_events && server.total_events >= server.options.max_events)   break;
+      if (server.options.duration_secs > 0 && now - start_time >= std::chrono::duration<double>(server.options.duration_secs))   break;
+    }
+
+    // wake up the connections waiting for requests
+    server.stopping = true;
+    close(listener);
+    {
+      const std::lock_guard<std::mutex> lock{server.mutex};
+      for (const int socket : server.sockets)   shutdown(socket, SHUT_RDWR);
+    }
+    workers.clear();   // joins the connection threads
+
+    print_summary(server);
+  } catch (const std::exception& exception) {
+    std::cerr << "giopler_ingest: " << exception.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  if (server.ssl_ctx)   SSL_CTX_free(server.ssl_ctx);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,415 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+// Drives the event sink at a controlled rate, without a real application.
+// The events go through the same SinkManager as the events of an instrumented program,
+// so the destination is chosen with the usual environment variables.
+//
+// usage: giopler_load [options]
+//   --rate <events/s>     total events per second, over all the threads (default: 10000, 0=no limit)
+//   --threads <count>     threads creating events (default: 1)
+//   --duration <seconds>  how long to create events for (default: 10)
+//   --events <count>      total events to create, instead of a duration
+//   --burst <count>       events created back to back, then a pause to keep the rate (default: 1)
+//   --mix <kind=weight>   comma separated event mix (default: function=6,message=3,trace=1)
+//                         kinds: function (a begin and end pair), message, trace, contract
+//   --message-bytes <n>   length of the message text (default: 64)
+//   --replay <recording>  send the events of a recording (GIOPLER_RECORD) instead of synthesized ones
+//   --loops <count>       times to replay the recording (default: 1)
+//
+// End to end benchmark, with the stand-in server in another terminal:
+//   giopler_ingest --latency 20 --error-rate 0.01
+//   GIOPLER_LOCAL=1 GIOPLER_TOKEN=test GIOPLER_QUIET=1 giopler_load --rate 50000 --threads 4
+//
+// Every event gets a "load_ts" field with its creation time, in nanoseconds since the epoch,
+// which giopler_ingest uses to measure the delivery latency.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "giopler/giopler.hpp"
+#include "histogram.hpp"
+#include "json.hpp"
+
+using namespace std::literals;
+using giopler::gformat;
+using giopler::Record;
+using giopler::RecordValue;
+using giopler::tool::JsonValue;
+using giopler::tool::JsonReader;
+using giopler::tool::LatencyHistogram;
+
+// -----------------------------------------------------------------------------
+enum class Kind {Function, Message, Trace, Contract};
+
+// -----------------------------------------------------------------------------
+struct Options {
+  double rate = 10000;
+  int threads = 1;
+  double duration_secs = 10;
+  std::uint64_t events = 0;
+  int burst = 1;
+  std::vector<std::pair<Kind, double>> mix{{Kind::Function, 6}, {Kind::Message, 3}, {Kind::Trace, 1}};
+  std::size_t message_bytes = 64;
+  std::string replay_path;
+  int loops = 1;
+};
+
+// -----------------------------------------------------------------------------
+/// results of one thread
+struct ThreadResult {
+  std::uint64_t events = 0;
+  LatencyHistogram enqueue_time;   // create and queue one event, in nanoseconds
+  double max_lag_secs = 0;         // how far the thread fell behind the schedule
+};
+
+// -----------------------------------------------------------------------------
+std::int64_t now_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// -----------------------------------------------------------------------------
+/// convert a recorded value back into a record value
+RecordValue to_record_value(const JsonValue& value)
+{
+  switch (value.get_type()) {
+    case JsonValue::Type::Boolean:
+      return RecordValue{value.get_boolean()};
+
+    case JsonValue::Type::Number: {
+      const double number = value.get_number();
+      if (number == std::trunc(number) && std::abs(number) < 9.0e15) {
+        return RecordValue{static_cast<std::int64_t>(number)};
+      }
+      return RecordValue{number};
+    }
+
+    case JsonValue::Type::String:
+      return RecordValue{value.get_string()};
+
+    case JsonValue::Type::Array: {
+      auto array = giopler::make_arena_shared<giopler::Array>();
+      for (const JsonValue& element : value.get_array()) {
+        array->push_back(to_record_value(element));
+      }
+      return RecordValue{array};
+    }
+
+    case JsonValue::Type::Object: {
+      auto record = giopler::make_arena_shared<Record>();
+      for (const auto& [name, field] : value.get_object()) {
+        if (field.get_type() != JsonValue::Type::Null)   record->insert_or_assign(name, to_record_value(field));
+      }
+      return RecordValue{record};
+    }
+
+    case JsonValue::Type::Null:
+      break;
+  }
+  return RecordValue{""sv};
+}
+
+// -----------------------------------------------------------------------------
+/// read every event of a recording into memory
+std::vector<std::shared_ptr<Record>> read_recording(const std::string& path)
+{
+  std::ifstream input{path, std::ios::binary};
+  if (!input) {
+    throw std::runtime_error{gformat("could not open '{}'", path)};
+  }
+
+  std::vector<std::shared_ptr<Record>> records;
+  JsonReader reader{input};
+  reader.for_each_record([&](const JsonValue& value) {
+    if (value.is_object())   records.push_back(to_record_value(value).get_record());
+  });
+
+  if (records.empty()) {
+    throw std::runtime_error{gformat("no events found in '{}'", path)};
+  }
+  return records;
+}
+
+// -----------------------------------------------------------------------------
+/// counters with plausible values, as in the Prof build mode
+std::shared_ptr<Record> get_counters_record(std::mt19937_64& random)
+{
+  std::uniform_real_distribution<double> uniform{0.5, 1.5};
+  const double duration = 20e-6 * uniform(random);
+  const auto cycles     = static_cast<std::int64_t>(duration * 3e9);
+  return giopler::make_arena_shared<Record>(Record{
+      {"dur"s,            duration},
+      {"sw_cpu_clck"s,    duration},
+      {"sw_task_clck"s,   duration},
+      {"sw_pg_fault"s,    std::int64_t{0}},
+      {"sw_cntxt_swtch"s, std::int64_t{0}},
+      {"hw_cpu_cycl"s,    cycles},
+      {"hw_instr"s,       static_cast<std::int64_t>(cycles * 1.8 * uniform(random))},
+      {"hw_cache_ref"s,   cycles / 40},
+      {"hw_cache_miss"s,  cycles / 400},
+      {"hw_brnch_instr"s, cycles / 6},
+      {"hw_brnch_miss"s,  cycles / 300}
+  });
+}
+
+// -----------------------------------------------------------------------------
+/// creates synthesized events of the requested mix
+// the records are built the same way the library builds them, so the cost is representative
+class EventSource final
+{
+ public:
+  EventSource(const Options& options, const int thread)
+  : _random{static_cast<std::uint64_t>(thread) * 0x9e3779b97f4a7c15ULL + 1},
+    _message(options.message_bytes, 'x')
+  {
+    std::vector<double> weights;
+    for (const auto& [kind, weight] : options.mix) {
+      _kinds.push_back(kind);
+      weights.push_back(weight);
+    }
+    _kind_distribution = std::discrete_distribution<std::size_t>{weights.begin(), weights.end()};
+  }
+
+  /// true if the next event is the end of a function
+  [[nodiscard]] bool is_function_open() const { return _function_end_id.has_value(); }
+
+  /// create the next event; a function creates its end event on the following call
+  std::shared_ptr<Record> next(const giopler::source_location& location = giopler::source_location::current()) {
+    using giopler::EventCategory;
+    using giopler::Event;
+
+    if (_function_end_id) {
+      auto record = giopler::get_event_record(location, EventCategory::Profile, Event::FunctionEnd, *_function_end_id);
+      record->insert_or_assign("other_id"s, _function_begin_id->get_string());
+      record->insert_or_assign("is_leaf"s, true);
+      record->insert({{"prof_tot"s,  get_counters_record(_random)}});
+      record->insert({{"prof_self"s, get_counters_record(_random)}});
+      _function_end_id.reset();
+      return record;
+    }
+
+    switch (_kinds[_kind_distribution(_random)]) {
+      case Kind::Function: {
+        _function_begin_id.emplace();
+        _function_end_id.emplace();
+        auto record = giopler::get_event_record(location, EventCategory::Profile, Event::FunctionBegin, *_function_begin_id);
+        record->insert_or_assign("other_id"s, _function_end_id->get_string());
+        return record;
+      }
+
+      case Kind::Message: {
+        auto record = giopler::get_event_record(location, EventCategory::Log, Event::Message, giopler::UUID());
+        record->insert_or_assign("msg"s, _message);
+        return record;
+      }
+
+      case Kind::Trace: {
+        auto record = giopler::get_event_record(location, EventCategory::Trace, Event::Line, giopler::UUID());
+        record->insert_or_assign("msg"s, _message.substr(0, 16));
+        return record;
+      }
+
+      case Kind::Contract: {
+        auto record = giopler::get_event_record(location, EventCategory::Contract, Event::Argument, giopler::UUID());
+        record->insert_or_assign("status"s, "Passed");
+        return record;
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  std::mt19937_64 _random;
+  std::string _message;
+  std::vector<Kind> _kinds;
+  std::discrete_distribution<std::size_t> _kind_distribution;
+  std::optional<giopler::UUID> _function_begin_id;
+  std::optional<giopler::UUID> _function_end_id;
+};
+
+// -----------------------------------------------------------------------------
+/// create and queue the events of one thread
+// the events are created on a fixed schedule; a thread that falls behind catches up
+// by creating events back to back, the same as a program recovering from a stall
+void run_thread(const Options& options, const int thread, const std::uint64_t event_count,
+                const std::vector<std::shared_ptr<Record>>& replay, ThreadResult& result)
+{
+  EventSource source{options, thread};
+  const double thread_rate = options.rate / options.threads;
+  const auto burst_interval = std::chrono::duration<double>(thread_rate > 0 ? options.burst / thread_rate : 0);
+  const auto start_time = std::chrono::steady_clock::now();
+  const auto end_time   = start_time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                           std::chrono::duration<double>(options.duration_secs));
+  std::size_t replay_index = static_cast<std::size_t>(thread);
+
+  for (std::uint64_t burst = 0; ; ++burst) {
+    const auto burst_time = start_time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(burst * burst_interval);
+    auto now = std::chrono::steady_clock::now();
+    if (burst_time > now) {
+      std::this_thread::sleep_until(burst_time);
+    } else {
+      result.max_lag_secs = std::max(result.max_lag_secs, std::chrono::duration<double>(now - burst_time).count());
+    }
+    if (!event_count && burst_time >= end_time) {
+      if (source.is_function_open()) {   // do not leave a function without its end event
+        giopler::sink::g_sink_manager.write_record(source.next());
+        result.events++;
+      }
+      break;
+    }
+
+    for (int index = 0; index < options.burst; ++index) {
+      if (event_count && result.events >= event_count)   return;
+
+      const auto enqueue_start = std::chrono::steady_clock::now();
+      std::shared_ptr<Record> record;
+      if (replay.empty()) {
+        record = source.next();
+      } else {
+        record = giopler::make_arena_shared<Record>(*replay[replay_index % replay.size()]);
+        replay_index += static_cast<std::size_t>(options.threads);
+      }
+      record->insert_or_assign("load_ts"s, now_ns());
+      giopler::sink::g_sink_manager.write_record(record);
+      result.enqueue_time.add(static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - enqueue_start).count()));
+      result.events++;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+[[noreturn]] void usage()
+{
+  std::cerr << "usage: giopler_load [--rate <events/s>] [--threads <count>] [--duration <seconds>] [--events <count>]\n"
+               "                    [--burst <count>] [--mix <kind=weight,...>] [--message-bytes <n>]\n"
+               "                    [--replay <recording>] [--loops <count>]\n";
+  std::exit(EXIT_FAILURE);
+}
+
+// -----------------------------------------------------------------------------
+std::vector<std::pair<Kind, double>> parse_mix(std::string_view text)
+{
+  std::vector<std::pair<Kind, double>> mix;
+  while (!text.empty()) {
+    const std::size_t comma = text.find(',');
+    const std::string_view item = text.substr(0, comma);
+    text = (comma == std::string_view::npos) ? std::string_view{} : text.substr(comma+1);
+
+    const std::size_t equals = item.find('=');
+    const std::string_view name = item.substr(0, equals);
+    const double weight = (equals == std::string_view::npos) ? 1 : std::stod(std::string{item.substr(equals+1)});
+
+    if      (name == "function")   mix.emplace_back(Kind::Function, weight);
+    else if (name == "message")    mix.emplace_back(Kind::Message, weight);
+    else if (name == "trace")      mix.emplace_back(Kind::Trace, weight);
+    else if (name == "contract")   mix.emplace_back(Kind::Contract, weight);
+    else usage();
+  }
+  if (mix.empty())   usage();
+  return mix;
+}
+
+// -----------------------------------------------------------------------------
+Options parse_options(int argc, char** argv)
+{
+  Options options;
+
+  for (int arg = 1; arg < argc; ++arg) {
+    const std::string_view option = argv[arg];
+    auto next_value = [&]() -> std::string {
+      if (arg+1 >= argc)   usage();
+      return argv[++arg];
+    };
+
+    if      (option == "--rate")            options.rate = std::stod(next_value());
+    else if (option == "--threads")         options.threads = std::stoi(next_value());
+    else if (option == "--duration")        options.duration_secs = std::stod(next_value());
+    else if (option == "--events")          options.events = std::stoull(next_value());
+    else if (option == "--burst")           options.burst = std::stoi(next_value());
+    else if (option == "--mix")             options.mix = parse_mix(next_value());
+    else if (option == "--message-bytes")   options.message_bytes = std::stoul(next_value());
+    else if (option == "--replay")          options.replay_path = next_value();
+    else if (option == "--loops")           options.loops = std::stoi(next_value());
+    else usage();
+  }
+
+  if (options.threads < 1 || options.burst < 1 || options.loops < 1)   usage();
+  return options;
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  Options options = parse_options(argc, argv);
+
+  try {
+    std::vector<std::shared_ptr<Record>> replay;
+    if (!options.replay_path.empty()) {
+      replay = read_recording(options.replay_path);
+      options.events = replay.size() * static_cast<std::uint64_t>(options.loops);
+      std::cout << gformat("giopler_load: replaying {} events from '{}'\n", replay.size(), options.replay_path);
+    }
+
+    std::vector<ThreadResult> results(static_cast<std::size_t>(options.threads));
+    const auto start_time = std::chrono::steady_clock::now();
+    {
+      std::vector<std::jthread> threads;
+      for (int thread = 0; thread < options.threads; ++thread) {
+        // spread the events evenly, the first threads take the remainder
+        const auto threads_count = static_cast<std::uint64_t>(options.threads);
+        const std::uint64_t thread_events = options.events ?
+            options.events / threads_count + (static_cast<std::uint64_t>(thread) < options.events % threads_count) : 0;
+        threads.emplace_back(run_thread, std::cref(options), thread, thread_events, std::cref(replay),
+                             std::ref(results[static_cast<std::size_t>(thread)]));
+      }
+    }
+    const double create_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    ThreadResult total;
+    for (const ThreadResult& result : results) {
+      total.events += result.events;
+      total.enqueue_time.merge(result.enqueue_time);
+      total.max_lag_secs = std::max(total.max_lag_secs, result.max_lag_secs);
+    }
+
+    std::cout << gformat("giopler_load: created {} events in {:.3f} seconds ({:.0f} events/s, target {})\n",
+                         total.events, create_secs, total.events / create_secs,
+                         options.rate > 0 ? gformat("{:.0f}", options.rate) : "unlimited"s);
+    std::cout << gformat("  enqueue (ns)     {}\n", total.enqueue_time.format());
+    if (options.rate > 0) {
+      std::cout << gformat("  max lag          {:.3f} seconds behind schedule\n", total.max_lag_secs);
+    }
+
+    const auto flush_start = std::chrono::steady_clock::now();
+    giopler::sink::g_sink_manager.flush();
+    std::cout << gformat("  drain            {:.0f} seconds to take the queued events (one second resolution)\n",
+                         std::chrono::duration<double>(std::chrono::steady_clock::now() - flush_start).count());
+  } catch (const std::exception& exception) {
+    std::cerr << "giopler_load: " << exception.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
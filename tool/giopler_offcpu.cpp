@@ -0,0 +1,206 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+// Summarizes where a recorded run spent its time off the CPU.
+// Record the run in Prof mode with GIOPLER_OFF_CPU=1 and GIOPLER_RECORD=<file>.
+//
+// usage: giopler_offcpu [options] <recording>
+//   --preempted       include the time spent waiting for a CPU after being preempted
+//   --per-thread      keep the threads apart, using the thread as the root of each call path
+//   --top <count>     rows printed per table (default: 30)
+//   --folded <file>   write an off-CPU flame graph input file
+//
+// By default only the time the threads were blocked (lock waits, I/O, sleeps) is counted.
+// The blocked time is attributed to the innermost Function that was running when the thread
+// was switched out, using the exclusive counters (prof_self) of each FunctionEnd event.
+//
+// The folded file has one "<path> <microseconds>" line per call path,
+// which is the input format for: flamegraph.pl --colors=io --countname=us < file > offcpu.svg
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "giopler/utility.hpp"
+#include "json.hpp"
+
+using namespace std::literals;
+using giopler::gformat;
+using giopler::tool::JsonValue;
+using giopler::tool::JsonReader;
+
+// -----------------------------------------------------------------------------
+struct Options {
+  bool preempted  = false;
+  bool per_thread = false;
+  std::size_t top = 30;
+  std::string folded_path;
+  std::string recording_path;
+};
+
+// -----------------------------------------------------------------------------
+/// off-CPU time for one call path
+struct PathTime {
+  double seconds  = 0;
+  double switches = 0;
+  double calls    = 0;
+};
+
+// -----------------------------------------------------------------------------
+struct OffCpuProfile {
+  std::map<std::string, PathTime, std::less<>> paths;
+  std::map<std::uint64_t, PathTime, std::less<>> threads;
+  bool has_off_cpu = false;   // false if the run was not recorded with GIOPLER_OFF_CPU
+};
+
+// -----------------------------------------------------------------------------
+OffCpuProfile read_profile(const Options& options)
+{
+  std::ifstream input{options.recording_path, std::ios::binary};
+  if (!input) {
+    throw std::runtime_error{gformat("could not open '{}'", options.recording_path)};
+  }
+
+  OffCpuProfile profile;
+  JsonReader reader{input};
+  std::string call_path;
+
+  reader.for_each_record([&](const JsonValue& record) {
+    if (record.get_string("event") != "FunctionEnd")   return;
+    const JsonValue* functions = record.find("funcs");
+    const JsonValue* counters  = record.find("prof_self");
+    if (!functions || !functions->is_array() || !counters || !counters->find("off_cpu"))   return;
+    profile.has_off_cpu = true;
+
+    double seconds = counters->get_number("off_cpu");
+    if (!options.preempted)   seconds -= counters->get_number("off_cpu_prmpt");
+    const double switches = counters->get_number("off_cpu_swtch");
+    const auto thread_id  = static_cast<std::uint64_t>(record.get_number("thrd_id"));
+
+    call_path.clear();
+    if (options.per_thread)   call_path.append(gformat("thread-{}", thread_id));
+    for (const JsonValue& function : functions->get_array()) {
+      if (!call_path.empty())   call_path.push_back(';');
+      call_path.append(function.get_string());
+    }
+
+    for (PathTime* path_time : {&profile.paths[call_path], &profile.threads[thread_id]}) {
+      path_time->seconds  += seconds;
+      path_time->switches += switches;
+      path_time->calls++;
+    }
+  });
+
+  return profile;
+}
+
+// -----------------------------------------------------------------------------
+template<typename Key>
+void print_table(const std::map<Key, PathTime, std::less<>>& times, std::string_view title,
+                 std::string_view column, const Options& options)
+{
+  std::vector<std::pair<const Key*, const PathTime*>> rows;
+  double total_seconds = 0;
+  for (const auto& [key, path_time] : times) {
+    rows.emplace_back(&key, &path_time);
+    total_seconds += path_time.seconds;
+  }
+  std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.second->seconds > b.second->seconds; });
+
+  std::cout << gformat("\n{} (total {:.6f} seconds)\n", title, total_seconds);
+  std::cout << gformat("{:>12} {:>7} {:>10} {:>10}  {}\n", "seconds", "share", "switches", "calls", column);
+  for (std::size_t row = 0; row < std::min(rows.size(), options.top); ++row) {
+    const PathTime& path_time = *rows[row].second;
+    const double share = (total_seconds > 0) ? 100 * path_time.seconds / total_seconds : 0;
+    std::cout << gformat("{:>12.6f} {:>6.1f}% {:>10} {:>10}  {}\n",
+                         path_time.seconds, share, path_time.switches, path_time.calls, *rows[row].first);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void write_folded(const OffCpuProfile& profile, const Options& options)
+{
+  std::ofstream output{options.folded_path};
+  if (!output) {
+    throw std::runtime_error{gformat("could not create '{}'", options.folded_path)};
+  }
+
+  for (const auto& [path, path_time] : profile.paths) {
+    const long long microseconds = std::llround(path_time.seconds * 1e6);
+    if (microseconds > 0)   output << gformat("{} {}\n", path, microseconds);
+  }
+}
+
+// -----------------------------------------------------------------------------
+[[noreturn]] void usage()
+{
+  std::cerr << "usage: giopler_offcpu [--preempted] [--per-thread] [--top <count>] [--folded <file>] <recording>\n";
+  std::exit(EXIT_FAILURE);
+}
+
+// -----------------------------------------------------------------------------
+Options parse_options(int argc, char** argv)
+{
+  Options options;
+  std::vector<std::string> paths;
+
+  for (int arg = 1; arg < argc; ++arg) {
+    const std::string_view option = argv[arg];
+    auto next_value = [&]() -> std::string {
+      if (arg+1 >= argc)   usage();
+      return argv[++arg];
+    };
+
+    if      (option == "--preempted")    options.preempted = true;
+    else if (option == "--per-thread")   options.per_thread = true;
+    else if (option == "--top")          options.top = std::stoul(next_value());
+    else if (option == "--folded")       options.folded_path = next_value();
+    else if (option.starts_with("-"))    usage();
+    else paths.emplace_back(option);
+  }
+
+  if (paths.size() != 1)   usage();
+  options.recording_path = paths[0];
+  return options;
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  const Options options = parse_options(argc, argv);
+
+  try {
+    const OffCpuProfile profile = read_profile(options);
+    if (!profile.has_off_cpu) {
+      std::cerr << "giopler_offcpu: no off-CPU times found; record the run in Prof mode with GIOPLER_OFF_CPU=1\n";
+      return EXIT_FAILURE;
+    }
+
+    const std::string_view kind = options.preempted ? "off-CPU"sv : "blocked"sv;
+    print_table(profile.threads, gformat("{} time by thread", kind), "thread", options);
+    print_table(profile.paths, gformat("{} time by call path", kind), "call path", options);
+
+    if (!options.folded_path.empty()) {
+      write_folded(profile, options);
+    }
+  } catch (const std::exception& exception) {
+    std::cerr << "giopler_offcpu: " << exception.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,466 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+// Writes a function order for the linker from a recorded run, to place the hot functions
+// and the functions that call each other close together in the program's code.
+// Record the run with GIOPLER_RECORD=<file> (Prof mode for the self times, Dev mode for call counts only).
+//
+// usage: giopler_order [options] --binary <program> <recording>
+//   --binary <file>       the program or library to be linked with the order (its symbol table is read)
+//   --symbols <file>      write a symbol ordering file (lld --symbol-ordering-file)
+//   --sections <file>     write a section ordering file (gold and GNU ld 2.43+ --section-ordering-file),
+//                         for code compiled with -ffunction-sections
+//   --algorithm <name>    c3 (default) or ph
+//   --merge-limit <bytes> largest cluster built by c3 (default: 4096, one page)
+//   --top <count>         rows printed (default: 30)
+//
+// The functions are weighted by their self time (prof_self.dur), or by their calls without it,
+// and the call graph comes from the call stacks (funcs) of the FunctionEnd events.
+// The functions summarized in request spans (Span events) add their self time, but no calls.
+//   c3: Call-Chain Clustering, Ottoni and Maher, CGO 2017. Starting with the hottest, each function
+//       is appended to the cluster of its most frequent caller while the cluster fits in the merge
+//       limit, and the clusters are ordered by density (weight per byte).
+//   ph: Pettis and Hansen, PLDI 1990. The clusters at the ends of the heaviest call edges are merged
+//       first, oriented so the caller and callee end up closest, and ordered by weight.
+//
+// The events name functions as the compiler's __builtin_FUNCTION does, without the namespace,
+// class, or parameters, so every symbol with that name is placed where the function is.
+//
+// GIOPLER_RECORD=run.json ./my_program
+// giopler_order --binary my_program --sections my_program.order run.json
+// g++ -ffunction-sections ... -fuse-ld=gold -Wl,--section-ordering-file=my_program.order
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cxxabi.h>
+#include <elf.h>
+
+#include "giopler/utility.hpp"
+#include "json.hpp"
+
+using namespace std::literals;
+using giopler::gformat;
+using giopler::tool::JsonValue;
+using giopler::tool::JsonReader;
+
+// -----------------------------------------------------------------------------
+struct Options {
+  std::string binary_path;
+  std::string symbols_path;
+  std::string sections_path;
+  std::string algorithm = "c3";
+  std::uint64_t merge_limit = 4096;
+  std::size_t top = 30;
+  std::string recording_path;
+};
+
+// -----------------------------------------------------------------------------
+/// one function of the call graph
+struct Node {
+  std::string name;
+  double self_time = 0;
+  double calls = 0;
+  double weight = 0;                 // self time, or calls if the run has no times
+  std::uint64_t size = 0;            // bytes of code of its symbols
+  std::vector<std::string> symbols;  // mangled
+  std::map<std::size_t, double> callers;   // node index, calls
+};
+
+// -----------------------------------------------------------------------------
+struct CallGraph {
+  std::vector<Node> nodes;
+  std::map<std::string, std::size_t, std::less<>> indexes;
+  bool has_times = false;
+
+  std::size_t get_index(std::string_view name) {
+    const auto found = indexes.find(name);
+    if (found != indexes.end())   return found->second;
+    indexes.emplace(std::string{name}, nodes.size());
+    nodes.push_back(Node{std::string{name}});
+    return nodes.size()-1;
+  }
+};
+
+// -----------------------------------------------------------------------------
+CallGraph read_call_graph(const std::string& path)
+{
+  std::ifstream input{path, std::ios::binary};
+  if (!input)   throw std::runtime_error{gformat("could not open '{}'", path)};
+
+  CallGraph graph;
+  JsonReader reader{input};
+  reader.for_each_record([&](const JsonValue& record) {
+    const std::string_view event = record.get_string("event");
+    if (event == "FunctionEnd") {
+      const JsonValue* functions = record.find("funcs");
+      if (!functions || !functions->is_array() || functions->get_array().empty())   return;
+      const std::vector<JsonValue>& stack = functions->get_array();
+      const std::size_t callee = graph.get_index(stack.back().get_string());
+      graph.nodes[callee].calls++;
+      if (const JsonValue* counters = record.find("prof_self"); counters && counters->find("dur")) {
+        graph.nodes[callee].self_time += counters->get_number("dur");
+        graph.has_times = true;
+      }
+      if (stack.size() >= 2 && !stack[stack.size()-2].get_string().starts_with('<')) {   // not <thread>
+        const std::size_t caller = graph.get_index(stack[stack.size()-2].get_string());
+        if (caller != callee)   graph.nodes[callee].callers[caller]++;
+      }
+    } else if (event == "Span") {
+      const JsonValue* sites = record.find("sites");
+      if (!sites || !sites->is_array())   return;
+      for (const JsonValue& site : sites->get_array()) {
+        Node& node = graph.nodes[graph.get_index(site.get_string("func"))];
+        node.calls += site.get_number("calls");
+        if (const JsonValue* counters = site.find("prof_self"))   node.self_time += counters->get_number("dur");
+      }
+    }
+  });
+
+  for (Node& node : graph.nodes) {
+    node.weight = graph.has_times ? node.self_time : node.calls;
+  }
+  return graph;
+}
+
+// -----------------------------------------------------------------------------
+/// the name of a demangled symbol as __builtin_FUNCTION gives it
+// "ns::Parser::parse(char const*) const" is "parse"; "void f<int>(int)" is "f"
+std::string get_base_name(std::string_view name)
+{
+  // cut the parameters, at the first '(' outside template arguments
+  int depth = 0;
+  std::size_t end = name.size();
+  for (std::size_t index = 0; index < name.size(); ++index) {
+    if (name[index] == '<' || name[index] == '{')   depth++;
+    else if (name[index] == '>' || name[index] == '}')   depth--;
+    else if (name[index] == '(' && depth == 0 && !name.substr(0, index).ends_with("operator")) {
+      end = index;
+      break;
+    }
+  }
+  name = name.substr(0, end);
+
+  // cut the template arguments of the function
+  if (name.ends_with('>')) {
+    depth = 0;
+    for (std::size_t index = name.size(); index-- > 0;) {
+      if (name[index] == '>')   depth++;
+      else if (name[index] == '<' && --depth == 0) {
+        name = name.substr(0, index);
+        break;
+      }
+    }
+  }
+
+  // cut the return type, namespaces, and classes
+  depth = 0;
+  for (std::size_t index = name.size(); index-- > 0;) {
+    if (name[index] == '>' || name[index] == '}')   depth++;
+    else if (name[index] == '<' || name[index] == '{')   depth--;
+    else if (depth == 0 && (name[index] == ' ' || (name[index] == ':' && index > 0 && name[index-1] == ':'))) {
+      if (!name.substr(0, index).ends_with("operator"))   return std::string{name.substr(index+1)};
+    }
+  }
+  return std::string{name};
+}
+
+// -----------------------------------------------------------------------------
+/// add the mangled names and sizes of the function symbols of the ELF file to the nodes
+void read_symbols(const std::string& path, CallGraph& graph)
+{
+  std::ifstream input{path, std::ios::binary};
+  if (!input)   throw std::runtime_error{gformat("could not open '{}'", path)};
+  const std::string file{std::istreambuf_iterator<char>{input}, std::istreambuf_iterator<char>{}};
+
+  Elf64_Ehdr header;
+  if (file.size() < sizeof(header) || std::memcmp(file.data(), ELFMAG, SELFMAG) != 0 ||
+      file[EI_CLASS] != ELFCLASS64) {
+    throw std::runtime_error{gformat("'{}' is not a 64-bit ELF file", path)};
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (header.e_shoff + header.e_shnum * sizeof(Elf64_Shdr) > file.size()) {
+    throw std::runtime_error{gformat("'{}' is truncated", path)};
+  }
+
+  auto get_section = [&](const std::size_t index) {
+    Elf64_Shdr section;
+    std::memcpy(&section, file.data() + header.e_shoff + index * sizeof(Elf64_Shdr), sizeof(section));
+    return section;
+  };
+
+  // the full symbol table, or the dynamic one of a stripped file
+  for (const std::uint32_t table_type : {SHT_SYMTAB, SHT_DYNSYM}) {
+    bool found_table = false;
+    for (std::size_t index = 0; index < header.e_shnum; ++index) {
+      const Elf64_Shdr symbols = get_section(index);
+      if (symbols.sh_type != table_type || symbols.sh_link >= header.e_shnum)   continue;
+      const Elf64_Shdr strings = get_section(symbols.sh_link);
+      if (symbols.sh_offset + symbols.sh_size > file.size() || strings.sh_offset + strings.sh_size > file.size())   continue;
+      found_table = true;
+
+      for (std::size_t offset = 0; offset + sizeof(Elf64_Sym) <= symbols.sh_size; offset += sizeof(Elf64_Sym)) {
+        Elf64_Sym symbol;
+        std::memcpy(&symbol, file.data() + symbols.sh_offset + offset, sizeof(symbol));
+        if (ELF64_ST_TYPE(symbol.st_info) != STT_FUNC || symbol.st_shndx == SHN_UNDEF ||
+            symbol.st_size == 0 || symbol.st_name >= strings.sh_size)   continue;
+
+        const char* mangled = file.data() + strings.sh_offset + symbol.st_name;
+        int status = 0;
+        const std::unique_ptr<char, decltype(&std::free)> demangled{
+            abi::__cxa_demangle(mangled, nullptr, nullptr, &status), &std::free};
+        const auto node = graph.indexes.find(get_base_name(status == 0 ? demangled.get() : mangled));
+        if (node == graph.indexes.end())   continue;
+
+        Node& function = graph.nodes[node->second];
+        if (std::find(function.symbols.begin(), function.symbols.end(), mangled) != function.symbols.end())   continue;
+        function.symbols.emplace_back(mangled);
+        function.size += symbol.st_size;
+      }
+    }
+    if (found_table)   return;
+  }
+  throw std::runtime_error{gformat("'{}' has no symbol table", path)};
+}
+
+// -----------------------------------------------------------------------------
+/// a sequence of functions to be placed together
+struct Cluster {
+  std::vector<std::size_t> nodes;
+  double weight = 0;
+  std::uint64_t size = 0;
+
+  [[nodiscard]] double get_density() const {
+    return weight / static_cast<double>(std::max<std::uint64_t>(size, 1));
+  }
+};
+
+// -----------------------------------------------------------------------------
+/// Call-Chain Clustering (C3)
+std::vector<Cluster> order_c3(const CallGraph& graph, const std::vector<std::size_t>& functions,
+                              const std::uint64_t merge_limit)
+{
+  std::vector<Cluster> clusters(graph.nodes.size());
+  std::vector<std::size_t> cluster_of(graph.nodes.size());
+  for (const std::size_t node : functions) {
+    clusters[node] = Cluster{{node}, graph.nodes[node].weight, graph.nodes[node].size};
+    cluster_of[node] = node;
+  }
+
+  std::vector<std::size_t> hottest{functions};
+  std::stable_sort(hottest.begin(), hottest.end(), [&graph](const std::size_t left, const std::size_t right) {
+    return graph.nodes[left].weight > graph.nodes[right].weight;
+  });
+
+  for (const std::size_t node : hottest) {
+    // the most frequent caller that has symbols
+    const Node& function = graph.nodes[node];
+    std::size_t caller = node;
+    double caller_calls = 0;
+    for (const auto& [candidate, calls] : function.callers) {
+      if (calls > caller_calls && !graph.nodes[candidate].symbols.empty()) {
+        caller = candidate;
+        caller_calls = calls;
+      }
+    }
+
+    Cluster& caller_cluster = clusters[cluster_of[caller]];
+    Cluster& callee_cluster = clusters[cluster_of[node]];
+    if (caller == node || &caller_cluster == &callee_cluster ||
+        caller_cluster.size + callee_cluster.size > merge_limit)   continue;
+
+    for (const std::size_t moved : callee_cluster.nodes)   cluster_of[moved] = cluster_of[caller];
+    caller_cluster.nodes.insert(caller_cluster.nodes.end(), callee_cluster.nodes.begin(), callee_cluster.nodes.end());
+    caller_cluster.weight += callee_cluster.weight;
+    caller_cluster.size   += callee_cluster.size;
+    callee_cluster = Cluster{};
+  }
+
+  std::erase_if(clusters, [](const Cluster& cluster) { return cluster.nodes.empty(); });
+  std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& left, const Cluster& right) {
+    return left.get_density() > right.get_density();
+  });
+  return clusters;
+}
+
+// -----------------------------------------------------------------------------
+/// Pettis-Hansen ordering
+std::vector<Cluster> order_pettis_hansen(const CallGraph& graph, const std::vector<std::size_t>& functions)
+{
+  std::vector<Cluster> clusters(graph.nodes.size());
+  std::vector<std::size_t> cluster_of(graph.nodes.size());
+  std::vector<bool> has_symbols(graph.nodes.size());
+  for (const std::size_t node : functions) {
+    clusters[node] = Cluster{{node}, graph.nodes[node].weight, graph.nodes[node].size};
+    cluster_of[node] = node;
+    has_symbols[node] = true;
+  }
+
+  // the call graph as undirected edges, heaviest first
+  std::map<std::pair<std::size_t, std::size_t>, double> edge_calls;
+  for (const std::size_t callee : functions) {
+    for (const auto& [caller, calls] : graph.nodes[callee].callers) {
+      if (has_symbols[caller])   edge_calls[{std::min(caller, callee), std::max(caller, callee)}] += calls;
+    }
+  }
+  std::vector<std::pair<std::pair<std::size_t, std::size_t>, double>> edges{edge_calls.begin(), edge_calls.end()};
+  std::stable_sort(edges.begin(), edges.end(), [](const auto& left, const auto& right) { return left.second > right.second; });
+
+  for (const auto& [edge, calls] : edges) {
+    const auto [first_node, second_node] = edge;
+    Cluster& first  = clusters[cluster_of[first_node]];
+    Cluster& second = clusters[cluster_of[second_node]];
+    if (&first == &second)   continue;
+
+    // of the four ways to join the clusters, the one that puts the two functions closest
+    const auto first_position  = static_cast<std::size_t>(std::find(first.nodes.begin(), first.nodes.end(), first_node) - first.nodes.begin());
+    const auto second_position = static_cast<std::size_t>(std::find(second.nodes.begin(), second.nodes.end(), second_node) - second.nodes.begin());
+    const std::size_t first_to_end    = first.nodes.size()-1 - first_position;
+    const std::size_t second_to_end   = second.nodes.size()-1 - second_position;
+    const std::size_t distances[4]    = {first_to_end + second_position,    // first, second
+                                         first_to_end + second_to_end,      // first, reversed second
+                                         first_position + second_position,  // reversed first, second
+                                         first_position + second_to_end};   // reversed first, reversed second
+    const auto join = std::min_element(std::begin(distances), std::end(distances)) - std::begin(distances);
+    if (join >= 2)        std::reverse(first.nodes.begin(), first.nodes.end());
+    if (join % 2 == 1)    std::reverse(second.nodes.begin(), second.nodes.end());
+
+    const std::size_t first_cluster = cluster_of[first_node];
+    for (const std::size_t moved : second.nodes)   cluster_of[moved] = first_cluster;
+    first.nodes.insert(first.nodes.end(), second.nodes.begin(), second.nodes.end());
+    first.weight += second.weight;
+    first.size   += second.size;
+    second = Cluster{};
+  }
+
+  std::erase_if(clusters, [](const Cluster& cluster) { return cluster.nodes.empty(); });
+  std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& left, const Cluster& right) {
+    return left.weight > right.weight;
+  });
+  return clusters;
+}
+
+// -----------------------------------------------------------------------------
+/// one line per symbol, or per function section
+void write_order(const std::string& path, const CallGraph& graph, const std::vector<Cluster>& clusters,
+                 std::string_view prefix)
+{
+  std::ofstream output{path};
+  if (!output)   throw std::runtime_error{gformat("could not create '{}'", path)};
+  for (const Cluster& cluster : clusters) {
+    for (const std::size_t node : cluster.nodes) {
+      for (const std::string& symbol : graph.nodes[node].symbols)   output << prefix << symbol << '\n';
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+void print_order(const CallGraph& graph, const std::vector<Cluster>& clusters, const Options& options)
+{
+  std::cout << gformat("{:>7} {:>12} {:>10} {:>8}  {}\n", "cluster",
+                       graph.has_times ? "self (s)" : "calls", "calls", "bytes", "function");
+  std::size_t rows = 0;
+  for (std::size_t index = 0; index < clusters.size() && rows < options.top; ++index) {
+    for (const std::size_t node : clusters[index].nodes) {
+      if (rows++ >= options.top)   break;
+      const Node& function = graph.nodes[node];
+      std::cout << gformat("{:>7} {:>12.6g} {:>10} {:>8}  {}\n", index, function.weight, function.calls,
+                           function.size, function.name);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+[[noreturn]] void usage()
+{
+  std::cerr << "usage: giopler_order --binary <file> [--symbols <file>] [--sections <file>] [--algorithm c3|ph]\n"
+               "                     [--merge-limit <bytes>] [--top <count>] <recording>\n";
+  std::exit(EXIT_FAILURE);
+}
+
+// -----------------------------------------------------------------------------
+Options parse_options(int argc, char** argv)
+{
+  Options options;
+  std::vector<std::string> paths;
+
+  for (int arg = 1; arg < argc; ++arg) {
+    const std::string_view option = argv[arg];
+    auto next_value = [&]() -> std::string {
+      if (arg+1 >= argc)   usage();
+      return argv[++arg];
+    };
+
+    if      (option == "--binary")        options.binary_path = next_value();
+    else if (option == "--symbols")       options.symbols_path = next_value();
+    else if (option == "--sections")      options.sections_path = next_value();
+    else if (option == "--algorithm")     options.algorithm = next_value();
+    else if (option == "--merge-limit")   options.merge_limit = std::stoull(next_value());
+    else if (option == "--top")           options.top = std::stoul(next_value());
+    else if (option.starts_with("-"))     usage();
+    else paths.emplace_back(option);
+  }
+
+  if (paths.size() != 1 || options.binary_path.empty() ||
+      (options.algorithm != "c3" && options.algorithm != "ph"))   usage();
+  options.recording_path = paths[0];
+  return options;
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  const Options options = parse_options(argc, argv);
+
+  try {
+    CallGraph graph = read_call_graph(options.recording_path);
+    if (graph.nodes.empty()) {
+      std::cerr << "giopler_order: no function events found; record the run in Dev or Prof mode\n";
+      return EXIT_FAILURE;
+    }
+    read_symbols(options.binary_path, graph);
+
+    // only the functions that ran and are in the binary are ordered
+    std::vector<std::size_t> functions;
+    std::size_t missing = 0;
+    for (std::size_t node = 0; node < graph.nodes.size(); ++node) {
+      if (graph.nodes[node].symbols.empty())   missing++;
+      else if (graph.nodes[node].weight > 0)   functions.push_back(node);
+    }
+
+    const std::vector<Cluster> clusters = (options.algorithm == "c3") ?
+        order_c3(graph, functions, options.merge_limit) : order_pettis_hansen(graph, functions);
+    std::uint64_t hot_bytes = 0;
+    for (const std::size_t node : functions)   hot_bytes += graph.nodes[node].size;
+    std::cout << gformat("giopler_order: {} functions in {} clusters ({} bytes of code), "
+                         "{} functions not found in '{}'\n\n",
+                         functions.size(), clusters.size(), hot_bytes, missing, options.binary_path);
+    print_order(graph, clusters, options);
+
+    if (!options.symbols_path.empty())    write_order(options.symbols_path, graph, clusters, "");
+    if (!options.sections_path.empty())   write_order(options.sections_path, graph, clusters, ".text.");
+  } catch (const std::exception& exception) {
+    std::cerr << "giopler_order: " << exception.what() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
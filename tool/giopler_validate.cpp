@@ -0,0 +1,605 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+// Checks the counters of the Prof build mode on this host against kernels whose counts are known.
+// Every kernel is measured three ways:
+//   alone      each counter on its own, with no other counter open, so it is never multiplexed
+//   library    the counter set of the library (LinuxEvents), as the profiles read it
+//   multiplex  the same, with extra groups of hardware counters open so the kernel multiplexes them
+// and the counts are compared with what the kernel must produce (exact), with a model of the hardware
+// (model), with the wall time (wall), or with the counter measured alone (alone).
+// The error of the counts that have no exact value is relative to the larger of the expected value
+// and 1% of the operations of the kernel.
+//
+// usage: giopler_validate [options]
+//   --counters <set>    perf, lite, or all (default: all, each set in its own process)
+//   --scale <factor>    multiplies the work of every kernel (default: 1)
+//   --load <groups>     groups of four hardware counters opened for the multiplex runs (default: 4)
+//   --tolerance <pct>   largest error of the exact and alone counts (default: 1)
+//
+// The exit status is 1 if any counter is outside its tolerance.
+// Pin the program to a quiet CPU for the wall time checks: taskset -c 2 giopler_validate
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "giopler/linux/counter.hpp"
+#include "giopler/counter.hpp"
+
+using namespace std::literals;
+using giopler::gformat;
+using giopler::dev::LinuxEvent;
+using giopler::dev::LinuxEvents;
+
+#if defined(__x86_64__) || defined(__aarch64__)
+#define GIOPLER_VALIDATE_ASM 1
+#else
+#define GIOPLER_VALIDATE_ASM 0
+#endif
+
+// -----------------------------------------------------------------------------
+struct Options {
+  std::string counters = "all";
+  double scale = 1.0;
+  int load = 4;
+  double tolerance = 1.0;
+};
+
+// -----------------------------------------------------------------------------
+/// the perf event that measures each counter of the library on its own
+struct CounterEvent {
+  std::string_view counter;
+  uint32_t type;
+  uint64_t config;
+  double unit;              // seconds per count of the time counters
+};
+
+constexpr CounterEvent g_counter_events[] = {
+  {"hw_cpu_cycl"sv,     PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES,      1},
+  {"hw_instr"sv,        PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,        1},
+  {"hw_brnch_instr"sv,  PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, 1},
+  {"hw_brnch_miss"sv,   PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,       1},
+  {"hw_cache_ref"sv,    PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES,    1},
+  {"hw_cache_miss"sv,   PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,        1},
+  {"sw_task_clck"sv,    PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK,          1e-9},
+  {"sw_pg_fault"sv,     PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,         1},
+  {"sw_pg_fault_min"sv, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN,     1}
+};
+
+// -----------------------------------------------------------------------------
+/// what a counter is compared with
+// Exact:  the count the kernel must produce
+// Model:  an approximation from a model of the hardware
+// Wall:   the wall time of the same run (for the CPU time of a thread that never waits)
+// Alone:  the counter measured on its own
+enum class Source {Exact, Model, Wall, Alone};
+
+std::string_view get_source_name(const Source source) {
+  switch (source) {
+    case Source::Exact:   return "exact"sv;
+    case Source::Model:   return "model"sv;
+    case Source::Wall:    return "wall"sv;
+    case Source::Alone:   return "alone"sv;
+  }
+  return ""sv;
+}
+
+struct Check {
+  std::string counter;
+  Source source;
+  double expected;          // per operation, for Exact and Model
+  double tolerance;         // percent, 0 for the --tolerance option
+};
+
+// -----------------------------------------------------------------------------
+/// a piece of code whose counts are known
+struct Kernel {
+  std::string name;
+  double operations;        // the counts are reported per operation
+  std::function<void()> run;
+  std::vector<Check> checks;
+};
+
+// -----------------------------------------------------------------------------
+/// a counter measured on one run of a kernel
+struct Reading {
+  double value;             // counts, or seconds for the time counters
+  double wall_secs;
+  double running;           // fraction of the run the counter was counting
+};
+
+using Readings = std::map<std::string, Reading, std::less<>>;
+
+// -----------------------------------------------------------------------------
+// kernels
+// -----------------------------------------------------------------------------
+/// a loop of exactly two instructions and one branch per iteration
+__attribute__((noinline)) void run_loop(std::uint64_t iterations)
+{
+#if defined(__x86_64__)
+  asm volatile("1: dec %0\n\t"
+               "jnz 1b"
+               : "+r"(iterations) :: "cc");
+#elif defined(__aarch64__)
+  asm volatile("1: subs %0, %0, #1\n\t"
+               "b.ne 1b"
+               : "+r"(iterations) :: "cc");
+#else
+  (void)iterations;
+#endif
+}
+
+// instructions per byte of run_branches, plus one for each byte that is not zero
+#if defined(__x86_64__)
+constexpr double g_branch_instructions = 6;
+#else
+constexpr double g_branch_instructions = 5;
+#endif
+
+/// one data-dependent branch and one loop branch per byte
+__attribute__((noinline)) std::uint64_t run_branches(const unsigned char* data, const std::uint64_t size)
+{
+  std::uint64_t index = 0, count = 0;
+#if defined(__x86_64__)
+  asm volatile("1: movzbl (%[data],%[index]), %%eax\n\t"
+               "test %%eax, %%eax\n\t"
+               "jz 2f\n\t"
+               "inc %[count]\n"
+               "2: inc %[index]\n\t"
+               "cmp %[size], %[index]\n\t"
+               "jne 1b"
+               : [index] "+r"(index), [count] "+r"(count)
+               : [data] "r"(data), [size] "r"(size)
+               : "eax", "cc", "memory");
+#elif defined(__aarch64__)
+  asm volatile("1: ldrb w9, [%[data], %[index]]\n\t"
+               "cbz w9, 2f\n\t"
+               "add %[count], %[count], #1\n"
+               "2: add %[index], %[index], #1\n\t"
+               "cmp %[index], %[size]\n\t"
+               "b.ne 1b"
+               : [index] "+r"(index), [count] "+r"(count)
+               : [data] "r"(data), [size] "r"(size)
+               : "x9", "cc", "memory");
+#else
+  (void)data; (void)size;
+#endif
+  return count;
+}
+
+/// a random cycle through the cache lines of the working set
+struct alignas(64) Line {
+  Line* next;
+};
+
+__attribute__((noinline)) Line* run_chase(Line* line, const std::uint64_t steps)
+{
+  for (std::uint64_t step = 0; step < steps; ++step)   line = line->next;
+  return line;
+}
+
+/// the first touch of every page of a new mapping is a minor page fault
+__attribute__((noinline)) void run_touch(const std::size_t pages)
+{
+  const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  void* memory = mmap(nullptr, pages * page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED)   throw std::runtime_error{"mmap failed"};
+  madvise(memory, pages * page_size, MADV_NOHUGEPAGE);   // one fault per small page
+  volatile char* bytes = static_cast<char*>(memory);
+  for (std::size_t page = 0; page < pages; ++page)   bytes[page * page_size] = 1;
+  munmap(memory, pages * page_size);
+}
+
+/// the matrix multiplications of sample/matrices.cpp: bad order (ijk) and plain (ikj)
+__attribute__((noinline)) void run_matmul_ijk(const double* A, const double* B, double* C, const int dim)
+{
+  std::fill(C, C + dim*dim, 0.0);
+  for (int i = 0; i < dim; ++i) {
+    for (int j = 0; j < dim; ++j) {
+      for (int k = 0; k < dim; ++k) {
+        C[i*dim+j] += A[i*dim+k] * B[k*dim+j];
+      }
+    }
+  }
+}
+
+__attribute__((noinline)) void run_matmul_ikj(const double* A, const double* B, double* C, const int dim)
+{
+  std::fill(C, C + dim*dim, 0.0);
+  for (int i = 0; i < dim; ++i) {
+    for (int k = 0; k < dim; ++k) {
+      for (int j = 0; j < dim; ++j) {
+        C[i*dim+j] += A[i*dim+k] * B[k*dim+j];
+      }
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+/// the kernels, with their data
+// the data is kept alive by the closures, and prepared before any run is measured
+std::vector<Kernel> make_kernels(const Options& options)
+{
+  std::vector<Kernel> kernels;
+  std::mt19937_64 random{20230601};
+  const auto scaled = [&options](const double count) {
+    return static_cast<std::uint64_t>(std::max(1.0, std::round(count * options.scale)));
+  };
+  const Check cpu_time{"sw_task_clck", Source::Wall, 0, 5};
+
+  if constexpr (GIOPLER_VALIDATE_ASM) {
+    const std::uint64_t iterations = scaled(200e6);
+    kernels.push_back(Kernel{"loop", static_cast<double>(iterations), [iterations]() { run_loop(iterations); }, {
+        {"hw_instr",       Source::Exact, 2, 0},
+        {"hw_brnch_instr", Source::Exact, 1, 0},
+        {"hw_brnch_miss",  Source::Exact, 0, 0},
+        {"hw_cpu_cycl",    Source::Alone, 0, 5},
+        cpu_time}});
+
+    // bytes that are not zero with the given probability; no predictor can learn them,
+    // so the best it can do is guess the more common outcome and miss the other one
+    const std::size_t size = 1 << 20;
+    const std::uint64_t passes = scaled(32);
+    for (const double probability : {0.0, 0.25, 0.5}) {
+      auto data = std::make_shared<std::vector<unsigned char>>(size);
+      std::bernoulli_distribution distribution{probability};
+      for (unsigned char& byte : *data)   byte = distribution(random) ? 1 : 0;
+      const double nonzero = static_cast<double>(std::count(data->begin(), data->end(), 1)) / static_cast<double>(size);
+      kernels.push_back(Kernel{gformat("branch p={}", probability), static_cast<double>(size * passes),
+                               [data, passes]() {
+                                 std::uint64_t count = 0;
+                                 for (std::uint64_t pass = 0; pass < passes; ++pass) {
+                                   count += run_branches(data->data(), data->size());
+                                 }
+                                 asm volatile("" :: "r"(count));
+                               }, {
+          {"hw_instr",       Source::Exact, g_branch_instructions + nonzero, 0},
+          {"hw_brnch_instr", Source::Exact, 2, 0},
+          {"hw_brnch_miss",  Source::Model, std::min(probability, 1-probability), 10},
+          cpu_time}});
+    }
+  } else {
+    std::cerr << "giopler_validate: the loop and branch kernels need x86-64 or AArch64\n";
+  }
+
+  // pointer chasing in the first level cache, and far outside the last level cache
+  long cache_size = 0;
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+  cache_size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+  const std::size_t large_size = std::clamp<std::size_t>(8 * static_cast<std::size_t>(std::max(cache_size, 0L)),
+                                                         64 << 20, 512 << 20);
+  for (const std::size_t working_set : {std::size_t{16} << 10, large_size}) {
+    const std::size_t line_count = working_set / sizeof(Line);
+    auto lines = std::make_shared<std::vector<Line>>(line_count);
+    std::vector<std::size_t> order(line_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), random);
+    for (std::size_t index = 0; index < line_count; ++index) {
+      (*lines)[order[index]].next = &(*lines)[order[(index+1) % line_count]];
+    }
+    const bool is_large = (working_set == large_size);
+    const std::uint64_t steps = scaled(is_large ? 4e6 : 50e6);
+    const std::string name = (working_set >= (1 << 20)) ? gformat("chase {}MB", working_set >> 20) :
+                                                          gformat("chase {}KB", working_set >> 10);
+    kernels.push_back(Kernel{name, static_cast<double>(steps),
+                             [lines, steps]() {
+                               Line* line = run_chase(lines->data(), steps);
+                               asm volatile("" :: "r"(line));
+                             }, {
+        {"hw_instr",      Source::Alone, 0, 0},
+        {"hw_cache_ref",  Source::Alone, 0, 5},
+        {"hw_cache_miss", Source::Model, is_large ? 1.0 : 0.0, 15},
+        cpu_time}});
+  }
+
+  const std::size_t pages = scaled(16384);
+  kernels.push_back(Kernel{gformat("touch {}p", pages), static_cast<double>(pages), [pages]() { run_touch(pages); }, {
+      {"sw_pg_fault",     Source::Exact, 1, 0},
+      {"sw_pg_fault_min", Source::Exact, 1, 0},
+      cpu_time}});
+
+  constexpr int dim = 384;
+  auto matrices = std::make_shared<std::vector<double>>(3 * dim * dim);
+  std::uniform_real_distribution<double> distribution{-1000.0, 1000.0};
+  for (double& value : *matrices)   value = distribution(random);
+  const std::uint64_t repeats = scaled(1);
+  for (const bool is_ijk : {true, false}) {
+    kernels.push_back(Kernel{gformat("matmul {} {}", is_ijk ? "ijk" : "ikj", dim),
+                             static_cast<double>(dim) * dim * dim * static_cast<double>(repeats),
+                             [matrices, repeats, is_ijk]() {
+                               double* data = matrices->data();
+                               for (std::uint64_t repeat = 0; repeat < repeats; ++repeat) {
+                                 if (is_ijk)   run_matmul_ijk(data, data + dim*dim, data + 2*dim*dim, dim);
+                                 else          run_matmul_ikj(data, data + dim*dim, data + 2*dim*dim, dim);
+                               }
+                             }, {
+        {"hw_instr",       Source::Alone, 0, 0},
+        {"hw_brnch_instr", Source::Alone, 0, 0},
+        {"hw_cpu_cycl",    Source::Alone, 0, 5},
+        {"hw_cache_ref",   Source::Alone, 0, 5},
+        {"hw_cache_miss",  Source::Alone, 0, 5},
+        cpu_time}});
+  }
+
+  return kernels;
+}
+
+// -----------------------------------------------------------------------------
+// measurements
+// -----------------------------------------------------------------------------
+double get_wall_secs(const std::chrono::steady_clock::time_point start_time)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+double get_number(const giopler::RecordValue& value)
+{
+  return (value.get_type() == giopler::RecordValue::Type::Integer) ?
+         static_cast<double>(value.get_integer()) : value.get_real();
+}
+
+/// run the kernel once for each of its counters, with only that counter open
+Readings measure_alone(const Kernel& kernel)
+{
+  Readings readings;
+  for (const Check& check : kernel.checks) {
+    const auto counter_event = std::find_if(std::begin(g_counter_events), std::end(g_counter_events),
+                                            [&check](const CounterEvent& event) { return event.counter == check.counter; });
+    if (counter_event == std::end(g_counter_events) || readings.contains(check.counter))   continue;
+
+    LinuxEvent event{counter_event->counter, counter_event->type, counter_event->config};
+    if (!event.is_open())   continue;
+    event.enable_events();
+    const std::int64_t start_count = event.read_event();
+    const auto start_time = std::chrono::steady_clock::now();
+    kernel.run();
+    const double wall_secs = get_wall_secs(start_time);
+    const std::int64_t end_count = event.read_event();
+    readings.emplace(check.counter, Reading{static_cast<double>(end_count - start_count) * counter_event->unit,
+                                            wall_secs, event.get_running_fraction()});
+  }
+  return readings;
+}
+
+/// run the kernel once, reading the counter set of the library around it
+// a new set of counters is opened for each run, so the running fraction is that of the run
+Readings measure_library(const Kernel& kernel)
+{
+  LinuxEvents events;
+  const giopler::Record start_counters{events.get_snapshot()};
+  const auto start_time = std::chrono::steady_clock::now();
+  kernel.run();
+  const double wall_secs = get_wall_secs(start_time);
+  giopler::Record counters{events.get_snapshot()};
+  giopler::dev::subtract_number_record(counters, start_counters);
+
+  Readings readings;
+  const double running = events.get_running_fraction();
+  for (const auto& [counter, value] : counters) {
+    readings.emplace(counter, Reading{get_number(value), wall_secs, counter.starts_with("hw_") ? running : 1.0});
+  }
+  return readings;
+}
+
+// -----------------------------------------------------------------------------
+// report
+// -----------------------------------------------------------------------------
+/// percent error of a count, relative to the expected count, or to 1% of the operations
+double get_error(const Check& check, const double expected, const double measured)
+{
+  const double base = (check.source == Source::Wall) ? expected : std::max(std::abs(expected), 0.01);
+  return 100.0 * std::abs(measured - expected) / base;
+}
+
+struct Counts {
+  std::size_t checked = 0;
+  std::vector<std::string> unreliable;
+};
+
+/// print one line per check, with the error of each way of measuring it
+void report(const Kernel& kernel, const Readings& alone, const Readings& library, const Readings& multiplexed,
+            const Options& options, std::string_view counter_set, Counts& counts)
+{
+  for (const Check& check : kernel.checks) {
+    const double tolerance = check.tolerance ? check.tolerance : options.tolerance;
+    const auto alone_reading = alone.find(check.counter);
+    if (check.source == Source::Alone && alone_reading == alone.end())   continue;
+
+    // the expected value per operation, for a given run
+    auto get_expected = [&](const Reading& reading) -> double {
+      switch (check.source) {
+        case Source::Exact:
+        case Source::Model:   return check.expected;
+        case Source::Wall:    return reading.wall_secs / kernel.operations;
+        case Source::Alone:   return alone_reading->second.value / kernel.operations;
+      }
+      return 0;
+    };
+
+    std::string line = gformat("{:<16} {:<16} {:<6}", kernel.name, check.counter, get_source_name(check.source));
+    bool is_measured = false, is_reliable = true;
+    std::string failed_methods;
+    const std::pair<std::string_view, const Readings*> methods[] = {
+        {"alone"sv, &alone}, {"library"sv, &library}, {"multiplex"sv, &multiplexed}};
+    for (const auto& [method, readings] : methods) {
+      const auto reading = readings->find(check.counter);
+      if (reading == readings->end() || (check.source == Source::Alone && readings == &alone)) {
+        line += gformat(" {:>11} {:>7} {:>5}", "-", "-", "-");
+        continue;
+      }
+      const double expected = get_expected(reading->second);
+      const double measured = reading->second.value / kernel.operations;
+      const double error    = get_error(check, expected, measured);
+      line += gformat(" {:>11.4g} {:>6.2f}% {:>4.0f}%", measured, error, 100.0 * reading->second.running);
+      is_measured = true;
+      if (error > tolerance) {
+        is_reliable = false;
+        failed_methods += gformat("{}{}", failed_methods.empty() ? "" : ", ", method);
+      }
+    }
+    if (!is_measured)   continue;
+
+    const bool is_constant = (check.source == Source::Exact || check.source == Source::Model);
+    std::cout << line << gformat(" {:>11}  {}\n", is_constant ? gformat("{:.4g}", check.expected) : "-"s,
+                                 is_reliable ? "ok" : "UNRELIABLE");
+    counts.checked++;
+    if (!is_reliable) {
+      counts.unreliable.push_back(gformat("{} on {} ({}, {:.0f}% tolerance): {}", check.counter, kernel.name,
+                                          counter_set, tolerance, failed_methods));
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+/// measure and report every kernel with the counter set of this process
+// returns true if every counter was within its tolerance
+bool validate(const Options& options, const std::string_view requested_set)
+{
+  const std::string_view counter_set = LinuxEvents::get_counter_set_name();
+  if (counter_set != requested_set) {
+    std::cout << gformat("counters: {} are not available on this host, skipped\n\n", requested_set);
+    return true;
+  }
+
+  const std::vector<Kernel> kernels = make_kernels(options);
+
+  // alone first, while no other counters are open in the thread
+  std::vector<Readings> alone, library, multiplexed;
+  for (const Kernel& kernel : kernels)   alone.push_back(measure_alone(kernel));
+  for (const Kernel& kernel : kernels)   library.push_back(measure_library(kernel));
+
+  std::vector<std::unique_ptr<LinuxEvent>> load;
+  if (counter_set == "perf"sv) {
+    for (int group = 0; group < options.load; ++group) {
+      auto events = std::make_unique<LinuxEvent>(
+          "PERF_COUNT_HW_CPU_CYCLES",          PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,
+          "PERF_COUNT_HW_INSTRUCTIONS",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+          "PERF_COUNT_HW_BRANCH_INSTRUCTIONS", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+          "PERF_COUNT_HW_CACHE_REFERENCES",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+      if (!events->is_open()) {
+        std::cerr << "giopler_validate: " << events->get_open_error() << " (fewer multiplexing groups)\n";
+        break;
+      }
+      events->enable_events();
+      load.push_back(std::move(events));
+    }
+  }
+  for (const Kernel& kernel : kernels) {
+    multiplexed.push_back(load.empty() ? Readings{} : measure_library(kernel));
+  }
+  const std::size_t load_groups = load.size();
+  load.clear();
+
+  std::cout << gformat("counters: {}, {} extra groups of hardware counters for the multiplex runs\n",
+                       counter_set, load_groups);
+  std::cout << gformat("{:<16} {:<16} {:<6} {:>11} {:>7} {:>5} {:>11} {:>7} {:>5} {:>11} {:>7} {:>5} {:>11}\n",
+                       "kernel", "counter", "source", "alone", "error", "run", "library", "error", "run",
+                       "multiplex", "error", "run", "expected");
+  Counts counts;
+  for (std::size_t index = 0; index < kernels.size(); ++index) {
+    report(kernels[index], alone[index], library[index], multiplexed[index], options, counter_set, counts);
+  }
+
+  std::cout << gformat("\n{} of {} counts outside their tolerance\n", counts.unreliable.size(), counts.checked);
+  for (const std::string& unreliable : counts.unreliable)   std::cout << "  " << unreliable << '\n';
+  std::cout << std::endl;
+  return counts.unreliable.empty();
+}
+
+// -----------------------------------------------------------------------------
+/// the counter set is chosen once per process, so each one is validated in a child process
+bool validate_in_child(const Options& options, const std::string_view counter_set)
+{
+  std::cout.flush();
+  const pid_t pid = fork();
+  if (pid == -1)   throw std::runtime_error{"fork failed"};
+  if (pid == 0) {
+    setenv("GIOPLER_COUNTERS", std::string{counter_set}.c_str(), 1);
+    try {
+      std::exit(validate(options, counter_set) ? EXIT_SUCCESS : EXIT_FAILURE);
+    } catch (const std::exception& exception) {
+      std::cerr << "giopler_validate: " << exception.what() << '\n';
+      std::exit(EXIT_FAILURE);
+    }
+  }
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+// -----------------------------------------------------------------------------
+[[noreturn]] void usage()
+{
+  std::cerr << "usage: giopler_validate [--counters perf|lite|all] [--scale <factor>] [--load <groups>]\n"
+               "                        [--tolerance <pct>]\n";
+  std::exit(EXIT_FAILURE);
+}
+
+// -----------------------------------------------------------------------------
+Options parse_options(int argc, char** argv)
+{
+  Options options;
+
+  for (int arg = 1; arg < argc; ++arg) {
+    const std::string_view option = argv[arg];
+    auto next_value = [&]() -> std::string {
+      if (arg+1 >= argc)   usage();
+      return argv[++arg];
+    };
+
+    if      (option == "--counters")    options.counters = next_value();
+    else if (option == "--scale")       options.scale = std::stod(next_value());
+    else if (option == "--load")        options.load = std::stoi(next_value());
+    else if (option == "--tolerance")   options.tolerance = std::stod(next_value());
+    else usage();
+  }
+
+  if ((options.counters != "perf" && options.counters != "lite" && options.counters != "all") ||
+      options.scale <= 0 || options.load < 0 || options.tolerance <= 0)   usage();
+  return options;
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  const Options options = parse_options(argc, argv);
+
+  try {
+    bool is_reliable = true;
+    for (const std::string_view counter_set : {"perf"sv, "lite"sv}) {
+      if (options.counters == "all" || options.counters == counter_set) {
+        is_reliable = validate_in_child(options, counter_set) && is_reliable;
+      }
+    }
+    return is_reliable ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::exception& exception) {
+    std::cerr << "giopler_validate: " << exception.what() << '\n';
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_TOOL_HISTOGRAM_HPP
+#define GIOPLER_TOOL_HISTOGRAM_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "giopler/utility.hpp"
+
+// -----------------------------------------------------------------------------
+namespace giopler::tool {
+
+// -----------------------------------------------------------------------------
+/// latency distribution with a fixed amount of memory
+// the values are counted in logarithmic buckets, eight per power of two,
+// so the reported percentiles are within 10% of the real values
+// not thread safe; keep one per thread and merge them
+class LatencyHistogram final
+{
+ public:
+  void add(const std::uint64_t value) {
+    _counts[get_bucket(value)]++;
+    _count++;
+    _sum += static_cast<double>(value);
+    _max = std::max(_max, value);
+  }
+
+  void merge(const LatencyHistogram& other) {
+    for (std::size_t bucket = 0; bucket < _bucket_count; ++bucket) {
+      _counts[bucket] += other._counts[bucket];
+    }
+    _count += other._count;
+    _sum   += other._sum;
+    _max    = std::max(_max, other._max);
+  }
+
+  [[nodiscard]] std::uint64_t get_count() const { return _count; }
+  [[nodiscard]] std::uint64_t get_max() const   { return _max; }
+  [[nodiscard]] double get_mean() const         { return _count ? _sum / static_cast<double>(_count) : 0; }
+
+  /// upper bound of the bucket holding the given percentile (0-100)
+  [[nodiscard]] std::uint64_t get_percentile(const double percentile) const {
+    const auto rank = static_cast<std::uint64_t>(std::ceil(static_cast<double>(_count) * percentile / 100.0));
+    std::uint64_t seen = 0;
+    for (std::size_t bucket = 0; bucket < _bucket_count; ++bucket) {
+      seen += _counts[bucket];
+      if (seen >= std::max<std::uint64_t>(rank, 1)) {
+        return std::min(get_bucket_limit(bucket), _max);
+      }
+    }
+    return _max;
+  }
+
+  /// one line summary, with the values divided by the given scale (e.g. 1000 for ns to us)
+  [[nodiscard]] std::string format(const double scale = 1) const {
+    return gformat("mean {:.1f}  p50 {:.1f}  p90 {:.1f}  p99 {:.1f}  p99.9 {:.1f}  max {:.1f}",
+                   get_mean() / scale,
+                   static_cast<double>(get_percentile(50)) / scale,
+                   static_cast<double>(get_percentile(90)) / scale,
+                   static_cast<double>(get_percentile(99)) / scale,
+                   static_cast<double>(get_percentile(99.9)) / scale,
+                   static_cast<double>(_max) / scale);
+  }
+
+ private:
+  static constexpr int _sub_bits = 3;   // 2^3 buckets per power of two
+  static constexpr std::size_t _bucket_count = (64 - _sub_bits + 1) << _sub_bits;
+
+  std::array<std::uint64_t, _bucket_count> _counts{};
+  std::uint64_t _count = 0;
+  std::uint64_t _max   = 0;
+  double _sum          = 0;
+
+  // values below 2^_sub_bits have a bucket each
+  static std::size_t get_bucket(const std::uint64_t value) {
+    if (value < (1u << _sub_bits))   return static_cast<std::size_t>(value);
+    const int exponent = std::bit_width(value) - 1;   // >= _sub_bits
+    const auto mantissa = static_cast<std::size_t>((value >> (exponent - _sub_bits)) & ((1u << _sub_bits) - 1));
+    return (static_cast<std::size_t>(exponent - _sub_bits + 1) << _sub_bits) + mantissa;
+  }
+
+  // largest value that falls into the bucket
+  static std::uint64_t get_bucket_limit(const std::size_t bucket) {
+    if (bucket < (1u << _sub_bits))   return bucket;
+    const int exponent = static_cast<int>(bucket >> _sub_bits) + _sub_bits - 1;
+    const std::uint64_t mantissa = (bucket & ((1u << _sub_bits) - 1)) | (1u << _sub_bits);
+    const int shift = exponent - _sub_bits;
+    return ((mantissa + 1) << shift) - 1;
+  }
+};
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::tool
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_TOOL_HISTOGRAM_HPP
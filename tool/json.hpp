@@ -0,0 +1,290 @@
+// Copyright (c) 2023 Giopler
+// Creative Commons Attribution No Derivatives 4.0 International license
+// https://creativecommons.org/licenses/by-nd/4.0
+// SPDX-License-Identifier: CC-BY-ND-4.0
+//
+// Share         — Copy and redistribute the material in any medium or format for any purpose, even commercially.
+// NoDerivatives — If you remix, transform, or build upon the material, you may not distribute the modified material.
+// Attribution   — You must give appropriate credit, provide a link to the license, and indicate if changes were made.
+//                 You may do so in any reasonable manner, but not in any way that suggests the licensor endorses you or your use.
+
+#pragma once
+#ifndef GIOPLER_TOOL_JSON_HPP
+#define GIOPLER_TOOL_JSON_HPP
+
+#if __cplusplus < 202002L
+#error Support for C++20 or newer is required to use this library.
+#endif
+
+#include <charconv>
+#include <cstdint>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+namespace giopler::tool {
+
+// -----------------------------------------------------------------------------
+/// parsed JSON value
+// only what the tools need to read the event recordings
+class JsonValue final
+{
+ public:
+  enum class Type {Null, Boolean, Number, String, Array, Object};
+
+  [[nodiscard]] Type get_type() const { return _type; }
+  [[nodiscard]] bool is_number() const { return _type == Type::Number; }
+  [[nodiscard]] bool is_string() const { return _type == Type::String; }
+  [[nodiscard]] bool is_array()  const { return _type == Type::Array; }
+  [[nodiscard]] bool is_object() const { return _type == Type::Object; }
+
+  [[nodiscard]] bool get_boolean() const                                       { return _boolean; }
+  [[nodiscard]] double get_number() const                                      { return _number; }
+  [[nodiscard]] const std::string& get_string() const                          { return _string; }
+  [[nodiscard]] const std::vector<JsonValue>& get_array() const                { return _array; }
+  [[nodiscard]] const std::vector<std::pair<std::string, JsonValue>>& get_object() const { return _object; }
+
+  /// object field with the given name, or nullptr
+  [[nodiscard]] const JsonValue* find(std::string_view name) const {
+    for (const auto& [field_name, field_value] : _object) {
+      if (field_name == name)   return &field_value;
+    }
+    return nullptr;
+  }
+
+  /// numeric object field, or the default value if it is missing
+  [[nodiscard]] double get_number(std::string_view name, const double default_value = 0) const {
+    const JsonValue* value = find(name);
+    return (value && value->is_number()) ? value->_number : default_value;
+  }
+
+  /// string object field, or an empty string if it is missing
+  [[nodiscard]] std::string_view get_string(std::string_view name) const {
+    const JsonValue* value = find(name);
+    return (value && value->is_string()) ? std::string_view(value->_string) : std::string_view();
+  }
+
+ private:
+  friend class JsonReader;
+  Type _type = Type::Null;
+  bool _boolean = false;
+  double _number = 0;
+  std::string _string;
+  std::vector<JsonValue> _array;
+  std::vector<std::pair<std::string, JsonValue>> _object;
+};
+
+// -----------------------------------------------------------------------------
+/// reads the event recordings one record at a time
+// a recording is a sequence of JSON arrays of records, as written by GIOPLER_RECORD
+// only one record is kept in memory at a time, so recordings can be of any size
+class JsonReader final
+{
+ public:
+  explicit JsonReader(std::istream& input)
+  : _input(*input.rdbuf()) { }
+
+  /// call the function for every record in the recording
+  // top level objects are treated as a single record
+  template<typename F>
+  void for_each_record(F function) {
+    while (skip_whitespace() != EOF) {
+      if (peek() == '[') {
+        get();
+        if (skip_whitespace() == ']') {
+          get();
+          continue;
+        }
+        while (true) {
+          function(parse_value());
+          const int separator = skip_whitespace();
+          get();
+          if (separator == ']')   break;
+          if (separator != ',')   error("expected ',' or ']'");
+        }
+      } else {
+        function(parse_value());
+      }
+    }
+  }
+
+ private:
+  std::streambuf& _input;
+  std::uint64_t _offset = 0;
+
+  int peek() { return _input.sgetc(); }
+  int get()  { _offset++; return _input.sbumpc(); }
+
+  [[noreturn]] void error(std::string_view message) const {
+    throw std::runtime_error{std::string(message) + " at byte " + std::to_string(_offset)};
+  }
+
+  int skip_whitespace() {
+    int ch = peek();
+    while (ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t') {
+      get();
+      ch = peek();
+    }
+    return ch;
+  }
+
+  void expect(std::string_view literal) {
+    for (const char ch : literal) {
+      if (get() != ch)   error("invalid literal");
+    }
+  }
+
+  JsonValue parse_value() {
+    JsonValue value;
+    switch (skip_whitespace()) {
+      case '{': {
+        get();
+        value._type = JsonValue::Type::Object;
+        if (skip_whitespace() == '}') {
+          get();
+          break;
+        }
+        while (true) {
+          if (skip_whitespace() != '"')   error("expected field name");
+          std::string name = parse_string();
+          if (skip_whitespace() != ':')   error("expected ':'");
+          get();
+          value._object.emplace_back(std::move(name), parse_value());
+          const int separator = skip_whitespace();
+          get();
+          if (separator == '}')   break;
+          if (separator != ',')   error("expected ',' or '}'");
+        }
+        break;
+      }
+
+      case '[': {
+        get();
+        value._type = JsonValue::Type::Array;
+        if (skip_whitespace() == ']') {
+          get();
+          break;
+        }
+        while (true) {
+          value._array.emplace_back(parse_value());
+          const int separator = skip_whitespace();
+          get();
+          if (separator == ']')   break;
+          if (separator != ',')   error("expected ',' or ']'");
+        }
+        break;
+      }
+
+      case '"': {
+        value._type   = JsonValue::Type::String;
+        value._string = parse_string();
+        break;
+      }
+
+      case 't': {
+        expect("true");
+        value._type    = JsonValue::Type::Boolean;
+        value._boolean = true;
+        break;
+      }
+
+      case 'f': {
+        expect("false");
+        value._type    = JsonValue::Type::Boolean;
+        value._boolean = false;
+        break;
+      }
+
+      case 'n': {
+        expect("null");
+        break;
+      }
+
+      default: {
+        value._type   = JsonValue::Type::Number;
+        value._number = parse_number();
+        break;
+      }
+    }
+    return value;
+  }
+
+  std::string parse_string() {
+    get();   // opening quote
+    std::string text;
+    while (true) {
+      int ch = get();
+      if (ch == EOF)   error("unterminated string");
+      if (ch == '"')   break;
+      if (ch == '\\') {
+        ch = get();
+        switch (ch) {
+          case 'b': text.push_back('\b'); break;
+          case 'f': text.push_back('\f'); break;
+          case 'n': text.push_back('\n'); break;
+          case 'r': text.push_back('\r'); break;
+          case 't': text.push_back('\t'); break;
+          case 'u': append_utf8(parse_hex4(), text); break;
+          case EOF: error("unterminated string");
+          default:  text.push_back(static_cast<char>(ch)); break;
+        }
+      } else {
+        text.push_back(static_cast<char>(ch));
+      }
+    }
+    return text;
+  }
+
+  std::uint32_t parse_hex4() {
+    std::uint32_t code_point = 0;
+    for (int digit = 0; digit < 4; ++digit) {
+      const int ch = get();
+      code_point <<= 4;
+      if      (ch >= '0' && ch <= '9')   code_point |= static_cast<std::uint32_t>(ch - '0');
+      else if (ch >= 'a' && ch <= 'f')   code_point |= static_cast<std::uint32_t>(ch - 'a' + 10);
+      else if (ch >= 'A' && ch <= 'F')   code_point |= static_cast<std::uint32_t>(ch - 'A' + 10);
+      else error("invalid \\u escape");
+    }
+    return code_point;
+  }
+
+  // surrogate pairs are not combined; the recordings do not need them
+  static void append_utf8(const std::uint32_t code_point, std::string& text) {
+    if (code_point < 0x80) {
+      text.push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+      text.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+      text.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else {
+      text.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+      text.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+      text.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+  }
+
+  double parse_number() {
+    char digits[64];
+    std::size_t length = 0;
+    int ch = peek();
+    while ((ch >= '0' && ch <= '9') || ch == '-' || ch == '+' || ch == '.' || ch == 'e' || ch == 'E') {
+      if (length == sizeof(digits))   error("number too long");
+      digits[length++] = static_cast<char>(get());
+      ch = peek();
+    }
+
+    double number = 0;
+    const auto [end, error_code] = std::from_chars(digits, digits+length, number);
+    if (length == 0 || error_code != std::errc{} || end != digits+length)   error("invalid value");
+    return number;
+  }
+};
+
+// -----------------------------------------------------------------------------
+}   // namespace giopler::tool
+
+// -----------------------------------------------------------------------------
+#endif // defined GIOPLER_TOOL_JSON_HPP